@@ -23,7 +23,9 @@ typedef elai::ksp< Scalar > KSP;
 typedef elai::bicgstab< Scalar > BCGSTAB;
 typedef elai::bicgsafe< Scalar > BCGSAFE;
 typedef elai::gmres< Scalar > GMRES;
+typedef elai::preconditioner< Scalar > Prec;
 typedef elai::ilu< Scalar > ILU;
+typedef elai::ras< Generator::Element, Generator::Neighbour, Scalar > RAS;
 #ifdef ELAI_USE_MUMPS
 typedef elai::mumps< Scalar > LU;
 #endif
@@ -43,17 +45,19 @@ enum ksp_method
   };
 ksp_method method;
 Scalar cthres, fthres, sthres;
-int flevel, imax;
+int flevel, imax, nthreads;
+int overlap, nparts, ncoarse; // RAS in solve_dist when 0 <= overlap
 int mysize, myrank;
 bool scaled, preconditioned;
 
-bool solve( Matrix& A, Vector& x, Vector& b, Coherence *coherent = NULL )
+bool solve( Matrix& A, Vector& x, Vector& b, Coherence *coherent = NULL, RAS *ras = NULL )
 {
   bool flg = false;
   double fact_elapsed;
   Timer t0;
   KSP *solver = NULL;
-  ILU *prec = NULL;
+  ILU *ilu = NULL;
+  Prec *prec = ras;
   Scalar ratio = static_cast< Scalar >( 1. );
   Scalar rnorm, cnorm = rnorm = static_cast< Scalar >( 1. );
 
@@ -69,16 +73,18 @@ bool solve( Matrix& A, Vector& x, Vector& b, Coherence *coherent = NULL )
     ratio = A.scaleRatio();
   }
 
-  if ( preconditioned ) prec = new ILU( A, flevel, fthres, false );
+  if ( preconditioned && ras == NULL ) prec = ilu = new ILU( A, flevel, fthres, false );
 
   if ( method == ELAI_BCGS ) solver = new BCGSTAB( A, b, prec, coherent );
   else if ( method == ELAI_BCGSA ) solver = new BCGSAFE( A, b, prec, coherent );
   else if ( method == ELAI_GMRES ) solver = new GMRES( A, b, prec, coherent );
 
   solver->iter_max( imax );
+  solver->threads( nthreads );
   solver->rel_thres( cthres );
 
-  if ( preconditioned ) prec->factor( fthres );
+  if ( ras != NULL ) ras->factor();
+  else if ( preconditioned ) ilu->factor( fthres );
   flg = solver->solve( x );
 
   if ( scaled )
@@ -112,12 +118,20 @@ void solve_dist
   Operator a( base, topo );
   Function u( base ), v( base );
   Coherence coherent( u, MPI_COMM_WORLD );
-  Sync sync( U, MPI_COMM_WORLD );
+  Sync sync( U, loc, MPI_COMM_WORLD, 0 ); // only rank 0 checks the solution
+  RAS *ras = NULL;
 
   a.reflectIn( A, loc );
   u.reflectIn( U, loc );
   v.reflectIn( V, loc );
-  solve( a.action(), u.ran(), v.ran(), &coherent );
+  // RAS factors the unscaled global operator.
+  if ( preconditioned && !scaled && 0 <= overlap )
+  {
+    ras = new RAS( A, loc, a, myrank, MPI_COMM_WORLD, overlap, flevel, nparts );
+    if ( 0 < ncoarse ) ras->coarse( ncoarse, RAS::MULTIPLICATIVE );
+  }
+  solve( a.action(), u.ran(), v.ran(), &coherent, ras );
+  if ( ras != NULL ) delete ras;
   U.clear( 0e0 );
   U.reflect( u, loc );
   sync();
@@ -261,7 +275,8 @@ int main( int argc, char *argv[] )
 {
   using namespace elai;
 
-  MPI_Init( &argc, &argv );
+  int provided = mpi_init( &argc, &argv );
+
   MPI_Comm_size( MPI_COMM_WORLD, &mysize );
   MPI_Comm_rank( MPI_COMM_WORLD, &myrank );
 
@@ -275,6 +290,12 @@ int main( int argc, char *argv[] )
   istringstream( FTHRES ) >> fthres;
   istringstream( STHRES ) >> sthres;
   istringstream( FLEVEL ) >> flevel;
+  nthreads = getenv( "NTHREADS" ) == NULL ? 0 : atoi( getenv( "NTHREADS" ) );
+  // The threads need MPI_THREAD_FUNNELED; mpi_init warns without it.
+  if ( provided < MPI_THREAD_FUNNELED ) nthreads = 1;
+  overlap = getenv( "OVERLAP" ) == NULL ? -1 : atoi( getenv( "OVERLAP" ) );
+  nparts = getenv( "PARTS" ) == NULL ? 1 : atoi( getenv( "PARTS" ) );
+  ncoarse = getenv( "COARSE" ) == NULL ? 0 : atoi( getenv( "COARSE" ) );
   if ( myrank == 0 )
   {
     cout << setprecision( 15 );
@@ -0,0 +1,552 @@
+/*
+ *
+ * Elastic Linear Algebra Interface (ELAI)
+ *
+ * Copyright 2013-2015 H. KOSHIMOTO, AIST
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __ELAI_AMG__
+#define __ELAI_AMG__
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "def.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "preconditioner.hpp"
+#include "ilut.hpp"
+#ifdef ELAI_USE_MUMPS
+#include "mumps.hpp"
+#endif
+
+namespace elai
+{
+
+// Smoothed aggregation AMG; M^-1 is one V-cycle.
+// Aggregates are grown on the strength graph |a_ij| > theta sqrt( |a_ii a_jj| ),
+// the tentative prolongator P0 is constant on each of them and is smoothed
+// by a damped Jacobi step, P = ( I - omega D^-1 A ) P0 with
+// omega = 4 / ( 3 rho( D^-1 A ) ). Coarse operators are R A P with R = P^T,
+// and the coarsest one is solved directly.
+// The columns beyond the rows ( ghosts ) are ignored, as in ilu.
+template< class Range >
+class amg : public preconditioner< Range >
+{
+public:
+  enum { L1_JACOBI, CHEBYSHEV };
+
+private:
+  typedef std::vector< std::vector< int > > Graph;
+
+  struct Level
+  {
+    Level() : A(), P(), R(), agg(), nagg( 0 ), d(), rho( 0 ), b(), x(), r() {}
+    matrix< Range > A;      // but the finest, which is the one of the preconditioner
+    matrix< Range > P, R;   // to and from the next level
+    std::vector< int > agg; // aggregate of each row, -1 for the isolated ones
+    int nagg;
+    vector< Range > d;      // inverse diagonal of the smoother
+    Range rho;              // bound of rho( D^-1 A )
+    vector< Range > b, x, r;
+  };
+
+  int smoother_, degree_;
+  Range theta_;
+  int coarse_, lmax_;
+  std::vector< int > ind0_, col0_;  // pattern of A the hierarchy is built on
+  std::vector< Level * > level_;
+  ilut< Range > *lu_;
+#ifdef ELAI_USE_MUMPS
+  lu< Range > *mumps_;
+#endif
+
+  amg( const amg& );
+  amg& operator=( const amg& );
+
+  void destruct()
+  {
+    for ( unsigned int l = 0; l < level_.size(); ++l ) delete level_[ l ];
+    level_.clear();
+    if ( lu_ != NULL ) { delete lu_; lu_ = NULL; }
+#ifdef ELAI_USE_MUMPS
+    if ( mumps_ != NULL ) { delete mumps_; mumps_ = NULL; }
+#endif
+  }
+
+  bool pattern_( const matrix< Range >& A ) const
+  {
+    return ind0_.size() == static_cast< unsigned int >( A.m() + 1 )
+        && col0_.size() == static_cast< unsigned int >( A.nnz() )
+        && std::equal( ind0_.begin(), ind0_.end(), A.ind() )
+        && std::equal( col0_.begin(), col0_.end(), A.col() );
+  }
+
+  const matrix< Range >& op_( int l ) const
+  {
+    return l == 0 ? preconditioner< Range >::A_ : level_[ l ]->A;
+  }
+
+  static void setup_
+    ( matrix< Range >& C, int m, int n
+    , std::vector< int >& ind, std::vector< int >& col, std::vector< Range >& val
+    )
+  {
+    C.setup
+      ( m, n, col.size(), &ind[ 0 ]
+      , col.empty() ? NULL : &col[ 0 ], val.empty() ? NULL : &val[ 0 ]
+      );
+  }
+
+  // C = A B, on the columns of A below the rows of B; rows in parallel.
+  static void multiply_( const matrix< Range >& A, const matrix< Range >& B, matrix< Range >& C )
+  {
+    int m = A.m(), n = B.n();
+    std::vector< std::vector< int > > rcol( m );
+    std::vector< std::vector< Range > > rval( m );
+
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel
+#endif
+    {
+      std::vector< int > mark( n, -1 );
+      std::vector< Range > w( n );
+
+#ifdef ELAI_USE_OPENMP
+      #pragma omp for schedule( dynamic, 64 )
+#endif
+      for ( int i = 0; i < m; ++i )
+      {
+        std::vector< int >& c = rcol[ i ];
+
+        for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k )
+        {
+          int j = A.col( k );
+
+          if ( B.m() <= j ) continue;
+          for ( int kk = B.ind( j ); kk < B.ind( j + 1 ); ++kk )
+          {
+            int jj = B.col( kk );
+
+            if ( mark[ jj ] != i ) { mark[ jj ] = i; w[ jj ] = static_cast< Range >( 0 ); c.push_back( jj ); }
+            w[ jj ] += A.val( k ) * B.val( kk );
+          }
+        }
+        std::sort( c.begin(), c.end() );
+        rval[ i ].resize( c.size() );
+        for ( unsigned int n = 0; n < c.size(); ++n ) rval[ i ][ n ] = w[ c[ n ] ];
+      }
+    }
+
+    std::vector< int > ind( m + 1, 0 ), col;
+    std::vector< Range > val;
+
+    for ( int i = 0; i < m; ++i )
+    {
+      col.insert( col.end(), rcol[ i ].begin(), rcol[ i ].end() );
+      val.insert( val.end(), rval[ i ].begin(), rval[ i ].end() );
+      ind[ i + 1 ] = col.size();
+    }
+    setup_( C, m, n, ind, col, val );
+  }
+
+  static void transpose_( const matrix< Range >& P, matrix< Range >& R )
+  {
+    int m = P.m(), n = P.n();
+    std::vector< int > ind( n + 1, 0 ), col( P.nnz() );
+    std::vector< Range > val( P.nnz() );
+
+    for ( int k = 0; k < P.nnz(); ++k ) ++ind[ P.col( k ) + 1 ];
+    for ( int j = 0; j < n; ++j ) ind[ j + 1 ] += ind[ j ];
+    for ( int i = 0; i < m; ++i )
+      for ( int k = P.ind( i ); k < P.ind( i + 1 ); ++k )
+      {
+        int off = ind[ P.col( k ) ]++;
+
+        col[ off ] = i;
+        val[ off ] = P.val( k );
+      }
+    for ( int j = n; 0 < j; --j ) ind[ j ] = ind[ j - 1 ];
+    ind[ 0 ] = 0;
+    setup_( R, n, m, ind, col, val );
+  }
+
+  static Range diag_( const matrix< Range >& A, int i )
+  {
+    for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k ) if ( A.col( k ) == i ) return A.val( k );
+
+    return static_cast< Range >( 0 );
+  }
+
+  // Greedy aggregation in three passes: roots whose strong neighbours are
+  // all free take them, the rest join a neighbouring aggregate, and what is
+  // still left makes new aggregates. Rows without strong neighbours stay out.
+  int aggregate_( const matrix< Range >& A, std::vector< int >& agg ) const
+  {
+    int m = A.m(), n = 0;
+    std::vector< Range > d( m );
+    Graph S( m );
+
+    for ( int i = 0; i < m; ++i ) d[ i ] = fabs( diag_( A, i ) );
+    for ( int i = 0; i < m; ++i )
+      for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k )
+      {
+        int j = A.col( k );
+
+        if ( j == i || m <= j ) continue;
+        if ( theta_ * theta_ * d[ i ] * d[ j ] < A.val( k ) * A.val( k ) ) S[ i ].push_back( j );
+      }
+
+    agg.assign( m, -1 );
+    for ( int i = 0; i < m; ++i )
+    {
+      bool free = !S[ i ].empty() && agg[ i ] < 0;
+
+      for ( unsigned int k = 0; free && k < S[ i ].size(); ++k ) free = agg[ S[ i ][ k ] ] < 0;
+      if ( !free ) continue;
+      agg[ i ] = n;
+      for ( unsigned int k = 0; k < S[ i ].size(); ++k ) agg[ S[ i ][ k ] ] = n;
+      ++n;
+    }
+
+    std::vector< int > root( agg );
+
+    for ( int i = 0; i < m; ++i )
+      if ( agg[ i ] < 0 )
+        for ( unsigned int k = 0; k < S[ i ].size(); ++k )
+          if ( 0 <= root[ S[ i ][ k ] ] ) { agg[ i ] = root[ S[ i ][ k ] ]; break; }
+    for ( int i = 0; i < m; ++i )
+    {
+      if ( 0 <= agg[ i ] || S[ i ].empty() ) continue;
+      agg[ i ] = n;
+      for ( unsigned int k = 0; k < S[ i ].size(); ++k ) if ( agg[ S[ i ][ k ] ] < 0 ) agg[ S[ i ][ k ] ] = n;
+      ++n;
+    }
+
+    return n;
+  }
+
+  // A bound of rho( D^-1 A ) by the Gershgorin discs; the smoothers
+  // diverge with an underestimate.
+  static Range rho_( const matrix< Range >& A, const vector< Range >& dinv )
+  {
+    Range rho = static_cast< Range >( 0 );
+
+    for ( int i = 0; i < A.m(); ++i )
+    {
+      Range s = static_cast< Range >( 0 );
+
+      for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k ) if ( A.col( k ) < A.m() ) s += fabs( A.val( k ) );
+      rho = std::max( rho, fabs( dinv( i ) ) * s );
+    }
+
+    return rho == static_cast< Range >( 0 ) ? static_cast< Range >( 1 ) : rho;
+  }
+
+  // r = b - A x on the level.
+  void residual_( int l ) const
+  {
+    const matrix< Range >& A = op_( l );
+    Level& L = *level_[ l ];
+    int m = A.m();
+
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < m; ++i )
+    {
+      Range s = L.b( i );
+
+      for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k ) if ( A.col( k ) < m ) s -= A.val( k ) * L.x( A.col( k ) );
+      L.r( i ) = s;
+    }
+  }
+
+  // l1-Jacobi: x += D_l1^-1 ( b - A x ). Chebyshev: the polynomial of
+  // degree_ in D^-1 A over [ rho / 30, rho ].
+  void smooth_( int l ) const
+  {
+    Level& L = *level_[ l ];
+    int m = L.x.m();
+
+    residual_( l );
+    if ( smoother_ == L1_JACOBI )
+    {
+      for ( int i = 0; i < m; ++i ) L.x( i ) += L.d( i ) * L.r( i );
+      return;
+    }
+
+    const matrix< Range >& A = op_( l );
+    Range lmax = L.rho, lmin = lmax / static_cast< Range >( 30 );
+    Range theta = ( lmax + lmin ) / static_cast< Range >( 2 ), delta = ( lmax - lmin ) / static_cast< Range >( 2 );
+    Range sigma = theta / delta, rho = static_cast< Range >( 1 ) / sigma;
+    vector< Range > dx( m ), z( m );
+
+    for ( int i = 0; i < m; ++i )
+    {
+      L.r( i ) *= L.d( i );
+      dx( i ) = L.r( i ) / theta;
+      L.x( i ) += dx( i );
+    }
+    for ( int k = 1; k < degree_; ++k )
+    {
+      Range rho1 = static_cast< Range >( 1 ) / ( static_cast< Range >( 2 ) * sigma - rho );
+
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for ( int i = 0; i < m; ++i )
+      {
+        Range s = static_cast< Range >( 0 );
+
+        for ( int kk = A.ind( i ); kk < A.ind( i + 1 ); ++kk ) if ( A.col( kk ) < m ) s += A.val( kk ) * dx( A.col( kk ) );
+        z( i ) = L.r( i ) - L.d( i ) * s;
+      }
+      for ( int i = 0; i < m; ++i )
+      {
+        L.r( i ) = z( i );
+        dx( i ) = rho1 * rho * dx( i ) + static_cast< Range >( 2 ) * rho1 / delta * L.r( i );
+        L.x( i ) += dx( i );
+      }
+      rho = rho1;
+    }
+  }
+
+  // V-cycle on L.b into L.x.
+  void cycle_( int l ) const
+  {
+    Level& L = *level_[ l ];
+    int m = L.x.m();
+
+    if ( l + 1 == static_cast< int >( level_.size() ) )
+    {
+#ifdef ELAI_USE_MUMPS
+      if ( mumps_ != NULL ) { mumps_->solve( L.b, L.x ); return; }
+#endif
+      lu_->apply( L.b, L.x );
+      return;
+    }
+
+    Level& C = *level_[ l + 1 ];
+
+    for ( int i = 0; i < m; ++i ) L.x( i ) = static_cast< Range >( 0 );
+    smooth_( l );
+    residual_( l );
+    for ( int j = 0; j < L.R.m(); ++j )
+    {
+      Range s = static_cast< Range >( 0 );
+
+      for ( int k = L.R.ind( j ); k < L.R.ind( j + 1 ); ++k ) s += L.R.val( k ) * L.r( L.R.col( k ) );
+      C.b( j ) = s;
+    }
+    cycle_( l + 1 );
+    for ( int i = 0; i < m; ++i )
+      for ( int k = L.P.ind( i ); k < L.P.ind( i + 1 ); ++k ) L.x( i ) += L.P.val( k ) * C.x( L.P.col( k ) );
+    smooth_( l );
+  }
+
+  // Smoother data, and the coarser level unless this is the last one.
+  void level_setup_( int l, bool last )
+  {
+    const matrix< Range >& A = op_( l );
+    Level& L = *level_[ l ];
+    int m = A.m();
+    vector< Range > dinv( m );
+
+    L.b.setup( m );
+    L.x.setup( m );
+    L.r.setup( m );
+    L.d.setup( m );
+    for ( int i = 0; i < m; ++i )
+    {
+      Range a = diag_( A, i ), l1 = static_cast< Range >( 0 );
+
+      for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k ) l1 += fabs( A.val( k ) );
+      dinv( i ) = a == static_cast< Range >( 0 ) ? static_cast< Range >( 1 ) : static_cast< Range >( 1 ) / a;
+      L.d( i ) = smoother_ == L1_JACOBI
+               ? ( l1 == static_cast< Range >( 0 ) ? static_cast< Range >( 1 ) : static_cast< Range >( 1 ) / l1 )
+               : dinv( i );
+    }
+    L.rho = rho_( A, dinv );
+    if ( last ) return;
+
+    // P0 normalized on each aggregate, then P = ( I - omega D^-1 A ) P0.
+    std::vector< int > size( L.nagg, 0 ), ind( m + 1, 0 ), col;
+    std::vector< Range > val;
+    matrix< Range > P0, T;
+    Range omega = static_cast< Range >( 4 ) / ( static_cast< Range >( 3 ) * L.rho );
+
+    for ( int i = 0; i < m; ++i ) if ( 0 <= L.agg[ i ] ) ++size[ L.agg[ i ] ];
+    for ( int i = 0; i < m; ++i )
+    {
+      if ( 0 <= L.agg[ i ] )
+      {
+        col.push_back( L.agg[ i ] );
+        val.push_back( static_cast< Range >( 1 ) / std::sqrt( static_cast< Range >( size[ L.agg[ i ] ] ) ) );
+      }
+      ind[ i + 1 ] = col.size();
+    }
+    setup_( P0, m, L.nagg, ind, col, val );
+
+    col.clear();
+    val.clear();
+    for ( int i = 0; i < m; ++i )
+    {
+      for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k )
+      {
+        int j = A.col( k );
+
+        if ( m <= j ) continue;
+        col.push_back( j );
+        val.push_back( ( j == i ? static_cast< Range >( 1 ) : static_cast< Range >( 0 ) ) - omega * dinv( i ) * A.val( k ) );
+      }
+      ind[ i + 1 ] = col.size();
+    }
+    setup_( T, m, m, ind, col, val );
+    multiply_( T, P0, L.P );
+    transpose_( L.P, L.R );
+
+    matrix< Range > AP;
+
+    multiply_( A, L.P, AP );
+    multiply_( L.R, AP, level_[ l + 1 ]->A );
+  }
+
+  void direct_()
+  {
+    int l = level_.size() - 1;
+
+#ifdef ELAI_USE_MUMPS
+    if ( 0 < l )
+    {
+      if ( mumps_ == NULL ) mumps_ = new mumps< Range >( level_[ l ]->A, MPI_COMM_SELF );
+      mumps_->factor();
+      return;
+    }
+#endif
+    if ( lu_ == NULL ) lu_ = new ilut< Range >( op_( l ), static_cast< Range >( 0 ), -1 );
+    lu_->factor();
+  }
+
+protected:
+  void forward_( vector< Range >& x ) const
+  {
+    Level& L = *level_[ 0 ];
+
+    for ( int i = 0; i < x.m(); ++i ) L.b( i ) = x( i );
+    cycle_( 0 );
+    for ( int i = 0; i < x.m(); ++i ) x( i ) = L.x( i );
+  }
+  void backward_( vector< Range >& x ) const {}
+  // M is not formed.
+  void forwardInv_( vector< Range >& x ) const {}
+  void backwardInv_( vector< Range >& x ) const {}
+  void apply_( const vector< Range >& in, vector< Range >& out ) const
+  {
+    Level& L = *level_[ 0 ];
+
+    for ( int i = 0; i < in.m(); ++i ) L.b( i ) = in( i );
+    cycle_( 0 );
+    out = L.x;
+  }
+
+public:
+  amg
+    ( const matrix< Range >& A
+    , int smoother = CHEBYSHEV
+    , int degree = 2           // of Chebyshev
+    , Range theta = static_cast< Range >( 0.08 )
+    , int coarse = 64          // rows of the coarsest level
+    , int levels = 10
+    )
+    : preconditioner< Range >( A ), smoother_( smoother ), degree_( std::max( degree, 1 ) )
+    , theta_( theta ), coarse_( coarse ), lmax_( std::max( levels, 1 ) ), ind0_(), col0_()
+    , level_(), lu_( NULL )
+#ifdef ELAI_USE_MUMPS
+    , mumps_( NULL )
+#endif
+  {}
+  ~amg()
+  {
+    destruct();
+  }
+
+  // Builds the hierarchy. The aggregates, and so the patterns, are kept
+  // while the pattern of A is unchanged; then only the values are redone.
+  void factor()
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+    bool reuse = !level_.empty() && pattern_( A );
+    int nl = level_.size();
+
+    if ( !reuse )
+    {
+      destruct();
+      ind0_.assign( A.ind(), A.ind() + A.m() + 1 );
+      col0_.assign( A.col(), A.col() + A.nnz() );
+    }
+    for ( int l = 0; ; ++l )
+    {
+      if ( l == static_cast< int >( level_.size() ) ) level_.push_back( new Level() );
+
+      Level& L = *level_[ l ];
+      const matrix< Range >& Al = op_( l );
+      bool last = reuse ? l + 1 == nl : ( Al.m() <= coarse_ || l + 1 == lmax_ );
+
+      // Stops when the aggregation reduces the rows less than by a fifth.
+      if ( !reuse && !last )
+      {
+        L.nagg = aggregate_( Al, L.agg );
+        last = L.nagg == 0 || 4 * Al.m() < 5 * L.nagg;
+      }
+      if ( !last && l + 1 == static_cast< int >( level_.size() ) ) level_.push_back( new Level() );
+      level_setup_( l, last );
+      if ( last ) break;
+    }
+    direct_();
+  }
+
+  int levels() const { return level_.size(); }
+  int rows( int l ) const { return op_( l ).m(); }
+  // Operator complexity: nnz of all levels over the one of A.
+  double complexity() const
+  {
+    double sum = 0.;
+
+    for ( unsigned int l = 0; l < level_.size(); ++l ) sum += op_( l ).nnz();
+
+    return level_.empty() ? 0. : sum / op_( 0 ).nnz();
+  }
+
+  size_t mem() const
+  {
+    size_t sum = sizeof( *this );
+
+    for ( unsigned int l = 0; l < level_.size(); ++l )
+    {
+      const Level& L = *level_[ l ];
+
+      if ( 0 < l ) sum += L.A.mem();
+      sum += L.P.mem() + L.R.mem() + sizeof( int ) * L.agg.size() + sizeof( Range ) * 4 * L.x.m();
+    }
+    if ( lu_ != NULL ) sum += lu_->mem();
+
+    return sum;
+  }
+};
+
+}
+
+#endif//__ELAI_AMG__
@@ -44,7 +44,7 @@ private:
 
   bool solve_( vector< Coef >& x )
   {
-    Coef res, res0, alpha, beta, eta, zeta, tmp1, tmp2, tmp3, tmp4, tmp5;
+    Coef res, res0, alpha, beta, eta, zeta, rho, rho1, sigma, rr, norm, tmp1, tmp2, tmp3, tmp4, tmp5;
 
     if ( is_trivial( b_ ) )
     {
@@ -53,26 +53,28 @@ private:
       return true;
     }
 
-    r_ = b_ - A_ * x;
-    res = res0 = sync_norm( r_ );
+    residual( r_, x );
+    ELAI_SYNC( r_ );
+    ELAI_PROD_DEFER( rr, r_, r_ );
+    ELAI_PROD_DEFER( norm, x, x );
+    ELAI_REDUCE();
+    res = res0 = sqrt( rr );
     if ( is_trivial( res0 ) ) return true;
 
     rs0_ = r_;
     p_ = r_;
 
-    v_ = A_ * r_;
-    ELAI_SYNC( v_ );
+    ELAI_SPMV( v_, r_ );
 
     Ap_ = v_;
+    rho = rr; // ( rs0, r )
 
-    ELAI_PROD( tmp1, rs0_, r_ );
-    ELAI_PROD( tmp2, rs0_, Ap_ );
-
-    alpha = tmp1 / tmp2;
-
-    ELAI_PROD( tmp1, v_, r_ );
-    ELAI_PROD( tmp2, v_, v_ );
+    ELAI_PROD_DEFER( sigma, rs0_, Ap_ );
+    ELAI_PROD_DEFER( tmp1, v_, r_ );
+    ELAI_PROD_DEFER( tmp2, v_, v_ );
+    ELAI_REDUCE();
 
+    alpha = rho / sigma;
     zeta = tmp1 / tmp2;
     eta = static_cast< Coef >( 0. );
     beta = static_cast< Coef >( 0. );
@@ -81,9 +83,7 @@ private:
     for ( int i = 0; i < iter_max(); ++i )
     {
       bool converged = false;
-      Coef norm;
-      
-      norm = x * x;
+
 #ifdef ELAI_DEBUG
       std::cerr << " ||x||=" << norm
                 << " ||Ax-b||=" << res
@@ -93,54 +93,58 @@ private:
       else if ( rel_converged( res, res0 ) || abs_converged( res ) ) converged = true;
       else if ( !is_trivial( norm ) && rel_converged( res, norm ) ) converged = true;
 
-      if ( isOK( converged ) ) return true;
+      if ( converged ) return true;
 
       w_ = zeta * Ap_ + eta * y_;
       u_ = w_ + eta * beta * u_;
 
-      Au_ = A_ * u_;
-      ELAI_SYNC( Au_ );
+      ELAI_SPMV( Au_, u_ );
 
       z_ = zeta * r_ + eta * z_ - alpha * u_;
       y_ = zeta * v_ + eta * y_ - alpha * Au_;
       x = x + alpha * p_ + z_;
       r1_ = r_ - alpha * Ap_ - y_;
 
-      ELAI_PROD( tmp1, rs0_, r1_ );
-      ELAI_PROD( tmp2, rs0_, r_ );
+      // Products on the new residual are reduced behind A r1.
+      ELAI_PROD_DEFER( rho1, rs0_, r1_ );
+      ELAI_PROD_DEFER( tmp1, y_, y_ );
+      ELAI_PROD_DEFER( tmp4, y_, r1_ );
+      ELAI_PROD_DEFER( rr, r1_, r1_ );
+      ELAI_PROD_DEFER( norm, x, x );
+      ELAI_REDUCE_BEG();
+
+      ELAI_SPMV( v_, r1_ );
+
+      ELAI_REDUCE_END();
 
       // This avoidance for numerical breakdowns is NOT good.
       // However we have not implemented any other strategies.
-      if ( sqrt( fabs( tmp2 ) ) / res0 <= bthres_ ) tmp2 = rs0_ * rs0_;
+      tmp2 = rho; // ( rs0, r ) of the previous step
+      if ( sqrt( fabs( tmp2 ) ) / res0 <= bthres_ ) tmp2 = res0 * res0;
 
-      beta = ( alpha / zeta ) * ( tmp1 / tmp2 );
+      beta = ( alpha / zeta ) * ( rho1 / tmp2 );
       r_ = r1_;
       p_ = r1_ + beta * ( p_ - u_ );
 
-      v_ = A_ * r1_;
-      ELAI_SYNC( v_ );
-
       Ap_ = v_ + beta * ( Ap_ - Au_ );
 
-      ELAI_PROD( tmp1, rs0_, r_ );
-      ELAI_PROD( tmp2, rs0_, Ap_ );
+      ELAI_PROD_DEFER( sigma, rs0_, Ap_ );
+      ELAI_PROD_DEFER( tmp2, v_, v_ );
+      ELAI_PROD_DEFER( tmp3, y_, v_ );
+      ELAI_PROD_DEFER( tmp5, v_, r_ );
+      ELAI_REDUCE();
 
       // This avoidance for numerical breakdowns is NOT good.
       // However we have not implemented any other strategies.
-      if ( sqrt( fabs( tmp2 ) ) / res0 <= bthres_ ) tmp2 = rs0_ * rs0_;
-
-      alpha = tmp1 / tmp2;
+      if ( sqrt( fabs( sigma ) ) / res0 <= bthres_ ) sigma = res0 * res0;
 
-      ELAI_PROD( tmp1, y_, y_ );
-      ELAI_PROD( tmp2, v_, v_ );
-      ELAI_PROD( tmp3, y_, v_ );
-      ELAI_PROD( tmp4, y_, r_ );
-      ELAI_PROD( tmp5, v_, r_ );
+      rho = rho1;
+      alpha = rho / sigma;
 
       zeta = ( tmp1 * tmp5 - tmp4 * tmp3 ) / ( tmp1 * tmp2 - tmp3 * tmp3 );
       eta = ( tmp2 * tmp4 - tmp3 * tmp5 ) / ( tmp1 * tmp2 - tmp3 * tmp3 );
 
-      res = fix_norm( r_ );
+      res = sqrt( rr );
     }
 
     return false;
@@ -148,7 +152,7 @@ private:
 
   bool solveP_( vector< Coef >& x )
   {
-    Coef res, res0, alpha, beta, eta, zeta, tmp1, tmp2, tmp3, tmp4, tmp5;
+    Coef res, res0, alpha, beta, eta, zeta, rho, rho1, sigma, rr, norm, tmp1, tmp2, tmp3, tmp4, tmp5;
 
     if ( is_trivial( b_ ) )
     {
@@ -157,35 +161,35 @@ private:
       return true;
     }
 
-    r_ = b_ - A_ * x;
-    res = res0 = sync_norm( r_ );
+    residual( r_, x );
+    ELAI_SYNC( r_ );
+    ELAI_PROD_DEFER( rr, r_, r_ );
+    ELAI_PROD_DEFER( norm, x, x );
+    ELAI_REDUCE();
+    res = res0 = sqrt( rr );
     if ( is_trivial( res0 ) ) return true;
 
     rs0_ = r_;
-    r1_ = r_;
 
     // Preconditioning:
     ELAI_PROF_BEG( prec_elapsed_ );
-    P_->forward( r1_ );
-    P_->backward( r1_ );
+    P_->apply( r_, r1_ );
     ELAI_SYNC( r1_ );
     ELAI_PROF_END( prec_elapsed_ );
 
     p_ = r1_;
 
-    v_ = A_ * r1_;
-    ELAI_SYNC( v_ );
+    ELAI_SPMV( v_, r1_ );
 
     Ap_ = v_;
+    rho = rr; // ( rs0, r )
 
-    ELAI_PROD( tmp1, rs0_, r_ );
-    ELAI_PROD( tmp2, rs0_, Ap_ );
-
-    alpha = tmp1 / tmp2;
-
-    ELAI_PROD( tmp1, v_, r_ );
-    ELAI_PROD( tmp2, v_, v_ );
+    ELAI_PROD_DEFER( sigma, rs0_, Ap_ );
+    ELAI_PROD_DEFER( tmp1, v_, r_ );
+    ELAI_PROD_DEFER( tmp2, v_, v_ );
+    ELAI_REDUCE();
 
+    alpha = rho / sigma;
     zeta = tmp1 / tmp2;
     eta = static_cast< Coef >( 0. );
     beta = static_cast< Coef >( 0. );
@@ -194,9 +198,7 @@ private:
     for ( int i = 0; i < iter_max(); ++i )
     {
       bool converged = false;
-      Coef norm;
-      
-      norm = x * x;
+
 #ifdef ELAI_DEBUG
       std::cerr << " ||x||=" << norm
                 << " ||Ax-b||=" << res
@@ -206,7 +208,7 @@ private:
       else if ( rel_converged( res, res0 ) || abs_converged( res ) ) converged = true;
       else if ( !is_trivial( norm ) && rel_converged( res, norm ) ) converged = true;
 
-      if ( isOK( converged ) ) return true;
+      if ( converged ) return true;
 
       w_ = zeta * Ap_ + eta * y_;
 
@@ -219,58 +221,60 @@ private:
 
       u_ = w_ + eta * beta * u_;
 
-      Au_ = A_ * u_;
-      ELAI_SYNC( Au_ );
+      ELAI_SPMV( Au_, u_ );
 
       z_ = zeta * r1_ + eta * z_ - alpha * u_;
       y_ = zeta * v_ + eta * y_ - alpha * Au_;
       x = x + alpha * p_ + z_;
       r1_ = r_ - alpha * Ap_ - y_;
 
-      ELAI_PROD( tmp1, rs0_, r1_ );
-      ELAI_PROD( tmp2, rs0_, r_ );
-
-      // This avoidance for numerical breakdowns is NOT good.
-      // However we have not implemented any other strategies.
-      if ( sqrt( fabs( tmp2 ) ) / res0 <= bthres_ ) tmp2 = rs0_ * rs0_;
-
-      beta = ( alpha / zeta ) * ( tmp1 / tmp2 );
+      // Products on the new residual are reduced behind the preconditioning and A r1.
+      ELAI_PROD_DEFER( rho1, rs0_, r1_ );
+      ELAI_PROD_DEFER( tmp1, y_, y_ );
+      ELAI_PROD_DEFER( tmp4, y_, r1_ );
+      ELAI_PROD_DEFER( rr, r1_, r1_ );
+      ELAI_PROD_DEFER( norm, x, x );
+      ELAI_REDUCE_BEG();
 
       r_ = r1_;
 
       // Preconditioning:
       ELAI_PROF_BEG( prec_elapsed_ );
-      P_->forward( r1_ );
-      P_->backward( r1_ );
+      P_->apply( r_, r1_ );
       ELAI_SYNC( r1_ );
       ELAI_PROF_END( prec_elapsed_ );
 
-      p_ = r1_ + beta * ( p_ - u_ );
+      ELAI_SPMV( v_, r1_ );
 
-      v_ = A_ * r1_;
-      ELAI_SYNC( v_ );
+      ELAI_REDUCE_END();
+
+      // This avoidance for numerical breakdowns is NOT good.
+      // However we have not implemented any other strategies.
+      tmp2 = rho; // ( rs0, r ) of the previous step
+      if ( sqrt( fabs( tmp2 ) ) / res0 <= bthres_ ) tmp2 = res0 * res0;
+
+      beta = ( alpha / zeta ) * ( rho1 / tmp2 );
+      p_ = r1_ + beta * ( p_ - u_ );
 
       Ap_ = v_ + beta * ( Ap_ - Au_ );
 
-      ELAI_PROD( tmp1, rs0_, r_ );
-      ELAI_PROD( tmp2, rs0_, Ap_ );
+      ELAI_PROD_DEFER( sigma, rs0_, Ap_ );
+      ELAI_PROD_DEFER( tmp2, v_, v_ );
+      ELAI_PROD_DEFER( tmp3, y_, v_ );
+      ELAI_PROD_DEFER( tmp5, v_, r_ );
+      ELAI_REDUCE();
 
       // This avoidance for numerical breakdowns is NOT good.
       // However we have not implemented any other strategies.
-      if ( sqrt( fabs( tmp2 ) ) / res0 <= bthres_ ) tmp2 = rs0_ * rs0_;
-
-      alpha = tmp1 / tmp2;
+      if ( sqrt( fabs( sigma ) ) / res0 <= bthres_ ) sigma = res0 * res0;
 
-      ELAI_PROD( tmp1, y_, y_ );
-      ELAI_PROD( tmp2, v_, v_ );
-      ELAI_PROD( tmp3, y_, v_ );
-      ELAI_PROD( tmp4, y_, r_ );
-      ELAI_PROD( tmp5, v_, r_ );
+      rho = rho1;
+      alpha = rho / sigma;
 
       zeta = ( tmp1 * tmp5 - tmp4 * tmp3 ) / ( tmp1 * tmp2 - tmp3 * tmp3 );
       eta = ( tmp2 * tmp4 - tmp3 * tmp5 ) / ( tmp1 * tmp2 - tmp3 * tmp3 );
 
-      res = fix_norm( r_ );
+      res = sqrt( rr );
     }
 
     return false;
@@ -291,11 +295,31 @@ public:
       , coherent
 #endif
       )
-    , r_( A_.m() ), r1_( A_.m() ), rs0_( A_.m() ), v_( A_.m() ), u_( A_.m() ), Au_( A_.m() )
-    , p_( A_.m() ), Ap_( A_.m() ), z_( A_.m() ), y_( A_.m() ), w_( A_.m() )
+    , r_( m() ), r1_( m() ), rs0_( m() ), v_( m() ), u_( m() ), Au_( m() )
+    , p_( m() ), Ap_( m() ), z_( m() ), y_( m() ), w_( m() )
+    , bthres_( static_cast< Coef >( 1e-16 ) )
+  {
+    iter_max( m() );
+  }
+  bicgsafe
+    ( const linear_map< Coef >& A
+    , const vector< Coef >& b
+    , preconditioner< Coef > *P = NULL
+#ifdef ELAI_USE_MPI
+    , coherence *coherent = NULL
+#endif
+    )
+    : ksp< Coef >
+      ( A, b, P
+#ifdef ELAI_USE_MPI
+      , coherent
+#endif
+      )
+    , r_( m() ), r1_( m() ), rs0_( m() ), v_( m() ), u_( m() ), Au_( m() )
+    , p_( m() ), Ap_( m() ), z_( m() ), y_( m() ), w_( m() )
     , bthres_( static_cast< Coef >( 1e-16 ) )
   {
-    iter_max( A_.m() );
+    iter_max( m() );
   }
   ~bicgsafe() {}
 
@@ -44,7 +44,7 @@ private:
 
   bool solve_( vector< Coef >& x )
   {
-    Coef res, res0;
+    Coef res, res0, rho, rr, norm;
 
     if ( is_trivial( b_ ) )
     {
@@ -53,19 +53,23 @@ private:
       return true;
     }
 
-    r_ = b_ - A_ * x;
-    res = res0 = sync_norm( r_ );
+    residual( r_, x );
+    ELAI_SYNC( r_ );
+    ELAI_PROD_DEFER( rr, r_, r_ );
+    ELAI_PROD_DEFER( norm, x, x );
+    ELAI_REDUCE();
+    res = res0 = sqrt( rr );
     if ( is_trivial( res0 ) ) return true;
 
     rs0_ = r_;
     p_ = r_;
+    rho = rr; // ( rs0, r )
 
     for ( int i = 0; i < iter_max(); ++i )
     {
       bool converged = false;
       Coef alpha, beta, omega, tmp1, tmp2;
 
-      Coef norm = x * x;
 #ifdef ELAI_DEBUG
       std::cerr << " ||x||=" << norm
                 << " ||Ax-b||=" << res
@@ -75,40 +79,41 @@ private:
       else if ( rel_converged( res, res0 ) || abs_converged( res ) ) converged = true;
       else if ( !is_trivial( norm ) && rel_converged( res, norm ) ) converged = true;
 
-      if ( isOK( converged ) ) return true;
+      if ( converged ) return true;
 
-      Ap_ = A_ * p_;
-      ELAI_SYNC( Ap_ );
+      ELAI_SPMV( Ap_, p_ );
 
-      ELAI_PROD( tmp1, rs0_, r_ );
       ELAI_PROD( tmp2, rs0_, Ap_ );
 
       // This avoidance for numerical breakdowns is NOT good.
       // However we have not implemented any other strategies.
-      if ( sqrt( fabs( tmp2 ) ) / res0 <= bthres_ ) tmp2 = rs0_ * rs0_;
+      if ( sqrt( fabs( tmp2 ) ) / res0 <= bthres_ ) tmp2 = res0 * res0; // ( rs0, rs0 )
 
-      alpha = tmp1 / tmp2;
+      alpha = rho / tmp2;
       s_ = r_ - alpha * Ap_;
 
-      s1_ = A_ * s_;
-      ELAI_SYNC( s1_ );
+      ELAI_SPMV( s1_, s_ );
 
-      ELAI_PROD( tmp1, s1_, s_ );
-      ELAI_PROD( tmp2, s1_, s1_ );
+      ELAI_PROD_DEFER( tmp1, s1_, s_ );
+      ELAI_PROD_DEFER( tmp2, s1_, s1_ );
+      ELAI_REDUCE();
 
       omega = tmp1 / tmp2;
       x = x + alpha * p_ + omega * s_;
 
       r1_ = s_ - omega * s1_;
 
-      ELAI_PROD( tmp1, rs0_, r1_ );
-      ELAI_PROD( tmp2, rs0_, r_ );
+      ELAI_PROD_DEFER( tmp1, rs0_, r1_ );
+      ELAI_PROD_DEFER( rr, r1_, r1_ );
+      ELAI_PROD_DEFER( norm, x, x );
+      ELAI_REDUCE();
 
-      beta = alpha / omega * tmp1 / tmp2;
+      beta = alpha / omega * tmp1 / rho;
       p_ = r1_ + beta * ( p_ - omega * Ap_ );
 
       r_ = r1_;
-      res = fix_norm( r_ );
+      rho = tmp1;
+      res = sqrt( rr );
     }
 
     return false;
@@ -116,7 +121,7 @@ private:
 
   bool solveP_( vector< Coef >& x )
   {
-    Coef res, res0;
+    Coef res, res0, rho, rho0, rr, norm;
 
     if ( is_trivial( b_ ) )
     {
@@ -125,28 +130,31 @@ private:
       return true;
     }
 
-    r_ = b_ - A_ * x;
-    res = res0 = sync_norm( r_ );
-    if ( is_trivial( res0 ) ) return true;
-
-    rs0_ = r_;
+    residual( r_, x );
+    ELAI_SYNC( r_ );
 
     // Preconditioning:
     ELAI_PROF_BEG( prec_elapsed_ );
-    P_->forward( rs0_ );
-    P_->backward( rs0_ );
+    P_->apply( r_, rs0_ );
     ELAI_SYNC( rs0_ );
     ELAI_PROF_END( prec_elapsed_ );
 
+    ELAI_PROD_DEFER( rr, r_, r_ );
+    ELAI_PROD_DEFER( rho0, rs0_, rs0_ );
+    ELAI_PROD_DEFER( norm, x, x );
+    ELAI_REDUCE();
+    res = res0 = sqrt( rr );
+    if ( is_trivial( res0 ) ) return true;
+
     r1_ = rs0_;
     p_ = rs0_;
+    rho = rho0; // ( rs0, r1 )
 
     for ( int i = 0; i < iter_max(); ++i )
     {
       bool converged = false;
       Coef alpha, beta, omega, tmp1, tmp2;
 
-      Coef norm = x * x;
 #ifdef ELAI_DEBUG
       std::cerr << " ||x||=" << norm
                 << " ||Ax-b||=" << res
@@ -156,62 +164,59 @@ private:
       else if ( rel_converged( res, res0 ) || abs_converged( res ) ) converged = true;
       else if ( !is_trivial( norm ) && rel_converged( res, norm ) ) converged = true;
 
-      if ( isOK( converged ) ) return true;
+      if ( converged ) return true;
 
-      Ap_ = A_ * p_;
-      ELAI_SYNC( Ap_ );
-
-      p1_ = Ap_;
+      ELAI_SPMV( Ap_, p_ );
 
       // Preconditioning:
       ELAI_PROF_BEG( prec_elapsed_ );
-      P_->forward( p1_ );
-      P_->backward( p1_ );
+      P_->apply( Ap_, p1_ );
       ELAI_SYNC( p1_ );
       ELAI_PROF_END( prec_elapsed_ );
 
-      ELAI_PROD( tmp1, rs0_, r1_ );
       ELAI_PROD( tmp2, rs0_, p1_ );
 
       // This avoidance for numerical breakdowns is NOT good.
       // However we have not implemented any other strategies.
-      if ( sqrt( fabs( tmp2 ) ) / res0 <= bthres_ ) tmp2 = rs0_ * rs0_;
+      if ( sqrt( fabs( tmp2 ) ) / res0 <= bthres_ ) tmp2 = rho0;
 
-      alpha = tmp1 / tmp2;
+      alpha = rho / tmp2;
       s_ = r_ - alpha * Ap_;
       s1_ = r1_ - alpha * p1_;
 
-      s2_ = A_ * s1_;
-      ELAI_SYNC( s2_ );
+      ELAI_SPMV( s2_, s1_ );
 
-      ELAI_PROD( tmp1, s2_, s_ );
-      ELAI_PROD( tmp2, s2_, s2_ );
+      ELAI_PROD_DEFER( tmp1, s2_, s_ );
+      ELAI_PROD_DEFER( tmp2, s2_, s2_ );
+      ELAI_REDUCE();
 
       omega = tmp1 / tmp2;
       x = x + alpha * p_ + omega * s1_;
 
       r_ = s_ - omega * s2_;
-      r2_ = r_;
 
       // Preconditioning:
       ELAI_PROF_BEG( prec_elapsed_ );
-      P_->forward( r2_ );
-      P_->backward( r2_ );
+      P_->apply( r_, r2_ );
       ELAI_SYNC( r2_ );
       ELAI_PROF_END( prec_elapsed_ );
 
-      ELAI_PROD( tmp1, rs0_, r2_ );
-      ELAI_PROD( tmp2, rs0_, r1_ );
+      ELAI_PROD_DEFER( tmp1, rs0_, r2_ );
+      ELAI_PROD_DEFER( rr, r_, r_ );
+      ELAI_PROD_DEFER( norm, x, x );
+      ELAI_REDUCE();
 
       // This avoidance for numerical breakdowns is NOT good.
       // However we have not implemented any other strategies.
-      if ( sqrt( fabs( tmp2 ) ) / res0 <= bthres_ ) tmp2 = rs0_ * rs0_;
+      tmp2 = rho;
+      if ( sqrt( fabs( tmp2 ) ) / res0 <= bthres_ ) tmp2 = rho0;
 
       beta = alpha / omega * tmp1 / tmp2;
       p_ = r2_ + beta * ( p_ - omega * p1_ );
       r1_ = r2_;
 
-      res = fix_norm( r_ );
+      rho = tmp1;
+      res = sqrt( rr );
     }
 
     return false;
@@ -232,11 +237,31 @@ public:
       , coherent
 #endif
       )
-    , r_( A_.m() ), r1_( A_.m() ), r2_( A_.m() ), rs0_( A_.m() )
-    , p_( A_.m() ), p1_( A_.m() ), Ap_( A_.m() ), s_( A_.m() ), s1_( A_.m() ), s2_( A_.m() )
+    , r_( m() ), r1_( m() ), r2_( m() ), rs0_( m() )
+    , p_( m() ), p1_( m() ), Ap_( m() ), s_( m() ), s1_( m() ), s2_( m() )
+    , bthres_( static_cast< Coef >( 1e-16 ) )
+  {
+    iter_max( m() );
+  }
+  bicgstab
+    ( const linear_map< Coef >& A
+    , const vector< Coef >& b
+    , preconditioner< Coef > *P = NULL
+#ifdef ELAI_USE_MPI
+    , coherence *coherent = NULL
+#endif
+    )
+    : ksp< Coef >
+      ( A, b, P
+#ifdef ELAI_USE_MPI
+      , coherent
+#endif
+      )
+    , r_( m() ), r1_( m() ), r2_( m() ), rs0_( m() )
+    , p_( m() ), p1_( m() ), Ap_( m() ), s_( m() ), s1_( m() ), s2_( m() )
     , bthres_( static_cast< Coef >( 1e-16 ) )
   {
-    iter_max( A_.m() );
+    iter_max( m() );
   }
   ~bicgstab() {}
 
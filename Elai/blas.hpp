@@ -100,7 +100,19 @@ public:
   {
     assert( lhs_.m() == rhs_.m() );
     range acc = static_cast< range >( 0 );
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel
+    {
+      range part = static_cast< range >( 0 );
+
+      #pragma omp for nowait
+      for ( int i = 0; i < lhs_.m(); ++i ) part += lhs_( i ) * rhs_( i );
+      #pragma omp critical
+      acc += part;
+    }
+#else
     for ( int i = 0; i < lhs_.m(); ++i ) acc += lhs_( i ) * rhs_( i );
+#endif
     return acc;
   }
 };
@@ -131,7 +143,19 @@ public:
   {
     assert( lhs_.m() == rhs_.m() );
     range acc = static_cast< range >( 0 );
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel
+    {
+      range part = static_cast< range >( 0 );
+
+      #pragma omp for nowait
+      for ( int i = 0; i < lhs_.m(); ++i ) part += lhs_( i ) * std::conj( rhs_( i ) );
+      #pragma omp critical
+      acc += part;
+    }
+#else
     for ( int i = 0; i < lhs_.m(); ++i ) acc += lhs_( i ) * std::conj( rhs_( i ) );
+#endif
     return acc;
   }
 };
@@ -0,0 +1,269 @@
+/*
+ *
+ * Elastic Linear Algebra Interface (ELAI)
+ *
+ * Copyright 2013-2015 H. KOSHIMOTO, AIST
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __ELAI_BLOCK_JACOBI_CONDITIONER__
+#define __ELAI_BLOCK_JACOBI_CONDITIONER__
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "def.hpp"
+#include "expression.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "blas.hpp"
+#include "preconditioner.hpp"
+
+namespace elai
+{
+
+// A = L + D + U, where D is block diagonal with small dense blocks
+// ( e.g. the unknowns of a node ). Then M = D; the inverses of the blocks
+// are formed once by factor(), and kept contiguously.
+template< class Range >
+class block_jacobi_conditioner : public preconditioner< Range >
+{
+  int bs_;                    // The uniform block size, or 0.
+  int max_;                   // The largest block size.
+  std::vector< int > ptr_;    // The first row of each block.
+  std::vector< int > off_;    // The first entry of each inverse.
+  Range *inv_;
+
+  block_jacobi_conditioner( const block_jacobi_conditioner& );
+  block_jacobi_conditioner& operator=( const block_jacobi_conditioner& );
+
+  void destruct()
+  {
+    if ( inv_ != NULL ) { delete [] inv_; inv_ = NULL; }
+  }
+
+  // a <- a^-1 of order r by LU with partial pivoting, with the workspace
+  // w of r * r; 0 < N fixes the order for the unrolled kernels.
+  template< int N >
+  static void invert_( int n, Range *a, Range *w )
+  {
+    const int r = 0 < N ? N : n;
+
+    for ( int k = 0; k < r * r; ++k ) w[ k ] = a[ k ];
+    for ( int i = 0; i < r; ++i )
+      for ( int j = 0; j < r; ++j ) a[ i * r + j ] = static_cast< Range >( i == j ? 1 : 0 );
+
+    // Eliminates on w, and applies the same to a.
+    for ( int k = 0; k < r; ++k )
+    {
+      int p = k;
+
+      for ( int i = k + 1; i < r; ++i ) if ( fabs( w[ p * r + k ] ) < fabs( w[ i * r + k ] ) ) p = i;
+      if ( p != k )
+        for ( int j = 0; j < r; ++j )
+        {
+          std::swap( w[ p * r + j ], w[ k * r + j ] );
+          std::swap( a[ p * r + j ], a[ k * r + j ] );
+        }
+      if ( w[ k * r + k ] == static_cast< Range >( 0 ) ) w[ k * r + k ] = static_cast< Range >( 1 );
+      for ( int i = k + 1; i < r; ++i )
+      {
+        Range l = w[ i * r + k ] / w[ k * r + k ];
+
+        for ( int j = k + 1; j < r; ++j ) w[ i * r + j ] -= l * w[ k * r + j ];
+        for ( int j = 0; j < r; ++j ) a[ i * r + j ] -= l * a[ k * r + j ];
+      }
+    }
+    for ( int k = r - 1; 0 <= k; --k )
+    {
+      Range d = static_cast< Range >( 1 ) / w[ k * r + k ];
+
+      for ( int j = 0; j < r; ++j )
+      {
+        for ( int l = k + 1; l < r; ++l ) a[ k * r + j ] -= w[ k * r + l ] * a[ l * r + j ];
+        a[ k * r + j ] *= d;
+      }
+    }
+  }
+
+  // x <- inv x of order r; the workspace t is used only unless 0 < N.
+  template< int N >
+  static void multiply_( int n, const Range *inv, Range *x, Range *w )
+  {
+    const int r = 0 < N ? N : n;
+    Range s[ 0 < N ? N : 1 ], *t = 0 < N ? s : w;
+
+    for ( int i = 0; i < r; ++i )
+    {
+      Range v = static_cast< Range >( 0 );
+
+      for ( int j = 0; j < r; ++j ) v += inv[ i * r + j ] * x[ j ];
+      t[ i ] = v;
+    }
+    for ( int i = 0; i < r; ++i ) x[ i ] = t[ i ];
+  }
+
+  template< int N >
+  void factor_()
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+    const int nb = ptr_.size() - 1;
+
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel
+#endif
+    {
+      std::vector< Range > w;
+
+#ifdef ELAI_USE_OPENMP
+      #pragma omp for
+#endif
+      for ( int b = 0; b < nb; ++b )
+      {
+        const int beg = ptr_[ b ], r = ptr_[ b + 1 ] - beg;
+        Range *a = inv_ + off_[ b ];
+
+        // Gathers the block from the rows.
+        for ( int k = 0; k < r * r; ++k ) a[ k ] = static_cast< Range >( 0 );
+        for ( int i = 0; i < r; ++i )
+          for ( int k = A.ind( beg + i ); k < A.ind( beg + i + 1 ); ++k )
+          {
+            int j = A.col( k ) - beg;
+
+            if ( 0 <= j && j < r ) a[ i * r + j ] = A.val( k );
+          }
+        w.resize( r * r );
+        invert_< N >( r, a, &w[ 0 ] );
+      }
+    }
+  }
+
+  template< int N >
+  void apply_blocks_( vector< Range >& x ) const
+  {
+    const int nb = ptr_.size() - 1;
+
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel
+#endif
+    {
+      std::vector< Range > t( 0 < N ? 0 : max_ );
+
+#ifdef ELAI_USE_OPENMP
+      #pragma omp for
+#endif
+      for ( int b = 0; b < nb; ++b )
+        multiply_< N >( ptr_[ b + 1 ] - ptr_[ b ], inv_ + off_[ b ], x.val() + ptr_[ b ], t.empty() ? NULL : &t[ 0 ] );
+    }
+  }
+
+  void offsets_()
+  {
+    off_.assign( 1, 0 );
+    max_ = 1;
+    for ( unsigned int b = 0; b + 1 < ptr_.size(); ++b )
+    {
+      int r = ptr_[ b + 1 ] - ptr_[ b ];
+
+      off_.push_back( off_[ b ] + r * r );
+      max_ = std::max( max_, r );
+    }
+  }
+
+protected:
+  void forward_( vector< Range >& x ) const {}
+  void backward_( vector< Range >& x ) const
+  {
+    switch ( bs_ )
+    {
+    case 1: apply_blocks_< 1 >( x ); break;
+    case 2: apply_blocks_< 2 >( x ); break;
+    case 3: apply_blocks_< 3 >( x ); break;
+    case 4: apply_blocks_< 4 >( x ); break;
+    case 6: apply_blocks_< 6 >( x ); break;
+    default: apply_blocks_< 0 >( x ); break;
+    }
+  }
+  void forwardInv_( vector< Range >& x ) const {}
+  void backwardInv_( vector< Range >& x ) const
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+    const int nb = ptr_.size() - 1;
+    vector< Range > tmp( x );
+
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int b = 0; b < nb; ++b )
+      for ( int i = ptr_[ b ]; i < ptr_[ b + 1 ]; ++i )
+      {
+        tmp( i ) = static_cast< Range >( 0 );
+        for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k )
+          if ( ptr_[ b ] <= A.col( k ) && A.col( k ) < ptr_[ b + 1 ] ) tmp( i ) += A.val( k ) * x( A.col( k ) );
+      }
+    x = tmp;
+  }
+
+public:
+  // Blocks of bs consecutive rows; the last one may be smaller. bs is
+  // taken as 1 if not positive.
+  block_jacobi_conditioner( const matrix< Range >& A, int bs = 3 )
+    : preconditioner< Range >( A ), bs_( bs ), max_( 1 ), ptr_(), off_(), inv_( NULL )
+  {
+    if ( bs < 1 ) bs_ = bs = 1;
+    for ( int i = 0; i < A.m(); i += bs ) ptr_.push_back( i );
+    ptr_.push_back( A.m() );
+    if ( A.m() % bs != 0 ) bs_ = 0;
+    offsets_();
+  }
+  // Blocks of consecutive rows of the same node, e.g. of the same Element.
+  block_jacobi_conditioner( const matrix< Range >& A, const std::vector< int >& node )
+    : preconditioner< Range >( A ), bs_( 0 ), max_( 1 ), ptr_(), off_(), inv_( NULL )
+  {
+    assert( static_cast< int >( node.size() ) == A.m() );
+    for ( int i = 0; i < A.m(); ++i ) if ( i == 0 || node[ i ] != node[ i - 1 ] ) ptr_.push_back( i );
+    ptr_.push_back( A.m() );
+    offsets_();
+  }
+  ~block_jacobi_conditioner()
+  {
+    destruct();
+  }
+
+  int blocks() const { return ptr_.size() - 1; }
+
+  // Forms the inverses of the diagonal blocks, in a batch.
+  void factor()
+  {
+    if ( inv_ == NULL ) inv_ = new Range[ off_.back() ];
+    switch ( bs_ )
+    {
+    case 1: factor_< 1 >(); break;
+    case 2: factor_< 2 >(); break;
+    case 3: factor_< 3 >(); break;
+    case 4: factor_< 4 >(); break;
+    case 6: factor_< 6 >(); break;
+    default: factor_< 0 >(); break;
+    }
+  }
+
+  size_t mem() const
+  {
+    return sizeof( int ) * ( ptr_.size() + off_.size() ) + sizeof( Range ) * off_.back();
+  }
+};
+
+}
+
+#endif//__ELAI_BLOCK_JACOBI_CONDITIONER__
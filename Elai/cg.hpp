@@ -43,7 +43,7 @@ class cg : public ksp< Coef >
 protected:
   bool solve_( vector< Coef >& x )
   {
-    Coef res, res0, rho0;
+    Coef res, res0, rho, rho0, norm;
 
     if ( is_trivial( b_ ) )
     {
@@ -52,8 +52,12 @@ protected:
       return true;
     }
 
-    r_ = b_ - A_ * x;
-    res = res0 = sync_norm( r_ );
+    residual( r_, x );
+    ELAI_SYNC( r_ );
+    ELAI_PROD_DEFER( rho, r_, r_ );
+    ELAI_PROD_DEFER( norm, x, x );
+    ELAI_REDUCE();
+    res = res0 = sqrt( rho );
     rho0 = static_cast< Coef >( 1. );
     p_ = static_cast< Coef >( 0. );
     if ( is_trivial( res0 ) ) return true;
@@ -61,9 +65,8 @@ protected:
     for ( int i = 0; i < iter_max(); ++i )
     {
       bool converged = false;
-      Coef alpha, beta, rho, pq;
+      Coef alpha, beta, pq;
 
-      Coef norm = x * x;
 #ifdef ELAI_DEBUG
       std::cerr << " ||x||=" << norm
                 << " ||Ax-b||=" << res
@@ -73,17 +76,14 @@ protected:
       else if ( rel_converged( res, res0 ) || abs_converged( res ) ) converged = true;
       else if ( !is_trivial( norm ) && rel_converged( res, norm ) ) converged = true;
 
-      if ( isOK( converged ) ) return true;
-
-      ELAI_PROD( rho, r_, r_ );
+      if ( converged ) return true;
 
       beta = rho / rho0;
       rho0 = rho;
       q_ = r_ + beta * p_;
       p_ = q_;
 
-      q_ = A_ * p_;
-      ELAI_SYNC( q_ );
+      ELAI_SPMV( q_, p_ );
 
       ELAI_PROD( pq, p_, q_ );
 
@@ -93,7 +93,10 @@ protected:
       y_ = r_ - alpha * q_;
       r_ = y_;
 
-      res = fix_norm( r_ );
+      ELAI_PROD_DEFER( rho, r_, r_ );
+      ELAI_PROD_DEFER( norm, x, x );
+      ELAI_REDUCE();
+      res = sqrt( rho );
     }
 
     return false;
@@ -101,7 +104,7 @@ protected:
 
   bool solveP_( vector< Coef >& x )
   {
-    Coef res, res0, rho0;
+    Coef res, res0, rho, rho0, rr, norm;
 
     if ( is_trivial( b_ ) )
     {
@@ -110,8 +113,20 @@ protected:
       return true;
     }
 
-    r_ = b_ - A_ * x;
-    res = res0 = sync_norm( r_ );
+    residual( r_, x );
+    ELAI_SYNC( r_ );
+
+    // Preconditioning:
+    ELAI_PROF_BEG( prec_elapsed_ );
+    P_->apply( r_, z_ );
+    ELAI_SYNC( z_ );
+    ELAI_PROF_END( prec_elapsed_ );
+
+    ELAI_PROD_DEFER( rr, r_, r_ );
+    ELAI_PROD_DEFER( rho, r_, z_ );
+    ELAI_PROD_DEFER( norm, x, x );
+    ELAI_REDUCE();
+    res = res0 = sqrt( rr );
     rho0 = static_cast< Coef >( 1. );
     p_ = static_cast< Coef >( 0. );
     if ( is_trivial( res0 ) ) return true;
@@ -119,9 +134,8 @@ protected:
     for ( int i = 0; i < iter_max(); ++i )
     {
       bool converged = false;
-      Coef alpha, beta, rho, pq;
+      Coef alpha, beta, pq;
 
-      Coef norm = x * x;
 #ifdef ELAI_DEBUG
       std::cerr << " ||x||=" << norm
                 << " ||Ax-b||=" << res
@@ -131,26 +145,14 @@ protected:
       else if ( rel_converged( res, res0 ) || abs_converged( res ) ) converged = true;
       else if ( !is_trivial( norm ) && rel_converged( res, norm ) ) converged = true;
 
-      if ( isOK( converged ) ) return true;
-
-      z_ = r_;
-
-      // Preconditioning:
-      ELAI_PROF_BEG( prec_elapsed_ );
-      P_->forward( z_ );
-      P_->backward( z_ );
-      ELAI_SYNC( z_ );
-      ELAI_PROF_END( prec_elapsed_ );
-
-      ELAI_PROD( rho, r_, z_ );
+      if ( converged ) return true;
 
       beta = rho / rho0;
       rho0 = rho;
       q_ = z_ + beta * p_;
       p_ = q_;
 
-      q_ = A_ * p_;
-      ELAI_SYNC( q_ );
+      ELAI_SPMV( q_, p_ );
 
       ELAI_PROD( pq, p_, q_ );
 
@@ -160,7 +162,18 @@ protected:
       y_ = r_ - alpha * q_;
       r_ = y_;
 
-      res = fix_norm( r_ );
+      // Preconditioning:
+      ELAI_PROF_BEG( prec_elapsed_ );
+      P_->apply( r_, z_ );
+      ELAI_SYNC( z_ );
+      ELAI_PROF_END( prec_elapsed_ );
+
+      // r^t r, r^t z and x^t x in one reduction.
+      ELAI_PROD_DEFER( rr, r_, r_ );
+      ELAI_PROD_DEFER( rho, r_, z_ );
+      ELAI_PROD_DEFER( norm, x, x );
+      ELAI_REDUCE();
+      res = sqrt( rr );
     }
 
     return false;
@@ -181,7 +194,23 @@ public:
       , coherent
 #endif
       )
-    , p_( A_.m() ), q_( A_.m() ), r_( A_.m() ), y_( A_.m() ), z_( A_.m() )
+    , p_( m() ), q_( m() ), r_( m() ), y_( m() ), z_( m() )
+  {}
+  cg
+    ( const linear_map< Coef >& A
+    , const vector< Coef >& b
+    , const preconditioner< Coef > *P = NULL
+#ifdef ELAI_USE_MPI
+    , coherence *coherent = NULL
+#endif
+    )
+    : ksp< Coef >
+      ( A, b, P
+#ifdef ELAI_USE_MPI
+      , coherent
+#endif
+      )
+    , p_( m() ), q_( m() ), r_( m() ), y_( m() ), z_( m() )
   {}
   ~cg() {}
 
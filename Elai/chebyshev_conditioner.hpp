@@ -0,0 +1,270 @@
+/*
+ *
+ * Elastic Linear Algebra Interface (ELAI)
+ *
+ * Copyright 2013-2015 H. KOSHIMOTO, AIST
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __ELAI_CHEBYSHEV_CONDITIONER__
+#define __ELAI_CHEBYSHEV_CONDITIONER__
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "def.hpp"
+#include "expression.hpp"
+#include "coherence.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "blas.hpp"
+#include "preconditioner.hpp"
+
+namespace elai
+{
+
+// M^-1 = p( D^-1 A ) D^-1, where p is the Chebyshev polynomial of the given
+// degree on [ lmin, lmax ] of D^-1 A. The bounds are estimated by Lanczos
+// iterations in the D-inner product; M is not formed, and its application
+// takes only matrix*vector products and no inner products.
+template< class Range >
+class chebyshev_conditioner : public preconditioner< Range >
+{
+  int degree_;
+  Range lmin_, lmax_;
+  vector< Range > diag_, dinv_;
+  mutable vector< Range > r_, d_, t_;
+#ifdef ELAI_USE_MPI
+  coherence *coherent_;
+#endif
+
+  // The halo exchange before each matrix*vector product.
+  void sync_( vector< Range >& x ) const
+  {
+#ifdef ELAI_USE_MPI
+    if ( coherent_ != NULL ) ( *coherent_ )( x.val() );
+#endif
+  }
+
+  // u^t |D| v over the owned elements, reduced on all ranks.
+  Range dot_( const vector< Range >& u, const vector< Range >& v ) const
+  {
+    Range acc = static_cast< Range >( 0 );
+
+#ifdef ELAI_USE_MPI
+    if ( coherent_ != NULL )
+    {
+      vector< Range > w( v );
+
+      for ( int i = 0; i < w.m(); ++i ) w( i ) *= fabs( diag_( i ) );
+      acc = coherent_->prod( u.val(), w.val(), u.m() );
+      coherent_->reduce( &acc );
+      return acc;
+    }
+#endif
+    for ( int i = 0; i < u.m(); ++i ) acc += u( i ) * fabs( diag_( i ) ) * v( i );
+
+    return acc;
+  }
+
+  // The number of eigenvalues below x of the tridiagonal ( a, b ), by Sturm.
+  static int count_( const std::vector< Range >& a, const std::vector< Range >& b, Range x )
+  {
+    const Range tiny = static_cast< Range >( 1e-300 );
+    Range q = a[ 0 ] - x;
+    int c = q < 0 ? 1 : 0;
+
+    for ( unsigned int i = 1; i < a.size(); ++i )
+    {
+      if ( q == static_cast< Range >( 0 ) ) q = tiny;
+      q = a[ i ] - x - b[ i - 1 ] * b[ i - 1 ] / q;
+      if ( q < 0 ) ++c;
+    }
+
+    return c;
+  }
+
+  // The k-th smallest eigenvalue of the tridiagonal, by bisection.
+  static Range eigen_( const std::vector< Range >& a, const std::vector< Range >& b, int k )
+  {
+    Range lo = a[ 0 ], hi = a[ 0 ];
+
+    // Gershgorin discs.
+    for ( unsigned int i = 0; i < a.size(); ++i )
+    {
+      Range r = static_cast< Range >( 0 );
+
+      if ( 0 < i ) r += fabs( b[ i - 1 ] );
+      if ( i + 1 < a.size() ) r += fabs( b[ i ] );
+      lo = std::min( lo, a[ i ] - r );
+      hi = std::max( hi, a[ i ] + r );
+    }
+    for ( int it = 0; it < 100 && lo < hi; ++it )
+    {
+      Range mid = ( lo + hi ) / 2;
+
+      if ( mid <= lo || hi <= mid ) break;
+      if ( k < count_( a, b, mid ) ) hi = mid;
+      else lo = mid;
+    }
+
+    return ( lo + hi ) / 2;
+  }
+
+protected:
+  void forward_( vector< Range >& x ) const
+  {
+    vector< Range > in( x );
+
+    apply_( in, x );
+  }
+  void backward_( vector< Range >& x ) const {}
+  void forwardInv_( vector< Range >& x ) const {} // M is not formed.
+  void backwardInv_( vector< Range >& x ) const {}
+  void apply_( const vector< Range >& in, vector< Range >& out ) const
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+    const int m = A.m();
+    const Range theta = ( lmax_ + lmin_ ) / 2, delta = ( lmax_ - lmin_ ) / 2;
+    Range rho = delta / theta;
+
+    if ( out.m() != m ) out.setup( m );
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < m; ++i )
+    {
+      r_( i ) = dinv_( i ) * in( i );
+      d_( i ) = r_( i ) / theta;
+      out( i ) = d_( i );
+    }
+    if ( delta <= static_cast< Range >( 0 ) ) return;
+
+    // The three-term recurrence of the Chebyshev iteration from x = 0.
+    for ( int k = 0; k < degree_; ++k )
+    {
+      const Range rho1 = static_cast< Range >( 1 ) / ( 2 * theta / delta - rho );
+      const Range c = rho1 * rho, s = 2 * rho1 / delta;
+
+      sync_( d_ );
+      t_ = A * d_;
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for ( int i = 0; i < m; ++i )
+      {
+        r_( i ) -= dinv_( i ) * t_( i );
+        d_( i ) = c * d_( i ) + s * r_( i );
+        out( i ) += d_( i );
+      }
+      rho = rho1;
+    }
+  }
+
+public:
+  chebyshev_conditioner
+    ( const matrix< Range >& A
+    , int degree = 3
+#ifdef ELAI_USE_MPI
+    , coherence *coherent = NULL
+#endif
+    )
+    : preconditioner< Range >( A ), degree_( degree )
+    , lmin_( static_cast< Range >( 1 ) ), lmax_( static_cast< Range >( 1 ) )
+    , diag_( A.m() ), dinv_( A.m() ), r_( A.m() ), d_( A.m() ), t_( A.m() )
+#ifdef ELAI_USE_MPI
+    , coherent_( coherent )
+#endif
+  {}
+
+  int degree() const { return degree_; }
+  int degree( int degree )
+  {
+    int old = degree_;
+
+    degree_ = degree;
+
+    return old;
+  }
+
+  Range lmin() const { return lmin_; }
+  Range lmax() const { return lmax_; }
+  // Fixes the bounds of D^-1 A, instead of estimating them.
+  void bounds( Range lmin, Range lmax )
+  {
+    lmin_ = lmin;
+    lmax_ = lmax;
+  }
+
+  // Takes D and estimates the bounds by iters Lanczos steps (collective).
+  // lmax is enlarged by 10%, since an underestimate makes M indefinite.
+  // With 0 < ratio, lmin is at least lmax / ratio, as for a smoother.
+  void factor( int iters = 10, Range ratio = static_cast< Range >( 0 ) )
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+    const int m = A.m();
+    std::vector< Range > a, b;
+    vector< Range > v( m ), vp( m ), w( m );
+    Range beta;
+
+    for ( int i = 0; i < m; ++i )
+    {
+      diag_( i ) = A( i, i );
+      dinv_( i ) = diag_( i ) == static_cast< Range >( 0 )
+                 ? static_cast< Range >( 1 ) : static_cast< Range >( 1 ) / diag_( i );
+      // A fixed start, rich in all modes.
+      v( i ) = static_cast< Range >( 1 + ( i * 7 ) % 11 );
+      vp( i ) = static_cast< Range >( 0 );
+    }
+    beta = std::sqrt( dot_( v, v ) );
+    for ( int i = 0; i < m; ++i ) v( i ) /= beta;
+    beta = static_cast< Range >( 0 );
+
+    for ( int j = 0; j < iters; ++j )
+    {
+      Range alpha;
+
+      sync_( v );
+      w = A * v;
+      for ( int i = 0; i < m; ++i ) w( i ) = dinv_( i ) * w( i ) - beta * vp( i );
+      alpha = dot_( w, v );
+      for ( int i = 0; i < m; ++i ) w( i ) -= alpha * v( i );
+      a.push_back( alpha );
+      beta = dot_( w, w );
+      if ( beta <= static_cast< Range >( 1e-28 ) * alpha * alpha ) break;
+      beta = std::sqrt( beta );
+      b.push_back( beta );
+      for ( int i = 0; i < m; ++i )
+      {
+        vp( i ) = v( i );
+        v( i ) = w( i ) / beta;
+      }
+    }
+
+    if ( a.empty() ) return;
+    lmax_ = static_cast< Range >( 1.1 ) * eigen_( a, b, a.size() - 1 );
+    lmin_ = eigen_( a, b, 0 );
+    if ( static_cast< Range >( 0 ) < ratio ) lmin_ = std::max( lmin_, lmax_ / ratio );
+    if ( lmin_ <= static_cast< Range >( 0 ) ) lmin_ = lmax_ / 30;
+  }
+
+  size_t mem() const
+  {
+    return sizeof( Range ) * 5 * diag_.m();
+  }
+};
+
+}
+
+#endif//__ELAI_CHEBYSHEV_CONDITIONER__
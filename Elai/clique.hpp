@@ -33,6 +33,8 @@ namespace elai
 template< class Element, class Neighbour >
 class clique
 {
+  typedef struct space< Element >::const_point Point;
+
   const space< Element >& s_;
   const family< Element, Neighbour >& tau_;
 
@@ -20,13 +20,21 @@
 #ifndef __ELAI_COHERENCE__
 #define __ELAI_COHERENCE__
 
+#include <algorithm>
 #include <complex>
+#include <map>
 #include <vector>
 #include <utility>
 #include "def.hpp"
 
 #ifdef ELAI_USE_MPI
 #include "mpi.h"
+#ifdef ELAI_USE_MPI_SHM
+extern "C"
+{
+#include <sched.h>
+}
+#endif
 
 namespace elai
 {
@@ -34,32 +42,307 @@ namespace elai
 class coherent_type
 {
 public:
-  coherent_type( MPI_Datatype pair_type, int pair_rank )
-    : type( pair_type ), pair( pair_rank )
+  coherent_type( MPI_Datatype pair_type, int pair_rank, int pair_count = 1, MPI_Aint pair_disp = 0 )
+    : type( pair_type ), pair( pair_rank ), count( pair_count ), disp( pair_disp )
   {}
   coherent_type( const coherent_type& v )
-    : type( v.type ), pair( v.pair )
+    : type( v.type ), pair( v.pair ), count( v.count ), disp( v.disp )
   {}
   coherent_type( std::pair< MPI_Datatype, int >& v )
-    : type( v.first ), pair( v.second )
+    : type( v.first ), pair( v.second ), count( 1 ), disp( 0 )
   {}
   coherent_type( std::pair< MPI_Datatype, int > *it )
-    : type( it->first ), pair( it->second )
+    : type( it->first ), pair( it->second ), count( 1 ), disp( 0 )
   {}
+  void *address( void *base ) const { return static_cast< char * >( base ) + disp; }
   MPI_Datatype type;
   int pair;
+  int count;     // of type
+  MPI_Aint disp; // in bytes from the base
 };
 
 class coherence
 {
   typedef std::vector< coherent_type > Slot;
   typedef std::vector< int > ESlot;
+  // The persistent requests of a base, and when they were last started.
+  struct persistent_req
+  {
+    persistent_req( MPI_Request *r, unsigned long t ) : req( r ), used( t ) {}
+    MPI_Request *req;
+    unsigned long used;
+  };
+  typedef std::map< void *, persistent_req > Persistent;
 
-  int myself_;
+  // Bases with persistent requests at a time; the least recently used one
+  // gives its requests up for a new base.
+  enum { PERSISTENT_MAX = 32 };
+
+  int myself_, m_, owned_;
   MPI_Comm comm_;
   Slot rslot_, wslot_;
-  ESlot eslot_;
-  MPI_Request *req_;
+  ESlot eslot_, bslot_;
+  MPI_Request *req_, *active_;
+  Persistent preq_;
+  unsigned long tick_;
+
+#ifdef ELAI_USE_MPI_SHM
+  // A neighbour on the same node; the writer packs the slot into its own
+  // segment of the shared window and the reader unpacks it from there.
+  // Flags carry the sequence number of the exchange: mine is in this
+  // segment ( ready for a write, done for a read ) and theirs is the
+  // counterpart in the segment of the peer.
+  struct shared_slot
+  {
+    shared_slot( const coherent_type& s, int p )
+      : slot( s ), peer( p ), size( 0 ), mine( NULL ), theirs( NULL )
+    { buf[ 0 ] = buf[ 1 ] = NULL; }
+    coherent_type slot;
+    int peer; // in node_
+    int size; // packed bytes
+    char *buf[ 2 ];
+    volatile long *mine, *theirs;
+  };
+  typedef std::vector< shared_slot > SSlot;
+
+  MPI_Comm node_, leaders_;
+  MPI_Win win_;
+  char *shm_;
+  SSlot srslot_, swslot_;
+  long seq_;
+  void *shm_base_;
+
+  // Moves the slots of the neighbours on the same node to the window.
+  // The network slots keep only the ranks on the other nodes.
+  void shm_setup()
+  {
+    MPI_Group group, local;
+    int myrank;
+
+    MPI_Comm_split_type( comm_, MPI_COMM_TYPE_SHARED, myself_, MPI_INFO_NULL, &node_ );
+    MPI_Comm_rank( node_, &myrank );
+    MPI_Comm_split( comm_, myrank == 0 ? 0 : MPI_UNDEFINED, myself_, &leaders_ );
+    MPI_Comm_group( comm_, &group );
+    MPI_Comm_group( node_, &local );
+
+    Slot r, w;
+
+    for ( unsigned int i = 0; i < rslot_.size(); ++i )
+    {
+      int peer;
+
+      MPI_Group_translate_ranks( group, 1, &rslot_[ i ].pair, local, &peer );
+      if ( peer == MPI_UNDEFINED ) r.push_back( rslot_[ i ] );
+      else srslot_.push_back( shared_slot( rslot_[ i ], peer ) );
+    }
+    for ( unsigned int i = 0; i < wslot_.size(); ++i )
+    {
+      int peer;
+
+      MPI_Group_translate_ranks( group, 1, &wslot_[ i ].pair, local, &peer );
+      if ( peer == MPI_UNDEFINED ) w.push_back( wslot_[ i ] );
+      else swslot_.push_back( shared_slot( wslot_[ i ], peer ) );
+    }
+    rslot_.swap( r );
+    wslot_.swap( w );
+    MPI_Group_free( &local );
+    MPI_Group_free( &group );
+
+    // Layout: flags of the writes and the reads, then two halves of data.
+    int nflag = swslot_.size() + srslot_.size();
+    MPI_Aint head = ( ( sizeof( long ) * nflag + CACHE_LINE - 1 ) / CACHE_LINE ) * CACHE_LINE;
+    MPI_Aint half = 0;
+
+    for ( unsigned int i = 0; i < swslot_.size(); ++i )
+    {
+      shared_slot& slot( swslot_[ i ] );
+
+      MPI_Pack_size( slot.slot.count, slot.slot.type, comm_, &slot.size );
+      half += slot.size;
+    }
+    MPI_Win_allocate_shared( head + 2 * half, 1, MPI_INFO_NULL, node_, &shm_, &win_ );
+    MPI_Win_lock_all( MPI_MODE_NOCHECK, win_ );
+
+    volatile long *flag = reinterpret_cast< volatile long * >( shm_ );
+
+    for ( int i = 0; i < nflag; ++i ) flag[ i ] = 0;
+    MPI_Win_sync( win_ );
+
+    // Tell the peers where to look, in the order of the slots.
+    std::vector< long > wmsg( 3 * swslot_.size() ), rmsg( srslot_.size() );
+    std::vector< long > wans( swslot_.size() ), rans( 3 * srslot_.size() );
+    MPI_Request *req = new MPI_Request[ nflag ];
+    MPI_Aint disp = head;
+
+    for ( unsigned int i = 0; i < swslot_.size(); ++i )
+    {
+      shared_slot& slot( swslot_[ i ] );
+
+      slot.mine = &flag[ i ];
+      slot.buf[ 0 ] = shm_ + disp;
+      slot.buf[ 1 ] = shm_ + disp + half;
+      wmsg[ 3 * i ] = i;
+      wmsg[ 3 * i + 1 ] = disp;
+      wmsg[ 3 * i + 2 ] = half;
+      disp += slot.size;
+      MPI_Isend( &wmsg[ 3 * i ], 3, MPI_LONG, slot.peer, 0, node_, &req[ i ] );
+    }
+    for ( unsigned int i = 0, j = swslot_.size(); i < srslot_.size(); ++i, ++j )
+    {
+      shared_slot& slot( srslot_[ i ] );
+
+      slot.mine = &flag[ j ];
+      rmsg[ i ] = j;
+      MPI_Isend( &rmsg[ i ], 1, MPI_LONG, slot.peer, 1, node_, &req[ j ] );
+    }
+    for ( unsigned int i = 0; i < srslot_.size(); ++i )
+      MPI_Recv( &rans[ 3 * i ], 3, MPI_LONG, srslot_[ i ].peer, 0, node_, MPI_STATUS_IGNORE );
+    for ( unsigned int i = 0; i < swslot_.size(); ++i )
+      MPI_Recv( &wans[ i ], 1, MPI_LONG, swslot_[ i ].peer, 1, node_, MPI_STATUS_IGNORE );
+    if ( 0 < nflag ) MPI_Waitall( nflag, req, MPI_STATUSES_IGNORE );
+    delete [] req;
+
+    for ( unsigned int i = 0; i < srslot_.size(); ++i )
+    {
+      shared_slot& slot( srslot_[ i ] );
+      MPI_Aint size;
+      int unit;
+      char *base;
+
+      MPI_Win_shared_query( win_, slot.peer, &size, &unit, &base );
+      slot.theirs = reinterpret_cast< volatile long * >( base ) + rans[ 3 * i ];
+      slot.buf[ 0 ] = base + rans[ 3 * i + 1 ];
+      slot.buf[ 1 ] = base + rans[ 3 * i + 1 ] + rans[ 3 * i + 2 ];
+      MPI_Pack_size( slot.slot.count, slot.slot.type, comm_, &slot.size );
+    }
+    for ( unsigned int i = 0; i < swslot_.size(); ++i )
+    {
+      shared_slot& slot( swslot_[ i ] );
+      MPI_Aint size;
+      int unit;
+      char *base;
+
+      MPI_Win_shared_query( win_, slot.peer, &size, &unit, &base );
+      slot.theirs = reinterpret_cast< volatile long * >( base ) + wans[ i ];
+    }
+  }
+
+  // Yields while spinning, since ranks may share a core.
+  void shm_wait_( volatile long *flag, long seq ) const
+  {
+    while ( *flag < seq )
+    {
+      sched_yield();
+      MPI_Win_sync( win_ );
+    }
+  }
+
+  // Double buffering: a half is reused two exchanges later, once the
+  // reader has marked it done.
+  void shm_write_( void *base )
+  {
+    if ( swslot_.empty() && srslot_.empty() ) return;
+    ++seq_;
+    shm_base_ = base;
+
+    int k = seq_ & 1;
+
+    for ( SSlot::iterator it = swslot_.begin(); it != swslot_.end(); ++it )
+    {
+      int pos = 0;
+
+      shm_wait_( it->theirs, seq_ - 2 );
+      MPI_Pack( it->slot.address( base ), it->slot.count, it->slot.type, it->buf[ k ], it->size, &pos, comm_ );
+    }
+    MPI_Win_sync( win_ );
+    for ( SSlot::iterator it = swslot_.begin(); it != swslot_.end(); ++it ) *it->mine = seq_;
+    MPI_Win_sync( win_ );
+  }
+
+  void shm_read_()
+  {
+    if ( shm_base_ == NULL ) return;
+
+    int k = seq_ & 1;
+
+    for ( SSlot::iterator it = srslot_.begin(); it != srslot_.end(); ++it )
+    {
+      int pos = 0;
+
+      shm_wait_( it->theirs, seq_ );
+      MPI_Win_sync( win_ );
+      MPI_Unpack( it->buf[ k ], it->size, &pos, it->slot.address( shm_base_ ), it->slot.count, it->slot.type, comm_ );
+    }
+    MPI_Win_sync( win_ );
+    for ( SSlot::iterator it = srslot_.begin(); it != srslot_.end(); ++it ) *it->mine = seq_;
+    MPI_Win_sync( win_ );
+    shm_base_ = NULL;
+  }
+#endif
+
+  void free_persistent_( Persistent::iterator it )
+  {
+    int finalized = 0;
+
+    MPI_Finalized( &finalized );
+    if ( !finalized )
+      for ( unsigned int i = 0; i < rslot_.size() + wslot_.size(); ++i ) MPI_Request_free( &it->second.req[ i ] );
+    delete [] it->second.req;
+    preq_.erase( it );
+  }
+
+  // Solvers exchange the same vectors over and over, so requests for each
+  // base address are set up once and restarted afterwards.
+  MPI_Request *persistent( void *base )
+  {
+    Persistent::iterator it = preq_.find( base );
+
+    if ( it != preq_.end() )
+    {
+      it->second.used = ++tick_;
+
+      return it->second.req;
+    }
+    if ( PERSISTENT_MAX <= preq_.size() )
+    {
+      Persistent::iterator lru = preq_.begin();
+
+      for ( it = preq_.begin(); it != preq_.end(); ++it )
+        if ( it->second.used < lru->second.used ) lru = it;
+      free_persistent_( lru );
+    }
+
+    MPI_Request *req = new MPI_Request[ rslot_.size() + wslot_.size() ];
+
+    for ( unsigned int i = 0; i < rslot_.size(); ++i )
+    {
+      coherent_type& slot( rslot_[ i ] );
+
+      MPI_Recv_init( slot.address( base ), slot.count, slot.type, slot.pair, myself_, comm_, &req[ i ] );
+    }
+    for ( unsigned int i = 0, j = rslot_.size(); i < wslot_.size(); ++i, ++j )
+    {
+      coherent_type& slot( wslot_[ i ] );
+
+      MPI_Send_init( slot.address( base ), slot.count, slot.type, slot.pair, slot.pair, comm_, &req[ j ] );
+    }
+    preq_.insert( Persistent::value_type( base, persistent_req( req, ++tick_ ) ) );
+
+    return req;
+  }
+
+  // Ghost-last numbering makes the external elements a tail of the local ones.
+  void owned_setup()
+  {
+    ESlot e( eslot_ );
+
+    owned_ = -1;
+    if ( m_ < 0 ) return;
+    std::sort( e.begin(), e.end() );
+    for ( unsigned int i = 0; i < e.size(); ++i )
+      if ( e[ i ] != m_ - static_cast< int >( e.size() ) + static_cast< int >( i ) ) return;
+    owned_ = m_ - e.size();
+  }
 
   template< class Coef >
   Coef fix_prod( const Coef& a, const Coef& b ) const { return a * b; }
@@ -78,36 +361,132 @@ public:
   */
   template< class Target >
   coherence( Target& obj, MPI_Comm comm )
-    : myself_( -1 ), comm_( comm ), rslot_(), wslot_(), eslot_(), req_( NULL )
+    : myself_( -1 ), m_( -1 ), owned_( -1 ), comm_( comm ), rslot_(), wslot_(), eslot_(), bslot_()
+    , req_( NULL ), active_( NULL ), preq_(), tick_( 0 )
+#ifdef ELAI_USE_MPI_SHM
+    , node_( MPI_COMM_NULL ), leaders_( MPI_COMM_NULL ), win_( MPI_WIN_NULL ), shm_( NULL )
+    , srslot_(), swslot_(), seq_( 0 ), shm_base_( NULL )
+#endif
   {
     MPI_Comm_rank( comm_, &myself_ );
     obj.coherence_setup( *this );
-    if ( 0 < rslot_.size() ) req_ = new MPI_Request[ rslot_.size() ];
+    owned_setup();
+    std::sort( bslot_.begin(), bslot_.end() );
+    bslot_.erase( std::unique( bslot_.begin(), bslot_.end() ), bslot_.end() );
+#ifdef ELAI_USE_MPI_SHM
+    shm_setup();
+#endif
+    if ( 0 < rslot_.size() + wslot_.size() ) req_ = new MPI_Request[ rslot_.size() + wslot_.size() ];
   }
   ~coherence()
   {
+    int finalized = 0;
+
+    MPI_Finalized( &finalized );
+    while ( !preq_.empty() ) free_persistent_( preq_.begin() );
     if ( req_ != NULL ) { delete [] req_; req_ = NULL; }
+#ifdef ELAI_USE_MPI_SHM
+    if ( !finalized && win_ != MPI_WIN_NULL )
+    {
+      MPI_Win_unlock_all( win_ );
+      MPI_Win_free( &win_ );
+    }
+    if ( !finalized && leaders_ != MPI_COMM_NULL ) MPI_Comm_free( &leaders_ );
+    if ( !finalized && node_ != MPI_COMM_NULL ) MPI_Comm_free( &node_ );
+#endif
   }
 
   int myself() const { return myself_; }
-  MPI_Comm comm() { return comm_; }
+  MPI_Comm comm() const { return comm_; }
+  // The number of leading elements owned by this rank, or -1 unless ghost-last.
+  int owned() const { return owned_; }
+#ifdef ELAI_USE_MPI_SHM
+  // The ranks on this node, and the node leaders ( MPI_COMM_NULL elsewhere ).
+  MPI_Comm node() const { return node_; }
+  MPI_Comm leaders() const { return leaders_; }
+#endif
 
-  void operator()( void *base )
+  // Split-phase exchange: begin() posts all the transfers and end() waits
+  // them. Between the two, only the elements neither written to nor read
+  // from the neighbours may be touched.
+  void begin( void *base )
   {
+    int n = rslot_.size() + wslot_.size();
+
     if ( comm_ == NULL ) return;
+#ifdef ELAI_USE_MPI_SHM
+    shm_write_( base );
+#endif
+    if ( n == 0 ) return;
+    active_ = persistent( base );
+    if ( active_ != NULL )
+    {
+      MPI_Startall( n, active_ );
+      return;
+    }
+    active_ = req_;
     for ( unsigned int i = 0; i < rslot_.size(); ++i )
     {
       coherent_type& slot( rslot_[ i ] );
 
-      MPI_Irecv( base, 1, slot.type, slot.pair, myself_, comm_, &req_[ i ] );
+      MPI_Irecv( slot.address( base ), slot.count, slot.type, slot.pair, myself_, comm_, &req_[ i ] );
     }
-    for ( unsigned int i = 0; i < wslot_.size(); ++i )
+    for ( unsigned int i = 0, j = rslot_.size(); i < wslot_.size(); ++i, ++j )
     {
       coherent_type& slot( wslot_[ i ] );
 
-      MPI_Send( base, 1, slot.type, slot.pair, slot.pair, comm_ );
+      MPI_Isend( slot.address( base ), slot.count, slot.type, slot.pair, slot.pair, comm_, &req_[ j ] );
     }
-    if ( 0 < rslot_.size() ) MPI_Waitall( rslot_.size(), req_, MPI_STATUSES_IGNORE );
+  }
+
+  void end()
+  {
+#ifdef ELAI_USE_MPI_SHM
+    shm_read_();
+#endif
+    if ( active_ == NULL ) return;
+    MPI_Waitall( rslot_.size() + wslot_.size(), active_, MPI_STATUSES_IGNORE );
+    active_ = NULL;
+  }
+
+  void operator()( void *base )
+  {
+    begin( base );
+    end();
+  }
+
+  // Frees the persistent requests bound to base, if any; owners call it
+  // before the storage goes away. Not between begin() and end() on base.
+  void release( void *base )
+  {
+    Persistent::iterator it = preq_.find( base );
+
+    if ( it == preq_.end() ) return;
+    assert( it->second.req != active_ );
+    free_persistent_( it );
+  }
+
+  // The number of bases holding persistent requests.
+  int persistents() const { return preq_.size(); }
+
+  // Splits m local rows into the boundary rows, which are written to the
+  // neighbours, and the interior rows. External rows are dropped because
+  // they are read from the neighbours anyway. Returns the number of the
+  // boundary rows, which come first in rows.
+  int classify( int m, std::vector< int >& rows ) const
+  {
+    std::vector< char > kind( m, 0 );
+
+    for ( ESlot::const_iterator it = eslot_.begin(); it != eslot_.end(); ++it ) kind[ *it ] = 2;
+    for ( ESlot::const_iterator it = bslot_.begin(); it != bslot_.end(); ++it ) kind[ *it ] = 1;
+    rows.clear();
+    for ( int i = 0; i < m; ++i ) if ( kind[ i ] == 1 ) rows.push_back( i );
+
+    int n = rows.size();
+
+    for ( int i = 0; i < m; ++i ) if ( kind[ i ] == 0 ) rows.push_back( i );
+
+    return n;
   }
 
   void read( MPI_Datatype pair_type, int pair_rank )
@@ -123,22 +502,207 @@ public:
   void exclude( int i )
   { eslot_.push_back( i ); }
 
+  void extent( int m )
+  { m_ = m; }
+
+  void boundary( int i )
+  { bslot_.push_back( i ); }
+
+  // Removes the products on external elements, without any communications.
   template< class Coef >
-  void fix( Coef *ptr, const Coef *lhs, const Coef *rhs ) const
+  void correct( Coef *ptr, const Coef *lhs, const Coef *rhs ) const
   {
     for ( typename ESlot::const_iterator it = eslot_.begin(); it != eslot_.end(); ++it )
       *ptr -= fix_prod( lhs[ *it ], rhs[ *it ] );
-    MPI_Allreduce( MPI_IN_PLACE, static_cast< void * >( ptr ), 1, mpi_< Coef >().type, MPI_SUM, comm_ );
+  }
+
+  // The local part of the product of m elements, without any communications.
+  // Under ghost-last numbering it runs on the owned elements only.
+  template< class Coef >
+  Coef prod( const Coef *lhs, const Coef *rhs, int m ) const
+  {
+    Coef acc = static_cast< Coef >( 0 );
+    int n = ( 0 <= owned_ && m == m_ ) ? owned_ : m;
+
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel
+    {
+      Coef part = static_cast< Coef >( 0 );
+
+      #pragma omp for nowait
+      for ( int i = 0; i < n; ++i ) part += fix_prod( lhs[ i ], rhs[ i ] );
+      #pragma omp critical
+      acc += part;
+    }
+#else
+    for ( int i = 0; i < n; ++i ) acc += fix_prod( lhs[ i ], rhs[ i ] );
+#endif
+    if ( n == m ) correct( &acc, lhs, rhs );
+
+    return acc;
+  }
+
+  template< class Coef >
+  void fix( Coef *ptr, const Coef *lhs, const Coef *rhs ) const
+  {
+    correct( ptr, lhs, rhs );
+    reduce( ptr );
+  }
+
+  template< class Coef >
+  void reduce( Coef *ptr ) const
+  {
+    allreduce( static_cast< void * >( ptr ), 1, mpi_< Coef >().type );
   }
 
   bool all_true( const bool flg ) const
   {
     int result = flg ? 0 : 1;
 
-    MPI_Allreduce( MPI_IN_PLACE, &result, 1, mpi_< int >().type, MPI_SUM, comm_ );
+    allreduce( &result, 1, mpi_< int >().type );
 
     return result == 0;
   }
+
+  // Sums n values over all ranks in place. With ELAI_USE_MPI_SHM, the sum
+  // is taken within each node, then over the node leaders only.
+  void allreduce( void *buf, int n, MPI_Datatype type ) const
+  {
+#ifdef ELAI_USE_MPI_SHM
+    if ( leaders_ != MPI_COMM_NULL )
+    {
+      MPI_Reduce( MPI_IN_PLACE, buf, n, type, MPI_SUM, 0, node_ );
+      MPI_Allreduce( MPI_IN_PLACE, buf, n, type, MPI_SUM, leaders_ );
+    }
+    else MPI_Reduce( buf, NULL, n, type, MPI_SUM, 0, node_ );
+    MPI_Bcast( buf, n, type, 0, node_ );
+#else
+    MPI_Allreduce( MPI_IN_PLACE, buf, n, type, MPI_SUM, comm_ );
+#endif
+  }
+};
+
+// Batched reductions over a coherence.
+// Partial products and flags are packed into one buffer, so that k values
+// cost a single round trip. begin() posts the reduction and end() waits it;
+// the registered variables must stay alive until end().
+template< class Coef >
+class coherent_reduction
+{
+  typedef std::vector< Coef > Buffer;
+  typedef std::vector< Coef * > PSlot;
+  typedef std::vector< bool * > FSlot;
+
+  const coherence *coherent_;
+  Buffer buf_;
+  PSlot pslot_;
+  FSlot fslot_;
+  MPI_Request req_;
+  bool pending_;
+
+  void clear()
+  {
+    pslot_.clear();
+    fslot_.clear();
+    pending_ = false;
+  }
+
+public:
+  coherent_reduction( const coherence *coherent = NULL )
+    : coherent_( coherent ), buf_(), pslot_(), fslot_(), req_( MPI_REQUEST_NULL ), pending_( false )
+  {}
+  ~coherent_reduction()
+  {
+    end();
+  }
+
+  int size() const { return pslot_.size() + fslot_.size(); }
+  bool pending() const { return pending_; }
+
+  // acc has to hold the local product of lhs and rhs.
+  coherent_reduction< Coef >& prod( Coef& acc, const Coef *lhs, const Coef *rhs )
+  {
+    if ( coherent_ != NULL ) coherent_->correct( &acc, lhs, rhs );
+
+    return sum( acc );
+  }
+
+  // acc has to hold a local value without external elements.
+  coherent_reduction< Coef >& sum( Coef& acc )
+  {
+    assert( !pending_ );
+    pslot_.push_back( &acc );
+
+    return *this;
+  }
+
+  // flg becomes true only if it is true on all ranks.
+  coherent_reduction< Coef >& flag( bool& flg )
+  {
+    assert( !pending_ );
+    fslot_.push_back( &flg );
+
+    return *this;
+  }
+
+  void begin()
+  {
+    if ( pending_ ) return;
+    pending_ = true;
+    if ( coherent_ == NULL || coherent_->comm() == NULL || size() == 0 ) return;
+
+    int k = 0;
+
+    buf_.resize( size() );
+    for ( typename PSlot::const_iterator it = pslot_.begin(); it != pslot_.end(); ++it )
+      buf_[ k++ ] = **it;
+    for ( typename FSlot::const_iterator it = fslot_.begin(); it != fslot_.end(); ++it )
+      buf_[ k++ ] = static_cast< Coef >( **it ? 0 : 1 );
+#if defined( ELAI_USE_MPI_SHM )
+    // Within the node here; end() finishes it over the node leaders.
+    if ( coherent_->leaders() != MPI_COMM_NULL )
+      MPI_Ireduce
+        ( MPI_IN_PLACE, &buf_[ 0 ], buf_.size(), mpi_< Coef >().type, MPI_SUM, 0, coherent_->node(), &req_ );
+    else
+      MPI_Ireduce
+        ( &buf_[ 0 ], NULL, buf_.size(), mpi_< Coef >().type, MPI_SUM, 0, coherent_->node(), &req_ );
+#elif defined( ELAI_USE_MPI3 )
+    MPI_Iallreduce
+      ( MPI_IN_PLACE, &buf_[ 0 ], buf_.size(), mpi_< Coef >().type, MPI_SUM, coherent_->comm(), &req_ );
+#else
+    MPI_Allreduce
+      ( MPI_IN_PLACE, &buf_[ 0 ], buf_.size(), mpi_< Coef >().type, MPI_SUM, coherent_->comm() );
+#endif
+  }
+
+  void end()
+  {
+    if ( !pending_ ) return;
+    if ( coherent_ == NULL || coherent_->comm() == NULL || size() == 0 ) { clear(); return; }
+
+    int k = 0;
+
+#ifdef ELAI_USE_MPI3
+    MPI_Wait( &req_, MPI_STATUS_IGNORE );
+#endif
+#ifdef ELAI_USE_MPI_SHM
+    if ( coherent_->leaders() != MPI_COMM_NULL )
+      MPI_Allreduce
+        ( MPI_IN_PLACE, &buf_[ 0 ], buf_.size(), mpi_< Coef >().type, MPI_SUM, coherent_->leaders() );
+    MPI_Bcast( &buf_[ 0 ], buf_.size(), mpi_< Coef >().type, 0, coherent_->node() );
+#endif
+    for ( typename PSlot::const_iterator it = pslot_.begin(); it != pslot_.end(); ++it )
+      **it = buf_[ k++ ];
+    for ( typename FSlot::const_iterator it = fslot_.begin(); it != fslot_.end(); ++it )
+      **it = buf_[ k++ ] == static_cast< Coef >( 0 );
+    clear();
+  }
+
+  void operator()()
+  {
+    begin();
+    end();
+  }
 };
 
 }
@@ -28,6 +28,7 @@
 //#define ELAI_USE_OPENMP
 //#define ELAI_USE_MPI
 //#define ELAI_USE_MPI3
+//#define ELAI_USE_MPI_SHM
 //#define ELAI_USE_MUMPS
 //#define ELAI_USE_SUPERLU
 //#define ELAI_USE_METIS
@@ -35,6 +36,10 @@
 
 #define ELAI_USE_METIS
 
+#if defined( ELAI_USE_MPI_SHM ) & !defined( ELAI_USE_MPI3 )
+#define ELAI_USE_MPI3
+#endif
+
 #if defined( ELAI_USE_MPI3 ) & !defined( ELAI_USE_MPI )
 #define ELAI_USE_MPI
 #endif
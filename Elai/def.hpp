@@ -25,6 +25,7 @@
 #include <complex>
 #include <cstddef>
 #include <cstdlib>
+#include <iostream>
 #include "config.hpp"
 #include "util.hpp"
 
@@ -55,6 +56,35 @@ template< typename Coef >
 std::complex< Coef > conj_( const std::complex< Coef >& v ) { return std::conj( v ); }
 
 #ifdef ELAI_USE_MPI
+// ELAI communicates only from the master thread outside of parallel regions,
+// so the hybrid execution needs MPI_THREAD_FUNNELED at least. If MPI
+// provides less, the kernels are limited to a single thread with a warning.
+// Returns the provided level of the thread support.
+inline int mpi_init( int *argc, char ***argv, int required = MPI_THREAD_FUNNELED )
+{
+  int provided = MPI_THREAD_SINGLE;
+
+#ifdef ELAI_USE_OPENMP
+  MPI_Init_thread( argc, argv, required, &provided );
+  if ( provided < required )
+  {
+    int rank;
+
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+    if ( rank == 0 )
+      std::cerr << "ELAI: MPI provides the thread level " << provided << " < " << required
+                << ", the kernels run on a single thread" << std::endl;
+    thread_limit() = 1;
+    omp_set_num_threads( 1 );
+  }
+#else
+  ( void )required;
+  MPI_Init( argc, argv );
+#endif
+
+  return provided;
+}
+
 template< typename T > class mpi_
 {
 public:
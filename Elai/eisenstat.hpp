@@ -0,0 +1,318 @@
+/*
+ *
+ * Elastic Linear Algebra Interface (ELAI)
+ *
+ * Copyright 2013-2015 H. KOSHIMOTO, AIST
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __ELAI_EISENSTAT__
+#define __ELAI_EISENSTAT__
+
+#include "def.hpp"
+#include "coherence.hpp"
+#include "expression.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "blas.hpp"
+#include "preconditioner.hpp"
+#include "sor_conditioner.hpp"
+#include "ksp.hpp"
+
+namespace elai
+{
+
+// SSOR-preconditioned solvers with Eisenstat's trick: with M = L' U' of
+// sor_conditioner, they iterate on L'^-1 A U'^-1 y = L'^-1 b and return
+// x = U'^-1 y. Each product costs two sweeps and no SpMV ( see
+// sor_conditioner::eisenstat ). The residuals are of the split system.
+// Neither the products nor the sweeps see other processors, so both
+// solvers are restricted to a single MPI process, and to the exact
+// splitting of sor_conditioner ( no hybrid ); they abort otherwise.
+
+template< class Coef >
+void eisenstat_check( const sor_conditioner< Coef >& S )
+{
+#ifdef ELAI_USE_MPI
+  int init, size = 1;
+
+  MPI_Initialized( &init );
+  if ( init ) MPI_Comm_size( MPI_COMM_WORLD, &size );
+  if ( size != 1 )
+  {
+    std::cerr << "THE EISENSTAT SOLVERS RUN ON A SINGLE PROCESS, NOT " << size << "." << std::endl;
+    MPI_Abort( MPI_COMM_WORLD, 1 );
+  }
+#endif
+  if ( S.hybrid() != 0 )
+  {
+    std::cerr << "THE EISENSTAT SOLVERS NEED SOR_CONDITIONER WITHOUT HYBRID." << std::endl;
+    std::abort();
+  }
+}
+
+// CG in the inner product of G = ( 2 - w ) / w D, where the split operator
+// is self-adjoint for symmetric A.
+template< class Coef >
+class eisenstat_cg : public ksp< Coef >
+{
+  ELAI_USE_KSP;
+
+  const sor_conditioner< Coef >& S_;
+  // WORKSPACE
+  vector< Coef > g_, p_, q_, r_, t_, y_;
+
+  Coef gprod_( const vector< Coef >& u, const vector< Coef >& v ) const
+  {
+    Coef acc = static_cast< Coef >( 0. );
+
+    for ( int i = 0; i < u.m(); ++i ) acc += g_( i ) * u( i ) * v( i );
+
+    return acc;
+  }
+
+protected:
+  bool solve_( vector< Coef >& x ) { return solveP_( x ); }
+
+  bool solveP_( vector< Coef >& x )
+  {
+    const int m = A_.m();
+    const Coef s = ( static_cast< Coef >( 2. ) - S_.omega() ) / S_.omega();
+    Coef res, res0, rho, norm;
+    bool flg = false;
+
+    if ( is_trivial( b_ ) )
+    {
+      x = b_;
+
+      return true;
+    }
+
+    for ( int i = 0; i < m; ++i ) g_( i ) = s * S_.diag( i );
+    S_.upper( x, y_ );
+    S_.eisenstat( y_, q_, t_ );
+    r_ = b_;
+    S_.forward( r_ );
+    p_ = r_ - q_;
+    r_ = p_;
+    rho = gprod_( r_, r_ );
+    ELAI_PROD( res, r_, r_ );
+    res = res0 = sqrt( res );
+    if ( is_trivial( res0 ) ) return true;
+
+    for ( int i = 0; i < iter_max(); ++i )
+    {
+      bool converged = false;
+      Coef alpha, beta, pq, rho1;
+
+      ELAI_PROD( norm, y_, y_ );
+#ifdef ELAI_DEBUG
+      std::cerr << " ||x||=" << norm
+                << " ||Ax-b||=" << res
+                << "  " << res / res0 << std::endl;
+#endif
+      if ( std::isnan( res ) ) break;
+      else if ( rel_converged( res, res0 ) || abs_converged( res ) ) converged = true;
+      else if ( !is_trivial( norm ) && rel_converged( res, norm ) ) converged = true;
+
+      if ( converged ) { flg = true; break; }
+
+      ELAI_PROF_BEG( prec_elapsed_ );
+      S_.eisenstat( p_, q_, t_ );
+      ELAI_PROF_END( prec_elapsed_ );
+
+      pq = gprod_( p_, q_ );
+      alpha = rho / pq;
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for ( int k = 0; k < m; ++k )
+      {
+        y_( k ) += alpha * p_( k );
+        r_( k ) -= alpha * q_( k );
+      }
+      rho1 = gprod_( r_, r_ );
+      beta = rho1 / rho;
+      rho = rho1;
+      q_ = r_ + beta * p_;
+      p_ = q_;
+      ELAI_PROD( res, r_, r_ );
+      res = sqrt( res );
+    }
+
+    x = y_;
+    S_.backward( x );
+
+    return flg;
+  }
+
+public:
+  eisenstat_cg
+    ( const matrix< Coef >& A
+    , const vector< Coef >& b
+    , const sor_conditioner< Coef >& S
+    )
+    : ksp< Coef >( A, b, &S )
+    , S_( S ), g_( A_.m() ), p_( A_.m() ), q_( A_.m() ), r_( A_.m() ), t_( A_.m() ), y_( A_.m() )
+  {
+    eisenstat_check( S );
+  }
+  ~eisenstat_cg() {}
+
+  size_t mem() const
+  {
+    size_t sum = ksp< Coef >::mem();
+
+    sum += g_.mem();
+    sum += p_.mem();
+    sum += q_.mem();
+    sum += r_.mem();
+    sum += t_.mem();
+    sum += y_.mem();
+
+    return sum;
+  }
+};
+
+template< class Coef >
+class eisenstat_bicgstab : public ksp< Coef >
+{
+  ELAI_USE_KSP;
+
+  const sor_conditioner< Coef >& S_;
+  // WORKSPACE
+  vector< Coef > p_, r_, r0_, s_, t_, v_, w_, y_;
+
+protected:
+  bool solve_( vector< Coef >& x ) { return solveP_( x ); }
+
+  bool solveP_( vector< Coef >& x )
+  {
+    const int m = A_.m();
+    Coef res, res0, rho, alpha, omega, norm;
+    bool flg = false;
+
+    if ( is_trivial( b_ ) )
+    {
+      x = b_;
+
+      return true;
+    }
+
+    S_.upper( x, y_ );
+    S_.eisenstat( y_, v_, w_ );
+    r_ = b_;
+    S_.forward( r_ );
+    p_ = r_ - v_;
+    r_ = p_;
+    r0_ = r_;
+    rho = alpha = omega = static_cast< Coef >( 1. );
+    p_ = static_cast< Coef >( 0. );
+    v_ = static_cast< Coef >( 0. );
+    ELAI_PROD( res, r_, r_ );
+    res = res0 = sqrt( res );
+    if ( is_trivial( res0 ) ) return true;
+
+    for ( int i = 0; i < iter_max(); ++i )
+    {
+      bool converged = false;
+      Coef rho1, beta, tmp, tt;
+
+      ELAI_PROD( norm, y_, y_ );
+#ifdef ELAI_DEBUG
+      std::cerr << " ||x||=" << norm
+                << " ||Ax-b||=" << res
+                << "  " << res / res0 << std::endl;
+#endif
+      if ( std::isnan( res ) ) break;
+      else if ( rel_converged( res, res0 ) || abs_converged( res ) ) converged = true;
+      else if ( !is_trivial( norm ) && rel_converged( res, norm ) ) converged = true;
+
+      if ( converged ) { flg = true; break; }
+
+      ELAI_PROD( rho1, r0_, r_ );
+      beta = ( rho1 / rho ) * ( alpha / omega );
+      rho = rho1;
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for ( int k = 0; k < m; ++k ) p_( k ) = r_( k ) + beta * ( p_( k ) - omega * v_( k ) );
+
+      ELAI_PROF_BEG( prec_elapsed_ );
+      S_.eisenstat( p_, v_, w_ );
+      ELAI_PROF_END( prec_elapsed_ );
+
+      ELAI_PROD( tmp, r0_, v_ );
+      alpha = rho / tmp;
+      s_ = r_ - alpha * v_;
+
+      ELAI_PROF_BEG( prec_elapsed_ );
+      S_.eisenstat( s_, t_, w_ );
+      ELAI_PROF_END( prec_elapsed_ );
+
+      ELAI_PROD( tmp, t_, s_ );
+      ELAI_PROD( tt, t_, t_ );
+      omega = tmp / tt;
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for ( int k = 0; k < m; ++k )
+      {
+        y_( k ) += alpha * p_( k ) + omega * s_( k );
+        r_( k ) = s_( k ) - omega * t_( k );
+      }
+      ELAI_PROD( res, r_, r_ );
+      res = sqrt( res );
+    }
+
+    x = y_;
+    S_.backward( x );
+
+    return flg;
+  }
+
+public:
+  eisenstat_bicgstab
+    ( const matrix< Coef >& A
+    , const vector< Coef >& b
+    , const sor_conditioner< Coef >& S
+    )
+    : ksp< Coef >( A, b, &S )
+    , S_( S ), p_( A_.m() ), r_( A_.m() ), r0_( A_.m() ), s_( A_.m() )
+    , t_( A_.m() ), v_( A_.m() ), w_( A_.m() ), y_( A_.m() )
+  {
+    eisenstat_check( S );
+  }
+  ~eisenstat_bicgstab() {}
+
+  size_t mem() const
+  {
+    size_t sum = ksp< Coef >::mem();
+
+    sum += p_.mem();
+    sum += r_.mem();
+    sum += r0_.mem();
+    sum += s_.mem();
+    sum += t_.mem();
+    sum += v_.mem();
+    sum += w_.mem();
+    sum += y_.mem();
+
+    return sum;
+  }
+};
+
+}
+
+#endif//__ELAI_EISENSTAT__
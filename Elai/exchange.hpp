@@ -0,0 +1,143 @@
+/*
+ *
+ * Elastic Linear Algebra Interface (ELAI)
+ *
+ * Copyright 2013-2015 H. KOSHIMOTO, AIST
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __ELAI_EXCHANGE__
+#define __ELAI_EXCHANGE__
+
+#include <map>
+#include <vector>
+#include "def.hpp"
+
+#ifdef ELAI_USE_MPI
+#include "mpi.h"
+
+namespace elai
+{
+
+// Sparse data exchange: out[ rank ] is sent to the rank and in[ rank ] is
+// received from it, while no rank knows its senders beforehand.
+// With ELAI_USE_MPI3, it is the non-blocking consensus ( Issend + Ibarrier ),
+// otherwise the senders are counted by a reduce-scatter.
+// Neither way builds anything of O( P^2 ).
+template< class T >
+void sparse_exchange
+  ( MPI_Comm comm
+  , const std::map< int, std::vector< T > >& out
+  , std::map< int, std::vector< T > >& in
+  )
+{
+  typedef typename std::map< int, std::vector< T > >::const_iterator const_iterator;
+
+  MPI_Datatype type = mpi_< T >().type;
+  MPI_Comm local;
+  int n = out.size(), k = 0, tag = 0;
+  MPI_Request *req = new MPI_Request[ n + 1 ];
+
+  // A private communicator keeps the messages off the other exchanges.
+  MPI_Comm_dup( comm, &local );
+  in.clear();
+#ifdef ELAI_USE_MPI3
+  for ( const_iterator it = out.begin(); it != out.end(); ++it, ++k )
+  {
+    const std::vector< T >& buf = it->second;
+
+    MPI_Issend
+      ( buf.empty() ? NULL : &buf[ 0 ], buf.size(), type, it->first, tag, local, &req[ k ] );
+  }
+
+  MPI_Request barrier = MPI_REQUEST_NULL;
+  bool barrier_posted = false;
+  int done = 0;
+
+  while ( !done )
+  {
+    int flg = 0;
+    MPI_Status status;
+
+    MPI_Iprobe( MPI_ANY_SOURCE, tag, local, &flg, &status );
+    if ( flg )
+    {
+      int cnt;
+      std::vector< T >& buf = in[ status.MPI_SOURCE ];
+
+      MPI_Get_count( &status, type, &cnt );
+      buf.resize( cnt );
+      MPI_Recv
+        ( cnt == 0 ? NULL : &buf[ 0 ], cnt, type, status.MPI_SOURCE, tag, local, MPI_STATUS_IGNORE );
+    }
+    if ( barrier_posted ) MPI_Test( &barrier, &done, MPI_STATUS_IGNORE );
+    else
+    {
+      int sent = 0;
+
+      MPI_Testall( n, req, &sent, MPI_STATUSES_IGNORE );
+      if ( sent )
+      {
+        MPI_Ibarrier( local, &barrier );
+        barrier_posted = true;
+      }
+    }
+  }
+#else
+  int size, incoming = 0;
+
+  MPI_Comm_size( local, &size );
+
+  int *flg = new int[ size ];
+  int *one = new int[ size ];
+
+  for ( int i = 0; i < size; ++i ) { flg[ i ] = 0; one[ i ] = 1; }
+  for ( const_iterator it = out.begin(); it != out.end(); ++it ) flg[ it->first ] = 1;
+  MPI_Reduce_scatter( flg, &incoming, one, MPI_INT, MPI_SUM, local );
+
+  for ( const_iterator it = out.begin(); it != out.end(); ++it, ++k )
+  {
+    std::vector< T >& buf = const_cast< std::vector< T >& >( it->second );
+
+    MPI_Isend
+      ( buf.empty() ? NULL : &buf[ 0 ], buf.size(), type, it->first, tag, local, &req[ k ] );
+  }
+  for ( int i = 0; i < incoming; ++i )
+  {
+    int cnt;
+    MPI_Status status;
+
+    MPI_Probe( MPI_ANY_SOURCE, tag, local, &status );
+    MPI_Get_count( &status, type, &cnt );
+
+    std::vector< T >& buf = in[ status.MPI_SOURCE ];
+
+    buf.resize( cnt );
+    MPI_Recv
+      ( cnt == 0 ? NULL : &buf[ 0 ], cnt, type, status.MPI_SOURCE, tag, local, MPI_STATUS_IGNORE );
+  }
+  if ( 0 < n ) MPI_Waitall( n, req, MPI_STATUSES_IGNORE );
+
+  delete [] one;
+  delete [] flg;
+#endif
+  MPI_Comm_free( &local );
+
+  delete [] req;
+}
+
+}
+#endif
+
+#endif//__ELAI_EXCHANGE__
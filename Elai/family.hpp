@@ -22,6 +22,7 @@
 
 #include <map>
 #include <set>
+#include <vector>
 #include "def.hpp"
 #include "space.hpp"
 #include "portal.hpp"
@@ -372,6 +373,29 @@ public:
     return family< Element, Neighbour >( tau );
   }
 
+  // The adjacency graph on the elements of s, in the index of s.
+  // adj has to have s.size() rows; edges are stored in both directions.
+  void adjacency( const Space& s, std::vector< std::vector< int > >& adj ) const
+  {
+    for ( typename Family::const_iterator it = tau_.begin(); it != tau_.end(); ++it )
+    {
+      if ( !s.contain( it->first ) ) continue;
+
+      int i = s.index( it->first );
+
+      for ( typename Neighbour::const_iterator p = it->second.begin(); p != it->second.end(); ++p )
+      {
+        if ( !s.contain( *p ) ) continue;
+
+        int j = s.index( *p );
+
+        if ( i == j ) continue;
+        adj[ i ].push_back( j );
+        adj[ j ].push_back( i );
+      }
+    }
+  }
+
   // A included-point-set in this family.
   // Iteration via points in Neighbour tau_.
   // This method expects that neighbourhoods < s.
@@ -23,8 +23,10 @@
 #include <algorithm>
 #include <set>
 #include <utility>
+#include <vector>
 #include "def.hpp"
 #include "matrix.hpp"
+#include "schedule.hpp"
 
 namespace elai
 {
@@ -44,129 +46,186 @@ class fillin
     const int lvl;
   };
 
-  const Matrix& A_;
-  int nnz_;
-  int *xadj_;
-  int *adjy_;
-  Coef *coef_;
-
-  void sysfactor( int lv, Coef thres )
+  // Rows of the pattern are kept in blocks that never move, so that the
+  // finished rows are read by the other threads while rows are appended.
+  // A row is { len, ubeg, col[ len ], lvl[ len ] }, where ubeg is the first
+  // entry to the right of the diagonal.
+  class row_arena
   {
-    const int *ind = A_.ind();
-    const int *col = A_.col();
-    const Coef *val = A_.val();
-    int m = A_.m(), n = A_.n();
-    std::set < fitem > *adjs;
+    enum { BLOCK = 1 << 16 };
 
-    adjs = new std::set< fitem >[ m ];
+    std::vector< int* > blk_;
+    int pos_, cap_;
 
-    for ( int i = 0; i < m; ++i )
-      for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
-        if ( ( col[ k ] == i ) || ( thres <= fabs( val[ k ] ) ) )
-          adjs[ i ].insert( fitem( col[ k ], 0 ) );
+    row_arena( const row_arena& );
+    row_arena& operator=( const row_arena& );
 
-    for ( int i = 0; i < m; ++i )
+  public:
+    row_arena() : blk_(), pos_( 0 ), cap_( 0 ) {}
+    ~row_arena()
     {
-      std::set< fitem >& adj = adjs[ i ];
-
-      for ( typename std::set< fitem >::const_iterator it = adj.begin()
-          ; it != adj.end(); ++it
-          )
-      {
-        const fitem item( *it );
+      for ( unsigned int b = 0; b < blk_.size(); ++b ) delete [] blk_[ b ];
+    }
 
-        if ( i <= item.col ) break;
-        if ( lv <= item.lvl ) continue;
-        for ( typename std::set< fitem >::const_iterator jt = adjs[ item.col ].begin()
-            ; jt != adjs[ item.col ].end(); ++jt
-            )
-        {
-          const fitem jtem( *jt );
+    int *alloc( int len )
+    {
+      int *p;
 
-          if ( i < jtem.col ) break;
-          if ( ( jtem.col <= item.col ) || ( lv <= jtem.lvl ) ) continue;
-          adj.insert( fitem( jtem.col, item.lvl + jtem.lvl + 1 ) );
-          adjs[ jtem.col ].insert( fitem( i, item.lvl + jtem.lvl + 1 ) );
-        }
+      if ( cap_ < pos_ + len )
+      {
+        cap_ = std::max( len, static_cast< int >( BLOCK ) );
+        blk_.push_back( new int[ cap_ ] );
+        pos_ = 0;
       }
-    }
-#ifdef ELAI_DEBUG
-    int acc = 0;
-    for ( int i = 0; i < m; ++i )
-    {
-      std::set< fitem >& adj = adjs[ i ];
-      acc += adj.size();
-    }
-    std::cerr << "N=" << A_.m() << ", NZ=" << A_.nnz() << ", NF=" << acc << std::endl;
-#endif
+      p = blk_.back() + pos_;
+      pos_ += len;
 
-    build( adjs );
-    delete [] adjs;
-  }
+      return p;
+    }
+  };
 
-  void symfactor( int lv, Coef thres )
+  const Matrix& A_;
+  int nnz_;
+  int *xadj_;
+  int *adjy_;
+  Coef *coef_;
+  level_schedule lower_, upper_;
+
+  // Symbolic ILU( lv ) by rows. The row i is a sorted linked list over the
+  // columns, merged with the upper part of every row k of its lower part
+  // whose level is below lv; an entry keeps the level it first gets.
+  // Fill rules: level( i, k ) + level( k, j ) + 1 with srule ( sum ),
+  // max( level( i, k ), level( k, j ) ) + 1 otherwise.
+  // If symm, the pattern of A is symmetric and the fill stays in the local
+  // columns; without a threshold, the result is the symmetric pattern of
+  // the lower factor ( see mirror_ for a threshold ).
+  // With threads, rows are taken cyclically and each waits only for the
+  // rows it merges, as level_schedule does on the known patterns.
+  void factor_( int lv, Coef thres, bool srule, bool symm )
   {
     const int *ind = A_.ind();
     const int *col = A_.col();
     const Coef *val = A_.val();
     int m = A_.m(), n = A_.n();
-    std::set < fitem > *adjs;
+    int **rows = new int*[ m ];
+    int *done = new int[ m ];
+    int nth = 1;
 
-    adjs = new std::set< fitem >[ m ];
+#ifdef ELAI_USE_OPENMP
+    nth = omp_get_max_threads();
+#endif
+    row_arena *arena = new row_arena[ nth ];
 
-    for ( int i = 0; i < m; ++i )
-      for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
-        if ( ( col[ k ] == i ) || ( thres <= fabs( val[ k ] ) ) )
-          adjs[ i ].insert( fitem( col[ k ], 0 ) );
+    for ( int i = 0; i < m; ++i ) done[ i ] = 0;
 
-    for ( int i = 0; i < m; ++i )
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel
+#endif
     {
-      std::set< fitem >& adj = adjs[ i ];
+      int tid = 0, nt = 1;
+#ifdef ELAI_USE_OPENMP
+      tid = omp_get_thread_num();
+      nt = omp_get_num_threads();
+#endif
+      int *next = new int[ n + 1 ]; // next[ n ] is the head, n the end
+      int *lev = new int[ n ];
+      std::vector< int > init;
 
-      for ( typename std::set< fitem >::const_iterator it = adj.begin()
-          ; it != adj.end(); ++it
-          )
+      for ( int i = tid; i < m; i += nt )
       {
-        const fitem item( *it );
+        int len = 0, ubeg = 0;
+
+        init.clear();
+        for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
+          if ( ( col[ k ] == i ) || ( thres <= fabs( val[ k ] ) ) ) init.push_back( col[ k ] );
+        std::sort( init.begin(), init.end() );
+        next[ n ] = n;
+        for ( int p = n, off = 0; off < static_cast< int >( init.size() ); ++off )
+        {
+          int j = init[ off ];
+
+          if ( p != n && p == j ) continue;
+          next[ j ] = n;
+          next[ p ] = j;
+          lev[ j ] = 0;
+          p = j;
+          ++len;
+        }
 
-        if ( i <= item.col ) break;
-        if ( lv <= item.lvl ) continue;
-        for ( typename std::set< fitem >::const_iterator jt = adjs[ item.col ].begin()
-            ; jt != adjs[ item.col ].end(); ++jt
-            )
+        for ( int k = next[ n ]; k < i; k = next[ k ] )
         {
-          const fitem jtem( *jt );
+          if ( lv <= lev[ k ] ) continue;
+#ifdef ELAI_USE_OPENMP
+          spin_wait( done + k );
+          #pragma omp flush
+#endif
 
-          if ( i < jtem.col ) break;
-          if ( ( jtem.col <= item.col ) || ( lv <= jtem.lvl ) ) continue;
-          adj.insert( fitem( jtem.col, std::max( item.lvl, jtem.lvl ) + 1 ) );
-          adjs[ jtem.col ].insert( fitem( i, std::max( item.lvl, jtem.lvl ) + 1 ) );
+          const int *r = rows[ k ];
+          const int *rcol = r + 2, *rlvl = r + 2 + r[ 0 ];
+
+          for ( int off = r[ 1 ], p = k; off < r[ 0 ]; ++off )
+          {
+            int j = rcol[ off ];
+
+            if ( symm && m <= j ) break;
+            if ( lv <= rlvl[ off ] ) continue;
+            while ( next[ p ] < j ) p = next[ p ];
+            if ( next[ p ] != j )
+            {
+              next[ j ] = next[ p ];
+              next[ p ] = j;
+              lev[ j ] = srule ? lev[ k ] + rlvl[ off ] + 1 : std::max( lev[ k ], rlvl[ off ] ) + 1;
+              ++len;
+            }
+            p = j;
+          }
+        }
+
+        int *r = arena[ tid ].alloc( 2 + 2 * len );
+        int off = 0;
+
+        for ( int j = next[ n ]; j != n; j = next[ j ], ++off )
+        {
+          if ( j <= i ) ubeg = off + 1;
+          r[ 2 + off ] = j;
+          r[ 2 + len + off ] = lev[ j ];
         }
+        r[ 0 ] = len;
+        r[ 1 ] = ubeg;
+        rows[ i ] = r;
+#ifdef ELAI_USE_OPENMP
+        #pragma omp flush
+        #pragma omp atomic write
+#endif
+        done[ i ] = 1;
       }
+
+      delete [] lev;
+      delete [] next;
     }
 #ifdef ELAI_DEBUG
     int acc = 0;
-    for ( int i = 0; i < m; ++i )
-    {
-      std::set< fitem >& adj = adjs[ i ];
-      acc += adj.size();
-    }
+    for ( int i = 0; i < m; ++i ) acc += rows[ i ][ 0 ];
     std::cerr << "N=" << A_.m() << ", NZ=" << A_.nnz() << ", NF=" << acc << std::endl;
 #endif
 
-    build( adjs );
-    delete [] adjs;
+    build( rows );
+    delete [] arena;
+    delete [] done;
+    delete [] rows;
   }
 
-  void sfactor( int lv, Coef thres )
+  // Symmetric rule with a threshold, which may drop a_ij but not a_ji: only
+  // the lower part of the rows k < j < i is merged, and each fill ( i, j )
+  // is mirrored into ( j, i ), so the pattern stays symmetric. The mirrors
+  // go to finished rows, hence a single thread.
+  void mirror_( int lv, Coef thres, bool srule )
   {
     const int *ind = A_.ind();
     const int *col = A_.col();
     const Coef *val = A_.val();
-    int m = A_.m(), n = A_.n();
-    std::set < fitem > *adjs;
-
-    adjs = new std::set< fitem >[ m ];
+    int m = A_.m();
+    std::set< fitem > *adjs = new std::set< fitem >[ m ];
 
     for ( int i = 0; i < m; ++i )
       for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
@@ -191,78 +250,50 @@ class fillin
         {
           const fitem jtem( *jt );
 
+          if ( i < jtem.col ) break;
           if ( ( jtem.col <= item.col ) || ( lv <= jtem.lvl ) ) continue;
-          adj.insert( fitem( jtem.col, item.lvl + jtem.lvl + 1 ) );
+
+          int l = srule ? item.lvl + jtem.lvl + 1 : std::max( item.lvl, jtem.lvl ) + 1;
+
+          adj.insert( fitem( jtem.col, l ) );
+          adjs[ jtem.col ].insert( fitem( i, l ) );
         }
       }
     }
-#ifdef ELAI_DEBUG
-    int acc = 0;
-    for ( int i = 0; i < m; ++i )
-    {
-      std::set< fitem >& adj = adjs[ i ];
-      acc += adj.size();
-    }
-    std::cerr << "N=" << A_.m() << ", NZ=" << A_.nnz() << ", NF=" << acc << std::endl;
-#endif
-
-    build( adjs );
-    delete [] adjs;
-  }
-
-  void mfactor( int lv, Coef thres )
-  {
-    const int *ind = A_.ind();
-    const int *col = A_.col();
-    const Coef *val = A_.val();
-    int m = A_.m(), n = A_.n();
-    std::set < fitem > *adjs;
 
-    adjs = new std::set< fitem >[ m ];
-
-    for ( int i = 0; i < m; ++i )
-      for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
-        if ( ( col[ k ] == i ) || ( thres <= fabs( val[ k ] ) ) )
-          adjs[ i ].insert( fitem( col[ k ], 0 ) );
+    // Rows as factor_ leaves them, for build.
+    row_arena arena;
+    int **rows = new int*[ m ];
 
     for ( int i = 0; i < m; ++i )
     {
-      std::set< fitem >& adj = adjs[ i ];
+      const int len = adjs[ i ].size();
+      int *r = arena.alloc( 2 + 2 * len ), off = 0;
 
-      for ( typename std::set< fitem >::const_iterator it = adj.begin()
-          ; it != adj.end(); ++it
+      r[ 0 ] = len;
+      r[ 1 ] = 0;
+      for ( typename std::set< fitem >::const_iterator it = adjs[ i ].begin()
+          ; it != adjs[ i ].end(); ++it, ++off
           )
       {
-        const fitem item( *it );
-
-        if ( i <= item.col ) break;
-        if ( lv <= item.lvl ) continue;
-        for ( typename std::set< fitem >::const_iterator jt = adjs[ item.col ].begin()
-            ; jt != adjs[ item.col ].end(); ++jt
-            )
-        {
-          const fitem jtem( *jt );
-
-          if ( ( jtem.col <= item.col ) || ( lv <= jtem.lvl ) ) continue;
-          adj.insert( fitem( jtem.col, std::max( item.lvl, jtem.lvl ) + 1 ) );
-        }
+        if ( it->col <= i ) r[ 1 ] = off + 1;
+        r[ 2 + off ] = it->col;
+        r[ 2 + len + off ] = it->lvl;
       }
+      rows[ i ] = r;
     }
 #ifdef ELAI_DEBUG
     int acc = 0;
-    for ( int i = 0; i < m; ++i )
-    {
-      std::set< fitem >& adj = adjs[ i ];
-      acc += adj.size();
-    }
+    for ( int i = 0; i < m; ++i ) acc += rows[ i ][ 0 ];
     std::cerr << "N=" << A_.m() << ", NZ=" << A_.nnz() << ", NF=" << acc << std::endl;
 #endif
 
-    build( adjs );
+    build( rows );
+    delete [] rows;
     delete [] adjs;
   }
 
-  void build( std::set< fitem > *adjs )
+  void build( int **rows )
   {
     int m = A_.m();
 
@@ -271,22 +302,26 @@ class fillin
     xadj_[ 0 ] = nnz_;
     for ( int i = 0; i < m; ++i )
     {
-      nnz_ += adjs[ i ].size();
+      nnz_ += rows[ i ][ 0 ];
       xadj_[ i + 1 ] = nnz_;
     }
     adjy_ = new int[ nnz_ ];
     coef_ = new Coef[ nnz_ ];
-    for ( int k = 0; k < nnz_; ++k ) coef_[ k ] = static_cast< Coef >( 0 );
-    for ( int i = 0, k = 0; i < m; ++i )
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < m; ++i )
     {
-      std::set< fitem >& adj = adjs[ i ];
-
-      for ( typename std::set< fitem >::const_iterator it = adj.begin()
-          ; it != adj.end(); ++it
-          ) adjy_[ k++ ] = fitem( *it ).col;
+      for ( int off = 0; off < rows[ i ][ 0 ]; ++off )
+      {
+        adjy_[ xadj_[ i ] + off ] = rows[ i ][ 2 + off ];
+        coef_[ xadj_[ i ] + off ] = static_cast< Coef >( 0 );
+      }
     }
     // Setup of coefficients moved to an independent method.
     // Because of scaling, coefficients are to be modified.
+    lower_( m, xadj_, adjy_, true );
+    upper_( m, xadj_, adjy_, false );
   }
 
   void destruct()
@@ -299,7 +334,7 @@ class fillin
 
 public:
   fillin( const Matrix& A )
-    : A_( A ), nnz_( 0 ), xadj_( NULL ), adjy_( NULL ), coef_( NULL )
+    : A_( A ), nnz_( 0 ), xadj_( NULL ), adjy_( NULL ), coef_( NULL ), lower_(), upper_()
   {}
   ~fillin() { destruct(); }
 
@@ -312,17 +347,28 @@ public:
     bool is_symm = A_.is_symmetric();
 
     destruct();
-    if ( is_symm && is_srule ) sysfactor( k, thres );
-    else if ( is_symm ) symfactor( k, thres );
-    else if ( is_srule ) sfactor( k, thres );
-    else mfactor( k, thres );
+    if ( is_symm && static_cast< Coef >( 0. ) < thres ) mirror_( k, thres, is_srule );
+    else factor_( k, thres, is_srule, is_symm );
   }
 
+  // The values are allocated again if released.
   void setup()
   {
-    if ( coef_ != NULL )
+    if ( coef_ == NULL ) coef_ = new Coef[ nnz_ ];
+    setup( coef_ );
+  }
+  // Frees the values, e.g. once the factors are copied elsewhere; the
+  // pattern and its schedules are kept.
+  void release()
+  {
+    if ( coef_ != NULL ) { delete [] coef_; coef_ = NULL; }
+  }
+  // Coefficients of A on the pattern into dst, which has nnz() entries.
+  void setup( Coef *dst ) const
+  {
+    if ( dst != NULL )
     {
-      for ( int k = 0; k < nnz_; ++k ) coef_[ k ] = static_cast< Coef >( 0. );
+      for ( int k = 0; k < nnz_; ++k ) dst[ k ] = static_cast< Coef >( 0. );
       for ( int i = 0; i < A_.m(); ++i )
       {
         for ( int k0 = A_.ind( i ), k1 = xadj_[ i ]
@@ -333,7 +379,7 @@ public:
 
           if ( j0 < j1 ) { ++k0; continue; }
           else if ( j1 < j0 ) { ++k1; continue; }
-          coef_[ k1 ] = A_.val( k0 );
+          dst[ k1 ] = A_.val( k0 );
           ++k0; ++k1;
         }
       }
@@ -347,6 +393,9 @@ public:
   int *adjy() const { return adjy_; }
   Coef *coef() { return coef_; }
   Coef *coef() const { return coef_; }
+  // Levels of the L and the U patterns, for the factorization and the solves.
+  const level_schedule& lower() const { return lower_; }
+  const level_schedule& upper() const { return upper_; }
 };
 
 }
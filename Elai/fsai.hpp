@@ -0,0 +1,205 @@
+/*
+ *
+ * Elastic Linear Algebra Interface (ELAI)
+ *
+ * Copyright 2013-2015 H. KOSHIMOTO, AIST
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __ELAI_FSAI__
+#define __ELAI_FSAI__
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "def.hpp"
+#include "expression.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "blas.hpp"
+#include "preconditioner.hpp"
+
+namespace elai
+{
+
+// Factorized sparse approximate inverse for SPD A: G lower triangular with
+// G A G^T ~ I, such that M^-1 = G^T G. Each row i of G solves the small
+// dense system A( P, P ) g = e_i on its pattern P, independently of others.
+// The applications are two row-parallel SpMVs with G and G^T.
+template< class Range >
+class fsai : public preconditioner< Range >
+{
+  std::vector< int > pind_, pcol_; // The lower pattern, with the diagonal last.
+  matrix< Range > G_, Gt_;
+  mutable vector< Range > w_;
+
+  // Solves S x = b of order n in place of b, by LU with partial pivoting.
+  static void solve_( int n, std::vector< Range >& S, std::vector< Range >& b )
+  {
+    for ( int k = 0; k < n; ++k )
+    {
+      int p = k;
+
+      for ( int i = k + 1; i < n; ++i ) if ( fabs( S[ p * n + k ] ) < fabs( S[ i * n + k ] ) ) p = i;
+      if ( p != k )
+      {
+        for ( int j = 0; j < n; ++j ) std::swap( S[ p * n + j ], S[ k * n + j ] );
+        std::swap( b[ p ], b[ k ] );
+      }
+      if ( S[ k * n + k ] == static_cast< Range >( 0 ) ) S[ k * n + k ] = static_cast< Range >( 1 );
+      for ( int i = k + 1; i < n; ++i )
+      {
+        Range l = S[ i * n + k ] / S[ k * n + k ];
+
+        for ( int j = k + 1; j < n; ++j ) S[ i * n + j ] -= l * S[ k * n + j ];
+        b[ i ] -= l * b[ k ];
+      }
+    }
+    for ( int k = n - 1; 0 <= k; --k )
+    {
+      for ( int j = k + 1; j < n; ++j ) b[ k ] -= S[ k * n + j ] * b[ j ];
+      b[ k ] /= S[ k * n + k ];
+    }
+  }
+
+  // The lower part of a pattern, sorted, with the diagonal added.
+  void lower_( int m, const int *ind, const int *col )
+  {
+    pind_.assign( 1, 0 );
+    pcol_.clear();
+    for ( int i = 0; i < m; ++i )
+    {
+      int beg = pcol_.size();
+
+      for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
+        if ( 0 <= col[ k ] && col[ k ] < i ) pcol_.push_back( col[ k ] );
+      std::sort( pcol_.begin() + beg, pcol_.end() );
+      pcol_.erase( std::unique( pcol_.begin() + beg, pcol_.end() ), pcol_.end() );
+      pcol_.push_back( i );
+      pind_.push_back( pcol_.size() );
+    }
+  }
+
+protected:
+  void forward_( vector< Range >& x ) const
+  {
+    w_ = G_ * x;
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < x.m(); ++i ) x( i ) = w_( i );
+  }
+  void backward_( vector< Range >& x ) const
+  {
+    w_ = Gt_ * x;
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < x.m(); ++i ) x( i ) = w_( i );
+  }
+  void forwardInv_( vector< Range >& x ) const {} // M is not formed.
+  void backwardInv_( vector< Range >& x ) const {}
+
+public:
+  fsai( const matrix< Range >& A )
+    : preconditioner< Range >( A ), pind_(), pcol_(), G_(), Gt_(), w_( A.m() )
+  {
+    lower_( A.m(), A.ind(), A.col() );
+  }
+
+  // Takes the pattern from an adjacency, e.g. of clique::fill( lv );
+  // the columns out of [ 0, m ) are ignored.
+  void pattern( int m, const int *xadj, const int *adjy )
+  {
+    assert( m == preconditioner< Range >::A_.m() );
+    lower_( m, xadj, adjy );
+  }
+
+  void factor()
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+    const int m = A.m(), nnz = pcol_.size();
+    Range *val = new Range[ nnz ];
+
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel
+#endif
+    {
+      std::vector< int > pos( m, -1 );
+      std::vector< Range > S, g;
+
+#ifdef ELAI_USE_OPENMP
+      #pragma omp for schedule( dynamic, 64 )
+#endif
+      for ( int i = 0; i < m; ++i )
+      {
+        const int beg = pind_[ i ], n = pind_[ i + 1 ] - beg;
+
+        // S = A( P, P ) and g = e_i, whose i is the last in P.
+        S.assign( n * n, static_cast< Range >( 0 ) );
+        g.assign( n, static_cast< Range >( 0 ) );
+        g[ n - 1 ] = static_cast< Range >( 1 );
+        for ( int a = 0; a < n; ++a ) pos[ pcol_[ beg + a ] ] = a;
+        for ( int a = 0; a < n; ++a )
+        {
+          int r = pcol_[ beg + a ];
+
+          for ( int k = A.ind( r ); k < A.ind( r + 1 ); ++k )
+            if ( A.col( k ) < m && 0 <= pos[ A.col( k ) ] ) S[ a * n + pos[ A.col( k ) ] ] = A.val( k );
+        }
+        for ( int a = 0; a < n; ++a ) pos[ pcol_[ beg + a ] ] = -1;
+
+        solve_( n, S, g );
+
+        // The diagonal of G A G^T is scaled to 1.
+        Range s = fabs( g[ n - 1 ] );
+
+        s = ( s == static_cast< Range >( 0 ) ) ? static_cast< Range >( 1 ) : static_cast< Range >( 1 ) / std::sqrt( s );
+        for ( int a = 0; a < n; ++a ) val[ beg + a ] = s * g[ a ];
+      }
+    }
+    G_.setup( m, m, nnz, &pind_[ 0 ], &pcol_[ 0 ], val );
+
+    // G^T, so that both applications run by rows.
+    std::vector< int > tind( m + 1, 0 ), tcol( nnz ), next;
+    Range *tval = new Range[ nnz ];
+
+    for ( int k = 0; k < nnz; ++k ) ++tind[ pcol_[ k ] + 1 ];
+    for ( int i = 0; i < m; ++i ) tind[ i + 1 ] += tind[ i ];
+    next.assign( tind.begin(), tind.end() - 1 );
+    for ( int i = 0; i < m; ++i )
+      for ( int k = pind_[ i ]; k < pind_[ i + 1 ]; ++k )
+      {
+        int l = next[ pcol_[ k ] ]++;
+
+        tcol[ l ] = i;
+        tval[ l ] = val[ k ];
+      }
+    Gt_.setup( m, m, nnz, &tind[ 0 ], &tcol[ 0 ], tval );
+    delete [] val;
+    delete [] tval;
+  }
+
+  // Entries of G.
+  int nnz() const { return pcol_.size(); }
+
+  size_t mem() const
+  {
+    return G_.mem() + Gt_.mem() + sizeof( int ) * ( pind_.size() + pcol_.size() ) + w_.mem();
+  }
+};
+
+}
+
+#endif//__ELAI_FSAI__
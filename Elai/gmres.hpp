@@ -46,7 +46,7 @@ private:
   {
     if ( v_ != NULL ) { delete [] v_; v_ = NULL; }
     v_ = new vector< Coef >[ restart_ + 1 ];
-    for ( int i = 0; i <= restart_; ++i ) v_[ i ].setup( A_.m() );
+    for ( int i = 0; i <= restart_; ++i ) v_[ i ].setup( m() );
 
     y_.setup( restart_ );
     c_.setup( restart_ );
@@ -85,7 +85,6 @@ private:
 
   bool solve_( vector< Coef >& x )
   {
-    const int n = A_.m();
     int itr = 0;
     bool converged = false;
     Coef res, res0;
@@ -97,7 +96,7 @@ private:
       return true;
     }
 
-    r_ = b_ - A_ * x;
+    residual( r_, x );
     res = res0 = sync_norm( r_ );
     if ( is_trivial( res ) ) return true;
 
@@ -109,14 +108,16 @@ private:
 
       for ( m = 0; m < restart_; ++m )
       {
-        v_[ m + 1 ] = A_ * v_[ m ];
+        ELAI_SPMV( v_[ m + 1 ], v_[ m ] );
 
         // Orthogonalization
-        for ( int i = 0; i <= m; ++i ) ELAI_PROD( h( i, m ), v_[ m + 1 ], v_[ i ] );
+        // Classical Gram-Schmidt: all products go into one reduction.
+        for ( int i = 0; i <= m; ++i ) ELAI_PROD_DEFER( h( i, m ), v_[ m + 1 ], v_[ i ] );
+        ELAI_REDUCE();
         for ( int i = 0; i <= m; ++i ) v_[ m + 1 ] = v_[ m + 1 ] - h( i, m ) * v_[ i ];
 
         // Normalization
-        h( m + 1, m ) = sync_norm( v_[ m + 1 ] );
+        h( m + 1, m ) = fix_norm( v_[ m + 1 ] );
         v_[ m + 1 ] = ( static_cast< Coef >( 1e0 ) / h( m + 1, m ) ) * v_[ m + 1 ];
 
         // Givens Transformation
@@ -161,12 +162,7 @@ private:
 #endif
         // Convergence Check
         if ( rel_converged( e_( m ), res0 ) ) converged = true;
-        if ( isOK( converged ) )
-        {
-          converged = true;
-          break;
-        }
-        else converged = false;
+        if ( converged ) break;
       }
 
       // Solve via backward-substitute
@@ -180,7 +176,7 @@ private:
       // DIVERGED
       if ( iter_max() <= ++itr ) break;
 
-      r_ = b_ - A_ * x;
+      residual( r_, x );
       res = sync_norm( r_ );
       v_[ 0 ] = ( static_cast< Coef >( 1e0 ) / res ) * r_;
       e_.clear( static_cast< Coef >( 0e0 ) ); e_( 0 ) = res;
@@ -191,7 +187,6 @@ private:
 
   bool solveP_( vector< Coef >& x )
   {
-    const int n = A_.m();
     int itr = 0;
     bool converged = false;
     Coef res, res0;
@@ -203,7 +198,7 @@ private:
       return true;
     }
 
-    r_ = b_ - A_ * x;
+    residual( r_, x );
     res = res0 = sync_norm( r_ );
     if ( is_trivial( res ) ) return true;
 
@@ -222,14 +217,16 @@ private:
         ELAI_SYNC( v_[ m ] );
         ELAI_PROF_END( prec_elapsed_ );
 
-        v_[ m + 1 ] = A_ * v_[ m ];
+        ELAI_SPMV( v_[ m + 1 ], v_[ m ] );
 
         // Orthogonalization
-        for ( int i = 0; i <= m; ++i ) ELAI_PROD( h( i, m ), v_[ m + 1 ], v_[ i ] );
+        // Classical Gram-Schmidt: all products go into one reduction.
+        for ( int i = 0; i <= m; ++i ) ELAI_PROD_DEFER( h( i, m ), v_[ m + 1 ], v_[ i ] );
+        ELAI_REDUCE();
         for ( int i = 0; i <= m; ++i ) v_[ m + 1 ] = v_[ m + 1 ] - h( i, m ) * v_[ i ];
 
         // Normalization
-        h( m + 1, m ) = sync_norm( v_[ m + 1 ] );
+        h( m + 1, m ) = fix_norm( v_[ m + 1 ] );
         v_[ m + 1 ] = ( static_cast< Coef >( 1e0 ) / h( m + 1, m ) ) * v_[ m + 1 ];
 
         // Givens Transformation
@@ -274,12 +271,7 @@ private:
 #endif
         // Convergence Check
         if ( rel_converged( e_( m ), res0 ) ) converged = true;
-        if ( isOK( converged ) )
-        {
-          converged = true;
-          break;
-        }
-        else converged = false;
+        if ( converged ) break;
       }
 
       // Solve via backward-substitute with preconditioner
@@ -307,7 +299,7 @@ private:
       // DIVERGED
       if ( iter_max() <= ++itr ) break;
 
-      r_ = b_ - A_ * x;
+      residual( r_, x );
       res = sync_norm( r_ );
       v_[ 0 ] = ( static_cast< Coef >( 1e0 ) / res ) * r_;
       e_.clear( static_cast< Coef >( 0e0 ) ); e_( 0 ) = res;
@@ -332,10 +324,31 @@ public:
 #endif
       )
     , v_( NULL )
-    , y_(), r_( A_.m() ), c_(), s_(), e_(), h_()
+    , y_(), r_( m() ), c_(), s_(), e_(), h_()
+    , restart_( 50 )
+  {
+    iter_max( m() / 2 );
+    setup_();
+  }
+  gmres
+    ( const linear_map< Coef >& A
+    , const vector< Coef >& b
+    , preconditioner< Coef > *P = NULL
+#ifdef ELAI_USE_MPI
+    , coherence *coherent = NULL
+#endif
+    )
+    : ksp< Coef >
+      ( A, b, P
+#ifdef ELAI_USE_MPI
+      , coherent
+#endif
+      )
+    , v_( NULL )
+    , y_(), r_( m() ), c_(), s_(), e_(), h_()
     , restart_( 50 )
   {
-    iter_max( A_.m() / 2 );
+    iter_max( m() / 2 );
     setup_();
   }
   ~gmres()
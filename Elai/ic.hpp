@@ -27,6 +27,8 @@
 #include "blas.hpp"
 #include "preconditioner.hpp"
 #include "fillin.hpp"
+#include "schedule.hpp"
+#include "multicolor.hpp"
 
 namespace elai
 {
@@ -34,102 +36,244 @@ namespace elai
 template< class Range >
 class ic : public preconditioner< Range >
 {
+  // With a multicolor order, the factors are of P A P^T, whose values are
+  // PA_->val()[ k ] = A.val()[ map_[ k ] ]; vectors are permuted via w_.
+  const multicolor *order_;
+  int *map_;
+  matrix< Range > *PA_;
+  mutable vector< Range > w_;
   fillin< Range > prec_;
   int *diag_;
+  // Factors split for the solves: strictly lower L, strictly upper D L^T
+  // and D^-1. The values in prec_ are released once split.
+  int *lind_, *lcol_;
+  Range *lval_;
+  int *uind_, *ucol_;
+  Range *uval_;
+  Range *idiag_;
 
-protected:
-  void forward_( vector< Range >& x ) const
+  struct io_
+  {
+    const vector< Range >& in;
+    vector< Range >& out;
+  };
+
+  static matrix< Range > *permuted_( const matrix< Range >& A, const multicolor *order, int *map )
+  {
+    matrix< Range > *PA;
+
+    if ( order == NULL ) return NULL;
+    PA = new matrix< Range >();
+    order->permute( A, *PA, map );
+
+    return PA;
+  }
+  vector< Range >& gather_( vector< Range >& x ) const
+  {
+    if ( order_ == NULL ) return x;
+    for ( int r = 0; r < w_.m(); ++r ) w_( r ) = x( order_->perm()[ r ] );
+
+    return w_;
+  }
+  void scatter_( vector< Range >& x ) const
+  {
+    if ( order_ == NULL ) return;
+    for ( int r = 0; r < w_.m(); ++r ) x( order_->perm()[ r ] ) = w_( r );
+  }
+
+  void destruct_split_()
+  {
+    if ( lind_ != NULL ) { delete [] lind_; lind_ = NULL; }
+    if ( lcol_ != NULL ) { delete [] lcol_; lcol_ = NULL; }
+    if ( lval_ != NULL ) { delete [] lval_; lval_ = NULL; }
+    if ( uind_ != NULL ) { delete [] uind_; uind_ = NULL; }
+    if ( ucol_ != NULL ) { delete [] ucol_; ucol_ = NULL; }
+    if ( uval_ != NULL ) { delete [] uval_; uval_ = NULL; }
+    if ( idiag_ != NULL ) { delete [] idiag_; idiag_ = NULL; }
+  }
+  // Splits the factors in prec_, once they are computed.
+  void split_()
   {
-    const matrix< Range >& A = preconditioner< Range >::A_;
     const int *ind = prec_.xadj();
     const int *col = prec_.adjy();
     const Range *coef = prec_.coef();
+    int m = prec_.m(), nl = 0, nu = 0;
 
-    for ( int i = 0; i < A.m(); ++i )
+    destruct_split_();
+    lind_ = new int[ m + 1 ];
+    uind_ = new int[ m + 1 ];
+    idiag_ = new Range[ m ];
+    lind_[ 0 ] = uind_[ 0 ] = 0;
+    for ( int i = 0; i < m; ++i )
     {
       for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
       {
-        int j = col[ k ];
-
-        if ( i <= j ) break; // L( i, i ) = 1.;
-        x( i ) -= coef[ k ] * x( j );
+        if ( col[ k ] < i ) ++nl;
+        else if ( i < col[ k ] ) ++nu;
       }
+      lind_[ i + 1 ] = nl;
+      uind_[ i + 1 ] = nu;
     }
-  }
-  void backward_( vector< Range >& x ) const
-  {
-    const matrix< Range >& A = preconditioner< Range >::A_;
-    const int *ind = prec_.xadj();
-    const int *col = prec_.adjy();
-    const Range *coef = prec_.coef();
-
-    for ( int i = A.m() - 1; 0 <= i; --i )
+    lcol_ = new int[ nl ];
+    lval_ = new Range[ nl ];
+    ucol_ = new int[ nu ];
+    uval_ = new Range[ nu ];
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < m; ++i )
     {
+      int l = lind_[ i ], u = uind_[ i ];
       Range diag = static_cast< Range >( 1 );
 
       for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
       {
         int j = col[ k ];
 
-        if ( j < i ) continue;
+        if ( j < i ) { lcol_[ l ] = j; lval_[ l++ ] = coef[ k ]; }
         else if ( j == i ) diag = coef[ k ];
-        else if ( i < j ) x( i ) -= diag * coef[ k ] * x( j );
+        else { ucol_[ u ] = j; uval_[ u++ ] = diag * coef[ k ]; }
       }
-      x( i ) /= diag;
+      idiag_[ i ] = static_cast< Range >( 1 ) / diag;
     }
   }
-  void forwardInv_( vector< Range >& x ) const
+
+  // Row kernels, run in the order of prec_.lower() or prec_.upper().
+  void forward_row_( vector< Range >& x, int i ) const
+  {
+    Range s = x( i );
+
+    for ( int k = lind_[ i ]; k < lind_[ i + 1 ]; ++k ) s -= lval_[ k ] * x( lcol_[ k ] );
+    x( i ) = s; // L( i, i ) = 1.
+  }
+  void forward_io_row_( const io_& x, int i ) const
+  {
+    Range s = x.in( i );
+
+    for ( int k = lind_[ i ]; k < lind_[ i + 1 ]; ++k ) s -= lval_[ k ] * x.out( lcol_[ k ] );
+    x.out( i ) = s;
+  }
+  void backward_row_( vector< Range >& x, int i ) const
+  {
+    Range s = x( i );
+
+    for ( int k = uind_[ i ]; k < uind_[ i + 1 ]; ++k ) s -= uval_[ k ] * x( ucol_[ k ] );
+    x( i ) = s * idiag_[ i ];
+  }
+  // Row i writes only itself and reads the finished rows j < i.
+  void factor_row_( int *diag, int i ) const
   {
-    const matrix< Range >& A = preconditioner< Range >::A_;
     const int *ind = prec_.xadj();
     const int *col = prec_.adjy();
-    const Range *coef = prec_.coef();
-    vector< Range > tmp( x );
+    Range *coef = prec_.coef();
 
-    for ( int i = 0; i < A.m(); ++i )
+    for ( int off = ind[ i ]; off < ind[ i + 1 ]; ++off )
     {
-      for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
+      int j = col[ off ];
+
+      if ( i == j ) continue;
+      else if ( i < j )
       {
-        int j = col[ k ];
+        coef[ off ] /= coef[ diag[ i ] ];
+        continue;
+      }
+      for ( int off1 = off + 1, off2 = ind[ j ]
+          ; off1 < ind[ i + 1 ] && off2 < ind[ j + 1 ]
+          ;)
+      {
+        int j1 = col[ off1 ]; // j+1 < j1
+        int j2 = col[ off2 ];
 
-        if ( i <= j ) break;
-        tmp( i ) += coef[ k ] * x( j );
+        if ( j1 < j2 ) { ++off1; continue; }
+        else if ( j2 < j1 ) { ++off2; continue; }
+        coef[ off1 ] -= coef[ off ] * coef[ off2 ];
+        ++off1; ++off2;
       }
+      coef[ off ] /= coef[ diag[ j ] ];
     }
-    x = tmp;
   }
+
+protected:
+  void forward_( vector< Range >& x ) const
+  {
+    prec_.lower().run( bind_row( *this, gather_( x ), &ic::forward_row_ ) );
+    scatter_( x );
+  }
+  void backward_( vector< Range >& x ) const
+  {
+    prec_.upper().run( bind_row( *this, gather_( x ), &ic::backward_row_ ) );
+    scatter_( x );
+  }
+  // The forward sweep reads in and writes out, so no copy is needed first.
+  void apply_( const vector< Range >& in, vector< Range >& out ) const
+  {
+    if ( order_ != NULL )
+    {
+      for ( int r = 0; r < w_.m(); ++r ) w_( r ) = in( order_->perm()[ r ] );
+      prec_.lower().run( bind_row( *this, w_, &ic::forward_row_ ) );
+      prec_.upper().run( bind_row( *this, w_, &ic::backward_row_ ) );
+      for ( int r = 0; r < w_.m(); ++r ) out( order_->perm()[ r ] ) = w_( r );
+      return;
+    }
+
+    const io_ x = { in, out };
+
+    prec_.lower().run( bind_row( *this, x, &ic::forward_io_row_ ) );
+    prec_.upper().run( bind_row( *this, out, &ic::backward_row_ ) );
+  }
+  void forwardInv_( vector< Range >& x ) const
+  {
+    vector< Range >& y = gather_( x );
+    vector< Range > tmp( y );
+
+    for ( int i = 0; i < prec_.m(); ++i )
+      for ( int k = lind_[ i ]; k < lind_[ i + 1 ]; ++k ) tmp( i ) += lval_[ k ] * y( lcol_[ k ] );
+    y = tmp;
+    scatter_( x );
+  }
+  // D and L^T, i.e. D^-1 times the stored D L^T.
   void backwardInv_( vector<Range >& x ) const
   {
-    const matrix< Range >& A = preconditioner< Range >::A_;
-    const int *ind = prec_.xadj();
-    const int *col = prec_.adjy();
-    const Range *coef = prec_.coef();
-    vector< Range > tmp( x );
+    vector< Range >& y = gather_( x );
+    vector< Range > tmp( y );
 
-    for ( int i = 0; i < A.m(); ++i )
+    for ( int i = 0; i < prec_.m(); ++i )
     {
-      for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
-      {
-        int j = col[ k ];
-
-        if ( j < i ) continue;
-        tmp( i ) += coef[ k ] * x( j );
-      }
+      tmp( i ) += y( i ) / idiag_[ i ];
+      for ( int k = uind_[ i ]; k < uind_[ i + 1 ]; ++k ) tmp( i ) += idiag_[ i ] * uval_[ k ] * y( ucol_[ k ] );
     }
-    x = tmp;
+    y = tmp;
+    scatter_( x );
   }
 
 public:
   ic( const matrix< Range >& A, int lv = 0 )
-    : preconditioner< Range >( A ), prec_( A ), diag_( NULL )
+    : preconditioner< Range >( A ), order_( NULL ), map_( NULL ), PA_( NULL ), w_()
+    , prec_( A ), diag_( NULL )
+    , lind_( NULL ), lcol_( NULL ), lval_( NULL )
+    , uind_( NULL ), ucol_( NULL ), uval_( NULL ), idiag_( NULL )
+  {
+    prec_( lv );
+    diag_ = new int[ A.m() ];
+  }
+  // Factors in the multicolor order, whose colors are the levels of IC(0).
+  ic( const matrix< Range >& A, const multicolor& order, int lv = 0 )
+    : preconditioner< Range >( A ), order_( &order ), map_( new int[ A.nnz() ] )
+    , PA_( permuted_( A, &order, map_ ) ), w_( A.m() )
+    , prec_( *PA_ ), diag_( NULL )
+    , lind_( NULL ), lcol_( NULL ), lval_( NULL )
+    , uind_( NULL ), ucol_( NULL ), uval_( NULL ), idiag_( NULL )
   {
     prec_( lv );
     diag_ = new int[ A.m() ];
   }
   ~ic()
   {
-    // DO NOTHING! OWNERSHIPS ARE OTHERS!! WITHOUT diag_.
+    // DO NOTHING! OWNERSHIPS ARE OTHERS!! WITHOUT diag_, map_, PA_ AND SPLIT FACTORS.
+    destruct_split_();
     delete [] diag_;
+    if ( PA_ != NULL ) delete PA_;
+    if ( map_ != NULL ) delete [] map_;
   }
 
   void factor()
@@ -137,8 +281,9 @@ public:
     const matrix< Range >& A = preconditioner< Range >::A_;
     const int *ind = prec_.xadj();
     const int *col = prec_.adjy();
-    Range *coef = prec_.coef();
 
+    // A may have been scaled since.
+    if ( PA_ != NULL ) for ( int k = 0; k < PA_->nnz(); ++k ) PA_->val()[ k ] = A.val( map_[ k ] );
     prec_.setup();
     // L-part of coef: i < j, L( i, i ) = 1 is the implicit assumption.
     // L^T-part of coef: j < i
@@ -146,35 +291,9 @@ public:
     for ( int i = 0; i < A.m(); ++i )
       for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
         if ( col[ k ] == i ) { diag_[ i ] = k; break; }
-    for ( int off = ind[ 0 ] + 1; off < ind[ 1 ]; ++off )
-      coef[ off ] /= coef[ 0 ];
-    for ( int i = 1; i < A.m(); ++i )
-    {
-      for ( int off = ind[ i ]; off < ind[ i + 1 ]; ++off )
-      {
-        int j = col[ off ];
-
-        if ( i == j ) continue;
-        else if ( i < j )
-        {
-          coef[ off ] /= coef[ diag_[ i ] ];
-          continue;
-        }
-        for ( int off1 = off + 1, off2 = ind[ j ]
-            ; off1 < ind[ i + 1 ] && off2 < ind[ j + 1 ]
-            ;)
-        {
-          int j1 = col[ off1 ]; // j+1 < j1
-          int j2 = col[ off2 ];
-
-          if ( j1 < j2 ) { ++off1; continue; }
-          else if ( j2 < j1 ) { ++off2; continue; }
-          coef[ off1 ] -= coef[ off ] * coef[ off2 ];
-          ++off1; ++off2;
-        }
-        coef[ off ] /= coef[ diag_[ j ] ];
-      }
-    }
+    prec_.lower().run( bind_row( *this, diag_, &ic::factor_row_ ) );
+    split_();
+    prec_.release();
   }
 };
 
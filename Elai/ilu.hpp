@@ -20,6 +20,7 @@
 #ifndef __ELAI_ILU__
 #define __ELAI_ILU__
 
+#include <algorithm>
 #include "def.hpp"
 #include "expression.hpp"
 #include "vector.hpp"
@@ -27,6 +28,8 @@
 #include "blas.hpp"
 #include "preconditioner.hpp"
 #include "fillin.hpp"
+#include "schedule.hpp"
+#include "multicolor.hpp"
 
 namespace elai
 {
@@ -34,94 +37,294 @@ namespace elai
 template< class Range >
 class ilu : public preconditioner< Range >
 {
+  // With a multicolor order, the factors are of P A P^T, whose values are
+  // PA_->val()[ k ] = A.val()[ map_[ k ] ]; vectors are permuted via w_.
+  const multicolor *order_;
+  int *map_;
+  matrix< Range > *PA_;
+  mutable vector< Range > w_;
   fillin< Range > prec_;
   Range thr_;
+  int *diag_;
+  bool factored_;
+  // Factors split for the solves: strictly lower L, strictly upper U and
+  // D^-1, without the dropped entries. The values in prec_ are released
+  // once split.
+  int *lind_, *lcol_;
+  Range *lval_;
+  int *uind_, *ucol_;
+  Range *uval_;
+  Range *idiag_;
 
-protected:
-  void forward_( vector< Range >& x ) const
+  struct io_
+  {
+    const vector< Range >& in;
+    vector< Range >& out;
+  };
+
+  static matrix< Range > *permuted_( const matrix< Range >& A, const multicolor *order, int *map )
+  {
+    matrix< Range > *PA;
+
+    if ( order == NULL ) return NULL;
+    PA = new matrix< Range >();
+    order->permute( A, *PA, map );
+
+    return PA;
+  }
+  vector< Range >& gather_( vector< Range >& x ) const
+  {
+    if ( order_ == NULL ) return x;
+    for ( int r = 0; r < w_.m(); ++r ) w_( r ) = x( order_->perm()[ r ] );
+
+    return w_;
+  }
+  void scatter_( vector< Range >& x ) const
+  {
+    if ( order_ == NULL ) return;
+    for ( int r = 0; r < w_.m(); ++r ) x( order_->perm()[ r ] ) = w_( r );
+  }
+
+  void destruct_split_()
+  {
+    if ( lind_ != NULL ) { delete [] lind_; lind_ = NULL; }
+    if ( lcol_ != NULL ) { delete [] lcol_; lcol_ = NULL; }
+    if ( lval_ != NULL ) { delete [] lval_; lval_ = NULL; }
+    if ( uind_ != NULL ) { delete [] uind_; uind_ = NULL; }
+    if ( ucol_ != NULL ) { delete [] ucol_; ucol_ = NULL; }
+    if ( uval_ != NULL ) { delete [] uval_; uval_ = NULL; }
+    if ( idiag_ != NULL ) { delete [] idiag_; idiag_ = NULL; }
+  }
+  // Splits the factors in prec_, once they are computed.
+  void split_()
   {
-    const matrix< Range >& A = preconditioner< Range >::A_;
     const int *ind = prec_.xadj();
     const int *col = prec_.adjy();
     const Range *coef = prec_.coef();
+    int m = prec_.m(), nl = 0, nu = 0;
 
-    for ( int i = 0; i < A.m(); ++i )
+    destruct_split_();
+    lind_ = new int[ m + 1 ];
+    uind_ = new int[ m + 1 ];
+    idiag_ = new Range[ m ];
+    lind_[ 0 ] = uind_[ 0 ] = 0;
+    for ( int i = 0; i < m; ++i )
     {
+      for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
+      {
+        if ( fabs( coef[ k ] ) <= thr_ ) continue;
+        if ( col[ k ] < i ) ++nl;
+        else if ( i < col[ k ] ) ++nu;
+      }
+      lind_[ i + 1 ] = nl;
+      uind_[ i + 1 ] = nu;
+    }
+    lcol_ = new int[ nl ];
+    lval_ = new Range[ nl ];
+    ucol_ = new int[ nu ];
+    uval_ = new Range[ nu ];
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < m; ++i )
+    {
+      int l = lind_[ i ], u = uind_[ i ];
+
+      idiag_[ i ] = static_cast< Range >( 1 );
       for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
       {
         int j = col[ k ];
 
         if ( fabs( coef[ k ] ) <= thr_ ) continue;
-        if ( i <= j ) break;
-        x( i ) -= coef[ k ] * x( j );
+        if ( j < i ) { lcol_[ l ] = j; lval_[ l++ ] = coef[ k ]; }
+        else if ( j == i ) idiag_[ i ] = static_cast< Range >( 1 ) / coef[ k ];
+        else { ucol_[ u ] = j; uval_[ u++ ] = coef[ k ]; }
       }
-      // L( i, i ) = 1.
     }
   }
-  void backward_( vector< Range >& x ) const
+  // Puts the split factors back on the pattern, the dropped entries as 0.
+  void unsplit_()
   {
-    const matrix< Range >& A = preconditioner< Range >::A_;
     const int *ind = prec_.xadj();
     const int *col = prec_.adjy();
-    const Range *coef = prec_.coef();
+    Range *coef = prec_.coef();
+    int m = prec_.m();
 
-    for ( int i = A.m() - 1; 0 <= i; --i )
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < m; ++i )
     {
-      Range diag = static_cast< Range >( 1 );
+      int l = lind_[ i ], u = uind_[ i ];
 
       for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
       {
         int j = col[ k ];
 
-        if ( fabs( coef[ k ] ) <= thr_ ) continue;
-        if ( j < i ) continue;
-        else if ( j == i ) diag = coef[ k ];
-        else if ( i < j ) x( i ) -= coef[ k ] * x( j );
+        coef[ k ] = static_cast< Range >( 0 );
+        if ( j < i ) { if ( l < lind_[ i + 1 ] && lcol_[ l ] == j ) coef[ k ] = lval_[ l++ ]; }
+        else if ( j == i ) coef[ k ] = static_cast< Range >( 1 ) / idiag_[ i ];
+        else if ( u < uind_[ i + 1 ] && ucol_[ u ] == j ) coef[ k ] = uval_[ u++ ];
       }
-      x( i ) /= diag;
     }
   }
-  void forwardInv_( vector< Range >& x ) const
+
+  // Row kernels, run in the order of prec_.lower() or prec_.upper().
+  void forward_row_( vector< Range >& x, int i ) const
+  {
+    Range s = x( i );
+
+    for ( int k = lind_[ i ]; k < lind_[ i + 1 ]; ++k ) s -= lval_[ k ] * x( lcol_[ k ] );
+    x( i ) = s; // L( i, i ) = 1.
+  }
+  void forward_io_row_( const io_& x, int i ) const
+  {
+    Range s = x.in( i );
+
+    for ( int k = lind_[ i ]; k < lind_[ i + 1 ]; ++k ) s -= lval_[ k ] * x.out( lcol_[ k ] );
+    x.out( i ) = s;
+  }
+  void backward_row_( vector< Range >& x, int i ) const
+  {
+    Range s = x( i );
+
+    for ( int k = uind_[ i ]; k < uind_[ i + 1 ]; ++k ) s -= uval_[ k ] * x( ucol_[ k ] );
+    x( i ) = s * idiag_[ i ];
+  }
+  // One fixed-point update of the entries of row i ( Chow--Patel ):
+  //   L( i, j ) = ( A( i, j ) - sum_{ k < j } L( i, k ) U( k, j ) ) / U( j, j ), j < i
+  //   U( i, j ) =   A( i, j ) - sum_{ k < i } L( i, k ) U( k, j ),             i <= j
+  // Rows are updated in place while others may read them; that asynchrony
+  // is part of the method and only changes the number of sweeps needed.
+  void iterate_row_( const Range *a, int i ) const
   {
-    const matrix< Range >& A = preconditioner< Range >::A_;
     const int *ind = prec_.xadj();
     const int *col = prec_.adjy();
-    const Range *coef = prec_.coef();
-    vector< Range > tmp( x );
+    Range *coef = prec_.coef();
 
-    for ( int i = 0; i < A.m(); ++i )
+    for ( int off = ind[ i ]; off < ind[ i + 1 ]; ++off )
     {
-      for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
+      int j = col[ off ], lim = std::min( i, j );
+      Range acc = a[ off ];
+
+      for ( int kk = ind[ i ]; kk < ind[ i + 1 ] && col[ kk ] < lim; ++kk )
       {
-        int j = col[ k ];
+        int k = col[ kk ];
+        const int *beg = col + ( diag_[ k ] < 0 ? ind[ k ] : diag_[ k ] );
+        const int *end = col + ind[ k + 1 ];
+        const int *p = std::lower_bound( beg, end, j );
 
-        if ( fabs( coef[ k ] ) <= thr_ ) continue;
-        if ( i <= j ) break;
-        tmp( i ) += coef[ k ] * x( j );
+        if ( p != end && *p == j ) acc -= coef[ kk ] * coef[ p - col ];
       }
+      if ( i <= j ) coef[ off ] = acc;
+      else if ( 0 <= diag_[ j ] ) coef[ off ] = acc / coef[ diag_[ j ] ];
     }
-    x = tmp;
   }
-  void backwardInv_( vector<Range >& x ) const
+
+  // Refreshes the permuted values and finds the diagonals.
+  void prepare_()
   {
     const matrix< Range >& A = preconditioner< Range >::A_;
     const int *ind = prec_.xadj();
     const int *col = prec_.adjy();
-    const Range *coef = prec_.coef();
-    vector< Range > tmp( x );
 
+    // A may have been scaled since.
+    if ( PA_ != NULL ) for ( int k = 0; k < PA_->nnz(); ++k ) PA_->val()[ k ] = A.val( map_[ k ] );
+    // L-part of coef: i < j, L( i, i ) = 1 is assumed implicitly.
+    // U-part of coef: i <=j
     for ( int i = 0; i < A.m(); ++i )
     {
+      diag_[ i ] = -1;
       for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
+        if ( col[ k ] == i ) { diag_[ i ] = k; break; }
+    }
+  }
+
+  // Row i reads only the finished rows j < i of its L pattern.
+  void factor_row_( const Range& thr, int i ) const
+  {
+    const int *ind = prec_.xadj();
+    const int *col = prec_.adjy();
+    Range *coef = prec_.coef();
+
+    for ( int off = ind[ i ]; off < ind[ i + 1 ]; ++off )
+    {
+      int j = col[ off ];
+
+      if ( i <= j || diag_[ j ] < 0 ) break;
+      coef[ off ] /= coef[ diag_[ j ] ];
+      if ( fabs( coef[ off ] ) <= thr ) { coef[ off ] = static_cast< Range >( 0 ); continue; }
+      for ( int off1 = off + 1, off2 = ind[ j ]
+          ; off1 < ind[ i + 1 ] && off2 < ind[ j + 1 ]
+          ;
+          )
       {
-        int j = col[ k ];
+        int j1 = col[ off1 ]; // j+1 < j1
+        int j2 = col[ off2 ];
 
-        if ( fabs( coef[ k ] ) <= thr_ ) continue;
-        if ( j < i ) continue;
-        tmp( i ) += coef[ k ] * x( j );
+        if ( j1 < j2 ) { ++off1; continue; }
+        else if ( j2 < j1 ) { ++off2; continue; }
+        if ( fabs( coef[ off2 ] ) <= thr ) { ++off1; ++off2; continue; }
+        coef[ off1 ] -= coef[ off ] * coef[ off2 ];
+        ++off1; ++off2;
       }
     }
-    x = tmp;
+    // Dropped U( i, j ) are cleared here, once the row is done, instead of
+    // by the rows reading them, which may run at the same time.
+    for ( int off = ind[ i ]; off < ind[ i + 1 ]; ++off )
+      if ( i < col[ off ] && fabs( coef[ off ] ) <= thr ) coef[ off ] = static_cast< Range >( 0 );
+  }
+
+protected:
+  void forward_( vector< Range >& x ) const
+  {
+    prec_.lower().run( bind_row( *this, gather_( x ), &ilu::forward_row_ ) );
+    scatter_( x );
+  }
+  void backward_( vector< Range >& x ) const
+  {
+    prec_.upper().run( bind_row( *this, gather_( x ), &ilu::backward_row_ ) );
+    scatter_( x );
+  }
+  // The forward sweep reads in and writes out, so no copy is needed first.
+  void apply_( const vector< Range >& in, vector< Range >& out ) const
+  {
+    if ( order_ != NULL )
+    {
+      for ( int r = 0; r < w_.m(); ++r ) w_( r ) = in( order_->perm()[ r ] );
+      prec_.lower().run( bind_row( *this, w_, &ilu::forward_row_ ) );
+      prec_.upper().run( bind_row( *this, w_, &ilu::backward_row_ ) );
+      for ( int r = 0; r < w_.m(); ++r ) out( order_->perm()[ r ] ) = w_( r );
+      return;
+    }
+
+    const io_ x = { in, out };
+
+    prec_.lower().run( bind_row( *this, x, &ilu::forward_io_row_ ) );
+    prec_.upper().run( bind_row( *this, out, &ilu::backward_row_ ) );
+  }
+  void forwardInv_( vector< Range >& x ) const
+  {
+    vector< Range >& y = gather_( x );
+    vector< Range > tmp( y );
+
+    for ( int i = 0; i < prec_.m(); ++i )
+      for ( int k = lind_[ i ]; k < lind_[ i + 1 ]; ++k ) tmp( i ) += lval_[ k ] * y( lcol_[ k ] );
+    y = tmp;
+    scatter_( x );
+  }
+  void backwardInv_( vector<Range >& x ) const
+  {
+    vector< Range >& y = gather_( x );
+    vector< Range > tmp( y );
+
+    for ( int i = 0; i < prec_.m(); ++i )
+    {
+      tmp( i ) += y( i ) / idiag_[ i ];
+      for ( int k = uind_[ i ]; k < uind_[ i + 1 ]; ++k ) tmp( i ) += uval_[ k ] * y( ucol_[ k ] );
+    }
+    y = tmp;
+    scatter_( x );
   }
 
 public:
@@ -131,61 +334,93 @@ public:
     , Range thr = static_cast< Range >( 0e0 )
     , bool is_srule = false
     )
-    : preconditioner< Range >( A ), prec_( A ), thr_( thr )
+    : preconditioner< Range >( A ), order_( NULL ), map_( NULL ), PA_( NULL ), w_()
+    , prec_( A ), thr_( thr ), diag_( NULL ), factored_( false )
+    , lind_( NULL ), lcol_( NULL ), lval_( NULL )
+    , uind_( NULL ), ucol_( NULL ), uval_( NULL ), idiag_( NULL )
+  {
+    prec_( lv, thr_, is_srule );
+    diag_ = new int[ A.m() ];
+  }
+  // Factors in the multicolor order, whose colors are the levels of ILU(0).
+  ilu
+    ( const matrix< Range >& A
+    , const multicolor& order
+    , int lv = 0
+    , Range thr = static_cast< Range >( 0e0 )
+    , bool is_srule = false
+    )
+    : preconditioner< Range >( A ), order_( &order ), map_( new int[ A.nnz() ] )
+    , PA_( permuted_( A, &order, map_ ) ), w_( A.m() )
+    , prec_( *PA_ ), thr_( thr ), diag_( NULL ), factored_( false )
+    , lind_( NULL ), lcol_( NULL ), lval_( NULL )
+    , uind_( NULL ), ucol_( NULL ), uval_( NULL ), idiag_( NULL )
   {
     prec_( lv, thr_, is_srule );
+    diag_ = new int[ A.m() ];
   }
   ~ilu()
   {
-    // DO NOTHING! OWNERSHIPS ARE OTHERS!!
+    // DO NOTHING! OWNERSHIPS ARE OTHERS!! WITHOUT diag_, map_, PA_ AND SPLIT FACTORS.
+    destruct_split_();
+    delete [] diag_;
+    if ( PA_ != NULL ) delete PA_;
+    if ( map_ != NULL ) delete [] map_;
   }
 
   void factor( Range thr = static_cast< Range >( -1e0 ) )
   {
-    const matrix< Range >& A = preconditioner< Range >::A_;
+    if ( 0 < thr ) thr_ = thr;
+    prepare_();
+    // Copy coefficients from A to prec
+    prec_.setup();
+    prec_.lower().run( bind_row( *this, thr, &ilu::factor_row_ ) );
+    split_();
+    prec_.release();
+    factored_ = true;
+  }
+
+  // Iterative factorization on the same pattern: every sweep updates all
+  // the entries in parallel. If warm, the current factors ( e.g. those of
+  // the previous Newton step ) are the initial guess, which needs only a
+  // few sweeps when A changed a little; otherwise it starts from A.
+  void refactor( int sweeps = 3, bool warm = true )
+  {
     const int *ind = prec_.xadj();
     const int *col = prec_.adjy();
-    Range *coef = prec_.coef();
-    int diag[ A.m() ];
+    int m = prec_.m();
+    Range *a = new Range[ prec_.nnz() ];
 
-    if ( 0 < thr ) thr_ = thr;
-    // Copy coefficients from A to prec
+    prepare_();
     prec_.setup();
-    // L-part of coef: i < j, L( i, i ) = 1 is assumed implicitly.
-    // U-part of coef: i <=j
-    for ( int i = 0; i < A.m(); ++i )
-    {
-      diag[ i ] = -1;
-      for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
-        if ( col[ k ] == i ) { diag[ i ] = k; break; }
-    }
-    for ( int i = 1; i < A.m(); ++i )
+
+    Range *coef = prec_.coef();
+
+    for ( int k = 0; k < prec_.nnz(); ++k ) a[ k ] = coef[ k ];
+    if ( warm && factored_ ) unsplit_();
+    else
     {
-      for ( int off = ind[ i ]; off < ind[ i + 1 ]; ++off )
-      {
-        int j = col[ off ];
-
-        if ( i <= j || diag[ j ] < 0 ) break;
-        coef[ off ] /= coef[ diag[ j ] ];
-        //if ( fabs( coef[ off ] ) <= thr ) continue;
-        if ( fabs( coef[ off ] ) <= thr ) { coef[ off ] = static_cast< Range >( 0 ); continue; }
-        for ( int off1 = off + 1, off2 = ind[ j ]
-            ; off1 < ind[ i + 1 ] && off2 < ind[ j + 1 ]
-            ;
-            )
+      for ( int i = 0; i < m; ++i )
+        for ( int off = ind[ i ]; off < ind[ i + 1 ]; ++off )
         {
-          int j1 = col[ off1 ]; // j+1 < j1
-          int j2 = col[ off2 ];
-
-          if ( j1 < j2 ) { ++off1; continue; }
-          else if ( j2 < j1 ) { ++off2; continue; }
-          //if ( fabs( coef[ off2 ] ) <= thr ) { ++off1; ++off2; continue; }
-          if ( fabs( coef[ off2 ] ) <= thr ) { coef[ off2 ] = static_cast< Range >( 0 ); ++off1; ++off2; continue; }
-          coef[ off1 ] -= coef[ off ] * coef[ off2 ];
-          ++off1; ++off2;
+          int j = col[ off ];
+
+          coef[ off ] = a[ off ];
+          if ( j < i && 0 <= diag_[ j ] ) coef[ off ] /= a[ diag_[ j ] ];
         }
-      }
     }
+    for ( int s = 0; s < sweeps; ++s )
+    {
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for schedule( dynamic, 64 )
+#endif
+      for ( int i = 0; i < m; ++i ) iterate_row_( a, i );
+    }
+    split_();
+    prec_.release();
+    factored_ = true;
+
+    delete [] a;
   }
 };
 
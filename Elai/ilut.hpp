@@ -0,0 +1,300 @@
+/*
+ *
+ * Elastic Linear Algebra Interface (ELAI)
+ *
+ * Copyright 2013-2015 H. KOSHIMOTO, AIST
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __ELAI_ILUT__
+#define __ELAI_ILUT__
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "def.hpp"
+#include "expression.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "blas.hpp"
+#include "preconditioner.hpp"
+#include "schedule.hpp"
+
+namespace elai
+{
+
+// Dual threshold ILUT( tau, p ): in each row, entries below tau times the
+// norm of the row of A are dropped, and at most p entries are kept in each
+// of L and U. Only the kept entries are stored:
+// L ( strictly lower, unit diagonal ), U ( strictly upper ) and D^-1.
+template< class Range >
+class ilut : public preconditioner< Range >
+{
+  typedef std::pair< Range, int > Entry; // ( magnitude, column )
+
+  Range tau_;
+  int p_;
+  int *lind_, *lcol_;
+  Range *lval_;
+  int *uind_, *ucol_;
+  Range *uval_;
+  Range *idiag_;
+  level_schedule lower_, upper_;
+
+  void destruct()
+  {
+    if ( lind_ != NULL ) { delete [] lind_; lind_ = NULL; }
+    if ( lcol_ != NULL ) { delete [] lcol_; lcol_ = NULL; }
+    if ( lval_ != NULL ) { delete [] lval_; lval_ = NULL; }
+    if ( uind_ != NULL ) { delete [] uind_; uind_ = NULL; }
+    if ( ucol_ != NULL ) { delete [] ucol_; ucol_ = NULL; }
+    if ( uval_ != NULL ) { delete [] uval_; uval_ = NULL; }
+    if ( idiag_ != NULL ) { delete [] idiag_; idiag_ = NULL; }
+  }
+
+  static bool greater_( const Entry& lhs, const Entry& rhs ) { return rhs.first < lhs.first; }
+
+  // Keeps the p largest of the candidates in w over thr, sorted by column.
+  void keep_
+    ( const std::vector< int >& cand, const std::vector< Range >& w, Range thr
+    , std::vector< int >& col, std::vector< Range >& val
+    ) const
+  {
+    std::vector< Entry > e;
+
+    for ( unsigned int n = 0; n < cand.size(); ++n )
+      if ( thr < fabs( w[ cand[ n ] ] ) ) e.push_back( Entry( fabs( w[ cand[ n ] ] ), cand[ n ] ) );
+    if ( 0 <= p_ && p_ < static_cast< int >( e.size() ) )
+    {
+      std::nth_element( e.begin(), e.begin() + p_, e.end(), greater_ );
+      e.resize( p_ );
+    }
+
+    std::vector< int > kept;
+
+    for ( unsigned int n = 0; n < e.size(); ++n ) kept.push_back( e[ n ].second );
+    std::sort( kept.begin(), kept.end() );
+    for ( unsigned int n = 0; n < kept.size(); ++n )
+    {
+      col.push_back( kept[ n ] );
+      val.push_back( w[ kept[ n ] ] );
+    }
+  }
+
+  void forward_row_( vector< Range >& x, int i ) const
+  {
+    for ( int k = lind_[ i ]; k < lind_[ i + 1 ]; ++k ) x( i ) -= lval_[ k ] * x( lcol_[ k ] );
+    // L( i, i ) = 1.
+  }
+  void backward_row_( vector< Range >& x, int i ) const
+  {
+    for ( int k = uind_[ i ]; k < uind_[ i + 1 ]; ++k ) x( i ) -= uval_[ k ] * x( ucol_[ k ] );
+    x( i ) *= idiag_[ i ];
+  }
+
+protected:
+  void forward_( vector< Range >& x ) const
+  {
+    lower_.run( bind_row( *this, x, &ilut::forward_row_ ) );
+  }
+  void backward_( vector< Range >& x ) const
+  {
+    upper_.run( bind_row( *this, x, &ilut::backward_row_ ) );
+  }
+  void forwardInv_( vector< Range >& x ) const
+  {
+    vector< Range > tmp( x );
+    const matrix< Range >& A = preconditioner< Range >::A_;
+
+    for ( int i = 0; i < A.m(); ++i )
+      for ( int k = lind_[ i ]; k < lind_[ i + 1 ]; ++k ) tmp( i ) += lval_[ k ] * x( lcol_[ k ] );
+    x = tmp;
+  }
+  void backwardInv_( vector< Range >& x ) const
+  {
+    vector< Range > tmp( x );
+    const matrix< Range >& A = preconditioner< Range >::A_;
+
+    for ( int i = 0; i < A.m(); ++i )
+    {
+      tmp( i ) = x( i ) / idiag_[ i ];
+      for ( int k = uind_[ i ]; k < uind_[ i + 1 ]; ++k ) tmp( i ) += uval_[ k ] * x( ucol_[ k ] );
+    }
+    x = tmp;
+  }
+
+public:
+  ilut
+    ( const matrix< Range >& A
+    , Range tau = static_cast< Range >( 1e-3 )
+    , int p = 10 // < 0: no limit
+    )
+    : preconditioner< Range >( A ), tau_( tau ), p_( p )
+    , lind_( NULL ), lcol_( NULL ), lval_( NULL )
+    , uind_( NULL ), ucol_( NULL ), uval_( NULL ), idiag_( NULL )
+    , lower_(), upper_()
+  {}
+  ~ilut()
+  {
+    // DO NOTHING! OWNERSHIPS ARE OTHERS!! WITHOUT FACTORS.
+    destruct();
+  }
+
+  Range tau() const { return tau_; }
+  Range tau( Range tau )
+  {
+    Range old = tau_;
+
+    tau_ = tau;
+
+    return old;
+  }
+
+  int fill() const { return p_; }
+  int fill( int p )
+  {
+    int old = p_;
+
+    p_ = p;
+
+    return old;
+  }
+
+  // Memory-budget mode: p such that nnz( L + U ) is at most about
+  // ratio * nnz( A ). Returns the old p.
+  int budget( double ratio )
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+    int p = 0;
+
+    if ( 0 < A.m() ) p = static_cast< int >( ( ratio * A.nnz() / A.m() - 1. ) / 2. );
+
+    return fill( std::max( p, 1 ) );
+  }
+
+  void factor()
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+    int m = A.m();
+    std::vector< Range > w( m, static_cast< Range >( 0 ) );
+    std::vector< int > mark( m, -1 ), lcand, ucand, lcol, ucol;
+    std::vector< Range > lval, uval;
+
+    destruct();
+    lind_ = new int[ m + 1 ];
+    uind_ = new int[ m + 1 ];
+    idiag_ = new Range[ m ];
+    lind_[ 0 ] = uind_[ 0 ] = 0;
+
+    for ( int i = 0; i < m; ++i )
+    {
+      std::priority_queue< int, std::vector< int >, std::greater< int > > heap;
+      Range norm = static_cast< Range >( 0 ), thr;
+
+      // Sparse accumulator w on the row i of A; mark tells the used columns.
+      lcand.clear();
+      ucand.clear();
+      mark[ i ] = i;
+      w[ i ] = static_cast< Range >( 0 );
+      for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k )
+      {
+        int j = A.col( k );
+
+        if ( m <= j ) continue;
+        w[ j ] = A.val( k );
+        norm += A.val( k ) * A.val( k );
+        if ( j == i ) continue;
+        mark[ j ] = i;
+        if ( j < i ) heap.push( j );
+        else ucand.push_back( j );
+      }
+      norm = std::sqrt( norm );
+      thr = tau_ * norm;
+
+      // Eliminates the lower entries in increasing order, with fill-ins.
+      while ( !heap.empty() )
+      {
+        int k = heap.top();
+        Range lk = w[ k ] * idiag_[ k ];
+
+        heap.pop();
+        if ( fabs( lk ) <= thr ) { w[ k ] = static_cast< Range >( 0 ); continue; }
+        w[ k ] = lk;
+        lcand.push_back( k );
+        for ( int off = uind_[ k ]; off < uind_[ k + 1 ]; ++off )
+        {
+          int j = ucol[ off ];
+
+          if ( mark[ j ] != i )
+          {
+            mark[ j ] = i;
+            w[ j ] = static_cast< Range >( 0 );
+            if ( j < i ) heap.push( j );
+            else if ( i < j ) ucand.push_back( j );
+          }
+          w[ j ] -= lk * uval[ off ];
+        }
+      }
+
+      keep_( lcand, w, thr, lcol, lval );
+      keep_( ucand, w, thr, ucol, uval );
+      lind_[ i + 1 ] = lcol.size();
+      uind_[ i + 1 ] = ucol.size();
+      // A zero pivot is replaced by a small one relative to the row.
+      if ( w[ i ] == static_cast< Range >( 0 ) )
+        w[ i ] = ( norm == static_cast< Range >( 0 ) )
+               ? static_cast< Range >( 1 ) : ( static_cast< Range >( 1e-4 ) + tau_ ) * norm;
+      idiag_[ i ] = static_cast< Range >( 1 ) / w[ i ];
+    }
+
+    lcol_ = new int[ lcol.size() ];
+    lval_ = new Range[ lval.size() ];
+    ucol_ = new int[ ucol.size() ];
+    uval_ = new Range[ uval.size() ];
+    std::copy( lcol.begin(), lcol.end(), lcol_ );
+    std::copy( lval.begin(), lval.end(), lval_ );
+    std::copy( ucol.begin(), ucol.end(), ucol_ );
+    std::copy( uval.begin(), uval.end(), uval_ );
+    lower_( m, lind_, lcol_, true );
+    upper_( m, uind_, ucol_, false );
+  }
+
+  // Entries of L, U and D.
+  int nnz() const
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+
+    return lind_ == NULL ? 0 : lind_[ A.m() ] + uind_[ A.m() ] + A.m();
+  }
+
+  size_t mem() const
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+    size_t sum = 0;
+
+    if ( lind_ == NULL ) return sum;
+    sum += sizeof( int ) * 2 * ( A.m() + 1 );
+    sum += ( sizeof( int ) + sizeof( Range ) ) * ( lind_[ A.m() ] + uind_[ A.m() ] );
+    sum += sizeof( Range ) * A.m();
+    sum += lower_.mem() + upper_.mem();
+
+    return sum;
+  }
+};
+
+}
+
+#endif//__ELAI_ILUT__
@@ -39,7 +39,7 @@ class jacobi : public ksp< Coef >
 
 private:
   // WORKSPACE
-  vector< Coef > r_, y_;
+  vector< Coef > r_, y_, d_;
 
   bool solve_( vector< Coef >& x )
   {
@@ -52,7 +52,8 @@ private:
       return true;
     }
 
-    r_ = b_ - A_ * x;
+    if ( !diag( d_ ) ) return false;
+    residual( r_, x );
     res = res0 = sync_norm( r_ );
     if ( is_trivial( res0 ) ) return true;
 
@@ -73,15 +74,18 @@ private:
 
       if ( isOK( converged ) ) return true;
 
-      for ( int i = 0; i < A_.m(); ++i )
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for ( int i = 0; i < m(); ++i )
       {
-        Coef a = 1. / A_( i, i );
+        Coef a = 1. / d_( i );
         r_( i ) = a * r_( i ) + x( i );
       }
       ELAI_SYNC( r_ );
       x = r_;
 
-      r_ = b_ - A_ * x;
+      residual( r_, x );
       res = sync_norm( r_ );
     }
 
@@ -99,11 +103,12 @@ private:
       return true;
     }
 
-    r_ = b_ - A_ * x;
+    if ( !diag( d_ ) ) return false;
+    residual( r_, x );
     res = res0 = sync_norm( r_ );
     if ( is_trivial( res0 ) ) return true;
 
-    for ( int i = 0; i < A_.m(); ++i )
+    for ( int i = 0; i < m(); ++i )
     {
       bool converged = false;
       Coef norm;
@@ -129,13 +134,13 @@ private:
 
       for ( int i = 0; i < iter_max(); ++i )
       {
-        Coef a = 1. / A_( i, i );
+        Coef a = 1. / d_( i );
         y_( i ) = a * y_( i ) + x( i );
       }
       ELAI_SYNC( y_ );
       x = y_;
 
-      r_ = b_ - A_ * x;
+      residual( r_, x );
       res = sync_norm( r_ );
     }
 
@@ -157,7 +162,23 @@ public:
       , coherent
 #endif
       )
-    , r_( A_.m() ), y_( A_.m() )
+    , r_( m() ), y_( m() ), d_( m() )
+  {}
+  jacobi
+    ( const linear_map< Coef >& A
+    , const vector< Coef >& b
+    , const preconditioner< Coef > *P = NULL
+#ifdef ELAI_USE_MPI
+    , coherence *coherent = NULL
+#endif
+    )
+    : ksp< Coef >
+      ( A, b, P
+#ifdef ELAI_USE_MPI
+      , coherent
+#endif
+      )
+    , r_( m() ), y_( m() ), d_( m() )
   {}
   ~jacobi() {}
 
@@ -167,6 +188,7 @@ public:
 
     sum += r_.mem();
     sum += y_.mem();
+    sum += d_.mem();
 
     return sum;
   }
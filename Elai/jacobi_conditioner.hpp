@@ -44,12 +44,18 @@ protected:
   void backward_( vector< Range >& x ) const
   {
     const matrix< Range >& A = preconditioner< Range >::A_;
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
     for ( int i = 0; i < x.m(); ++i ) x( i ) /= A( i, i );
   }
   void forwardInv_( vector< Range >& x ) const {}
   void backwardInv_( vector< Range >& x ) const
   {
     const matrix< Range >& A = preconditioner< Range >::A_;
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
     for ( int i = 0; i < x.m(); ++i ) x( i ) *= A( i, i );
   }
 };
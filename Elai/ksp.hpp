@@ -21,12 +21,15 @@
 #define __ELAI_KSP__
 
 #include <iostream>
+#include <set>
+#include <vector>
 #include "def.hpp"
 #include "coherence.hpp"
 #include "vector.hpp"
 #include "matrix.hpp"
 #include "blas.hpp"
 #include "preconditioner.hpp"
+#include "linear_map.hpp"
 #include "util.hpp"
 
 #ifdef ELAI_USE_MPI
@@ -41,14 +44,24 @@ public: /* FOR ODD COMPILERS */     \
   using ksp< Coef >::elapsed_;      \
   using ksp< Coef >::prec_elapsed_; \
   using ksp< Coef >::sync;          \
+  using ksp< Coef >::spmv;          \
+  using ksp< Coef >::residual;      \
+  using ksp< Coef >::diag;          \
+  using ksp< Coef >::m;             \
   using ksp< Coef >::isOK;          \
   using ksp< Coef >::fix;           \
+  using ksp< Coef >::dot;           \
+  using ksp< Coef >::reduce;        \
+  using ksp< Coef >::defer;         \
+  using ksp< Coef >::reduce_begin;  \
+  using ksp< Coef >::reduce_end;    \
   using ksp< Coef >::fix_norm;      \
   using ksp< Coef >::sync_norm;     \
   using ksp< Coef >::is_trivial;    \
   using ksp< Coef >::abs_converged; \
   using ksp< Coef >::rel_converged; \
   using ksp< Coef >::iter_max;      \
+  using ksp< Coef >::threads;       \
   using ksp< Coef >::mem // ; is missed advisedly.
 #else
 #define ELAI_USE_KSP                \
@@ -61,6 +74,10 @@ public: /* FOR ODD COMPILERS */     \
   using ksp< Coef >::rthres_;       \
   using ksp< Coef >::elapsed_;      \
   using ksp< Coef >::prec_elapsed_; \
+  using ksp< Coef >::spmv;          \
+  using ksp< Coef >::residual;      \
+  using ksp< Coef >::diag;          \
+  using ksp< Coef >::m;             \
   using ksp< Coef >::isOK;          \
   using ksp< Coef >::fix_norm;      \
   using ksp< Coef >::sync_norm;     \
@@ -68,22 +85,50 @@ public: /* FOR ODD COMPILERS */     \
   using ksp< Coef >::abs_converged; \
   using ksp< Coef >::rel_converged; \
   using ksp< Coef >::iter_max;      \
+  using ksp< Coef >::threads;       \
   using ksp< Coef >::mem // ; is missed advisedly.
 #endif
 
 #ifdef ELAI_USE_MPI
 #define ELAI_SYNC( v ) sync( ( v ) )
-#define ELAI_PROD( acc, x, y )    \
-  do {                            \
-    ( acc ) = ( x ) * ( y );      \
-    fix( ( acc ), ( x ), ( y ) ); \
+// ELAI_SPMV( y, x ) is y = A x followed by ELAI_SYNC( y ), but the halo
+// exchange of the boundary rows is overlapped by the interior rows.
+#define ELAI_SPMV( y, x ) spmv( ( y ), ( x ) )
+#define ELAI_PROD( acc, x, y )     \
+  do {                             \
+    ( acc ) = dot( ( x ), ( y ) ); \
+    reduce( ( acc ) );             \
+  } while ( 0 )
+// ELAI_PROD_DEFER only registers the product; it is reduced together with
+// the other registered ones by ELAI_REDUCE (or ELAI_REDUCE_BEG/END, which
+// let computations overlap the reduction). Reduced values are identical on
+// all ranks, so convergence decisions on them need no further agreement.
+#define ELAI_PROD_DEFER( acc, x, y ) \
+  do {                               \
+    ( acc ) = dot( ( x ), ( y ) );   \
+    defer( ( acc ) );                \
+  } while ( 0 )
+#define ELAI_REDUCE_BEG() reduce_begin()
+#define ELAI_REDUCE_END() reduce_end()
+#define ELAI_REDUCE()     \
+  do {                    \
+    reduce_begin();       \
+    reduce_end();         \
   } while ( 0 )
 #else
 #define ELAI_SYNC( v )
+#define ELAI_SPMV( y, x ) spmv( ( y ), ( x ) )
 #define ELAI_PROD( acc, x, y )    \
   do {                            \
     ( acc ) = ( x ) * ( y );      \
   } while ( 0 )
+#define ELAI_PROD_DEFER( acc, x, y ) \
+  do {                               \
+    ( acc ) = ( x ) * ( y );         \
+  } while ( 0 )
+#define ELAI_REDUCE_BEG()
+#define ELAI_REDUCE_END()
+#define ELAI_REDUCE()
 #endif
 
 namespace elai
@@ -93,41 +138,109 @@ template< class Coef >
 class ksp
 {
 protected:
-  const matrix< Coef >& A_;
+  const matrix< Coef >& A_; // empty for a linear_map
   const vector< Coef >& b_;
   const preconditioner< Coef > *P_;
+  const linear_map< Coef > *op_; // NULL for a matrix
 
   vector< Coef > res_;
   int iter_max_;
+  int threads_; // threads per process for the kernels, <= 0 to inherit
   Coef athres_, rthres_;
   double elapsed_, prec_elapsed_;
 
 #ifdef ELAI_USE_MPI
   coherence *coherent_;
+  coherent_reduction< Coef > reduce_;
+  std::vector< int > rows_; // boundary rows first, then interior rows
+  int nbnd_;
+  mutable std::set< void * > bases_; // exchanged, released with the solver
 
   inline void sync( vector< Coef >& u ) const
-  { if ( coherent_ != NULL ) ( *coherent_ )( u.val() ); }
+  {
+    if ( coherent_ == NULL ) return;
+    bases_.insert( u.val() );
+    ( *coherent_ )( u.val() );
+  }
+
+  inline void spmv( vector< Coef >& y, const vector< Coef >& x ) const
+  {
+    if ( op_ != NULL ) { op_->apply( x, y ); return; }
+    if ( coherent_ == NULL ) { y = A_ * x; return; }
+    bases_.insert( y.val() );
+    A_.prod( y, x, rows_, 0, nbnd_ );
+    coherent_->begin( y.val() );
+    A_.prod( y, x, rows_, nbnd_, rows_.size() );
+    coherent_->end();
+  }
 
   inline void fix( Coef& acc, const vector< Coef >& u, const vector< Coef >& v ) const
   { if ( coherent_ != NULL ) coherent_->fix( &acc, u.val(), v.val() ); }
 
+  // The local part of u^t v; the external elements are excluded.
+  inline Coef dot( const vector< Coef >& u, const vector< Coef >& v ) const
+  {
+    assert( u.m() == v.m() );
+    if ( coherent_ != NULL ) return coherent_->prod( u.val(), v.val(), u.m() );
+    else return u * v;
+  }
+
+  inline void reduce( Coef& acc ) const
+  { if ( coherent_ != NULL ) coherent_->reduce( &acc ); }
+
+  inline void defer( Coef& acc )
+  { reduce_.sum( acc ); }
+
+  inline void reduce_begin() { reduce_.begin(); }
+  inline void reduce_end() { reduce_.end(); }
+
   inline bool isOK( const bool flg ) const
   {
     if ( coherent_ != NULL ) return coherent_->all_true( flg );
     else return flg;
   }
 #else
+  inline void spmv( vector< Coef >& y, const vector< Coef >& x ) const
+  {
+    if ( op_ != NULL ) op_->apply( x, y );
+    else y = A_ * x;
+  }
+
   inline bool isOK( const bool flg ) const
   { return flg; }
 #endif
 
+  // r = b - A x
+  inline void residual( vector< Coef >& r, const vector< Coef >& x ) const
+  {
+    if ( op_ == NULL ) { r = b_ - A_ * x; return; }
+    op_->apply( x, r );
+    r = b_ - r;
+  }
+
+  // The diagonal of A into d; false if the linear_map does not know it.
+  bool diag( vector< Coef >& d ) const
+  {
+    if ( op_ != NULL ) return op_->diag( d );
+    return matrix_map< Coef >( A_ ).diag( d );
+  }
+
+  static const matrix< Coef >& unassembled_()
+  {
+    static const matrix< Coef > none;
+
+    return none;
+  }
+
   Coef fix_norm( const vector< Coef >& x ) const
   {
     Coef v;
 
-    v = x * x;
 #ifdef ELAI_USE_MPI
-    fix( v, x, x );
+    v = dot( x, x );
+    reduce( v );
+#else
+    v = x * x;
 #endif
 
     v = sqrt( v );
@@ -153,7 +266,7 @@ protected:
   { return fabs( v ) <= athres_; }
   bool abs_converged( const vector< Coef >& x )
   {
-    res_ = A_ * x - b_;
+    residual( res_, x );
 
     return sync_norm( res_ ) <= athres_;
   }
@@ -162,7 +275,7 @@ protected:
   { return fabs( r / r0 ) <= rthres_; }
   bool rel_converged( const vector< Coef >& x, const Coef r0 )
   {
-    res_ = A_ * x - b_;
+    residual( res_, x );
 
     return ( sync_norm( res_ ) / r0 ) <= rthres_;
   }
@@ -179,16 +292,48 @@ public:
     , coherence *coherent = NULL
 #endif
     )
-    : A_( A ), b_( b ), P_( P ), res_( A_.m() )
-    , iter_max_( A_.m() / 2 )
+    : A_( A ), b_( b ), P_( P ), op_( NULL ), res_( A_.m() )
+    , iter_max_( A_.m() / 2 ), threads_( 0 )
+    , athres_( static_cast< Coef >( 1e-30 ) )
+    , rthres_( static_cast< Coef >( 1e-12 ) )
+    , elapsed_( 0. ), prec_elapsed_( 0. )
+#ifdef ELAI_USE_MPI
+    , coherent_( coherent ), reduce_( coherent ), rows_(), nbnd_( 0 ), bases_()
+#endif
+  {
+#ifdef ELAI_USE_MPI
+    if ( coherent_ != NULL ) nbnd_ = coherent_->classify( A_.m(), rows_ );
+#endif
+  }
+  // Matrix-free: the products are delegated to A, which exchanges its own
+  // halo; the coherence is still needed for the reductions.
+  ksp
+    ( const linear_map< Coef >& A
+    , const vector< Coef >& b
+    , const preconditioner< Coef > *P = NULL
+#ifdef ELAI_USE_MPI
+    , coherence *coherent = NULL
+#endif
+    )
+    : A_( unassembled_() ), b_( b ), P_( P ), op_( &A ), res_( A.m() )
+    , iter_max_( A.m() / 2 ), threads_( 0 )
     , athres_( static_cast< Coef >( 1e-30 ) )
     , rthres_( static_cast< Coef >( 1e-12 ) )
     , elapsed_( 0. ), prec_elapsed_( 0. )
 #ifdef ELAI_USE_MPI
-    , coherent_( coherent )
+    , coherent_( coherent ), reduce_( coherent ), rows_(), nbnd_( 0 ), bases_()
 #endif
   {}
-  virtual ~ksp() {}
+  virtual ~ksp()
+  {
+#ifdef ELAI_USE_MPI
+    // The workspaces go away with the solver.
+    for ( std::set< void * >::iterator it = bases_.begin(); it != bases_.end(); ++it )
+      coherent_->release( *it );
+#endif
+  }
+
+  int m() const { return op_ != NULL ? op_->m() : A_.m(); }
 
   int iter_max() const { return iter_max_; }
   int iter_max( int max )
@@ -200,6 +345,16 @@ public:
     return old;
   }
 
+  int threads() const { return threads_; }
+  int threads( int n )
+  {
+    int old = threads_;
+
+    threads_ = n;
+
+    return old;
+  }
+
   Coef abs_thres() const { return athres_; }
   Coef abs_thres( Coef thres )
   {
@@ -226,6 +381,7 @@ public:
   bool solve( vector< Coef >& x )
   {
     bool flg;
+    thread_scope scope( threads_ );
 
     elapsed_ = 0;
     prec_elapsed_ = 0;
@@ -244,10 +400,13 @@ public:
     sum += sizeof( P_ );
     sum += res_.mem();
     sum += sizeof( iter_max_ );
+    sum += sizeof( threads_ );
     sum += sizeof( elapsed_ );
     sum += sizeof( prec_elapsed_ );
 #ifdef ELAI_USE_MPI
     sum += sizeof( coherent_ );
+    sum += sizeof( reduce_ );
+    sum += sizeof( int ) * rows_.capacity();
 #endif
 
     return sum;
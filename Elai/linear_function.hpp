@@ -22,6 +22,7 @@
 
 #include "def.hpp"
 #include "coherence.hpp"
+#include "exchange.hpp"
 #include "sync.hpp"
 #include "portal.hpp"
 #include "space.hpp"
@@ -59,161 +60,75 @@ private:
 #ifdef ELAI_USE_MPI
   void coherence_setup( coherence& coherent )
   {
-    MPI_Comm comm = coherent.comm();
-    int myrank = coherent.myself();
-    int comm_size = 0;
+    typedef typename Element::id_type id_type;
+    typedef std::map< int, std::vector< id_type > > Request;
 
-    MPI_Comm_size( comm, &comm_size );
-    int MNN[ comm_size ][ comm_size ];
+    MPI_Comm comm = coherent.comm();
+    Request ask, asked;
 
-    for ( int i = 0; i < comm_size; ++i ) MNN[ myrank ][ i ] = 0;
+    // Ask the owners for the external elements; only the neighbours talk.
     for ( typename Space::const_marginal_iterator it = x_.internal_begin()
         ; it != x_.internal_end(); ++it
-        ) MNN[ myrank ][ Marginal( it ).external.color() ] += 1;
-    MPI_Allgather
-      ( MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, MNN, comm_size, MPI_INT, comm );
-
-    // Ready for RECV
-    int recv_num = 0, recv_rank_num = 0;
-    for ( int i = 0; i < comm_size; ++i )
-    {
-      if ( MNN[ myrank ][ i ] <= 0 ) continue;
-      ++recv_rank_num;
-      recv_num += MNN[ myrank ][ i ];
-    }
-    int *recv_rank = new int[ recv_rank_num ];
-    int *recv_id_num = new int[ recv_rank_num ];
-    MPI_Request *recv_req = new MPI_Request[ recv_rank_num ];
-    typename Element::id_type *recv_id = new typename Element::id_type[ recv_num ];
-    for ( int i = 0, j = 0, k = 0, off = 0; i < comm_size; ++i )
-    {
-      if ( MNN[ myrank ][ i ] <= 0 ) continue;
-      recv_rank[ j ] = i;
-      recv_id_num[ j ] = MNN[ myrank ][ i ];
-      for ( typename Space::const_marginal_iterator it = x_.internal_begin()
-          ; it != x_.internal_end(); ++it
-          )
-      {
-        if ( i != Marginal( it ).external.color() ) continue;
-        recv_id[ off + k ] = Marginal( it ).external();
-        ++k;
-      }
-      off += MNN[ myrank ][ i ];
-      k = 0;
-      ++j;
-    }
+        ) ask[ Marginal( it ).external.color() ].push_back( Marginal( it ).external() );
+    sparse_exchange( comm, ask, asked );
 
-    // Ready for SEND
-    int send_num = 0, send_rank_num = 0;
-    for ( int i = 0; i < comm_size; ++i )
-    {
-      if ( MNN[ i ][ myrank ] <= 0 ) continue;
-      ++send_rank_num;
-      send_num += MNN[ i ][ myrank ];
-    }
-    int *send_rank = new int[ send_rank_num ];
-    int *send_id_num = new int[ send_rank_num ];
-    MPI_Request *send_req = new MPI_Request[ send_rank_num ];
-    typename Element::id_type *send_id = new typename Element::id_type[ send_num ];
-    for ( int i = 0, j = 0; i < comm_size; ++i )
-    {
-      if ( MNN[ i ][ myrank ] <= 0 ) continue;
-      send_rank[ j ] = i;
-      send_id_num[ j ] = MNN[ i ][ myrank ];
-      ++j;
-    }
-
-    // Send/Recv Element's id
-    for ( int i = 0, off = 0; i < send_rank_num; ++i )
-    {
-      MPI_Irecv
-        ( &send_id[ off ]
-        , send_id_num[ i ]
-        , mpi_< typename Element::id_type >().type
-        , send_rank[ i ]
-        , myrank
-        , comm
-        , &send_req[ i ]
-        );
-      off += send_id_num[ i ];
-    }
-    for ( int i = 0, off = 0; i < recv_rank_num; ++i )
-    {
-      MPI_Send
-        ( &recv_id[ off ]
-        , recv_id_num[ i ]
-        , mpi_< typename Element::id_type >().type
-        , recv_rank[ i ]
-        , recv_rank[ i ]
-        , comm
-        );
-      off += recv_id_num[ i ];
-    }
-    if ( 0 < send_rank_num ) MPI_Waitall( send_rank_num, send_req, MPI_STATUSES_IGNORE );
-
-    MPI_Aint base;
-    MPI_Get_address( f_.val(), &base );
+    coherent.extent( f_.m() );
 
     // Commit Recv Datatype
-    MPI_Datatype *recv = new MPI_Datatype[ recv_rank_num ];
-    for ( int i = 0, off = 0; i < recv_rank_num; ++i )
+    // Ghost-last numbering ( space::renumber ) gives a contiguous block for
+    // each neighbour, which is received as it is.
+    for ( typename Request::const_iterator it = ask.begin(); it != ask.end(); ++it )
     {
-      int n = recv_id_num[ i ];
-      int *len = new int[ n ];
-      MPI_Aint *addr = new MPI_Aint[ n ];
-      MPI_Datatype *type = new MPI_Datatype[ n ];
+      const std::vector< id_type >& id = it->second;
+      int n = id.size();
+      int *disp = new int[ n ];
+      bool contiguous = true;
+      MPI_Datatype recv;
 
       for ( int j = 0; j < n; ++j )
       {
-        int idx = x_.external_index( Element( recv_id[ off++ ] ) );
+        int idx = x_.external_index( Element( id[ j ] ) );
 
         coherent.exclude( idx );
-        len[ j ] = 1;
-        MPI_Get_address( &f_( idx ), &addr[ j ] );
-        //  ( &f_( x_.external_index( Element( recv_id[ off++ ] ) ) ), &addr[ j ] );
-        addr[ j ] -= base;
-        type[ j ] = mpi_< range >().type;
+        disp[ j ] = idx;
+        if ( 0 < j && disp[ j ] != disp[ j - 1 ] + 1 ) contiguous = false;
+      }
+      if ( contiguous && 0 < n )
+      {
+        recv = mpi_< range >().type;
+        coherent.read( coherent_type( recv, it->first, n, sizeof( range ) * disp[ 0 ] ) );
+      }
+      else
+      {
+        MPI_Type_create_indexed_block( n, 1, disp, mpi_< range >().type, &recv );
+        MPI_Type_commit( &recv );
+        coherent.read( recv, it->first );
       }
-      MPI_Type_create_struct( n, len, addr, type, &recv[ i ] );
-      MPI_Type_commit( &recv[ i ] );
-      coherent.read( recv[ i ], recv_rank[ i ] );
 
-      delete [] type;
-      delete [] addr;
-      delete [] len;
+      delete [] disp;
     }
 
     // Commit Send Datatype
-    MPI_Datatype *send = new MPI_Datatype[ send_rank_num ];
-    for ( int i = 0, off = 0; i < send_rank_num; ++i )
+    for ( typename Request::const_iterator it = asked.begin(); it != asked.end(); ++it )
     {
-      int n = send_id_num[ i ];
-      int *len = new int[ n ];
-      MPI_Aint *addr = new MPI_Aint[ n ];
-      MPI_Datatype *type = new MPI_Datatype[ n ];
+      const std::vector< id_type >& id = it->second;
+      int n = id.size();
+      int *disp = new int[ n ];
+      MPI_Datatype send;
 
       for ( int j = 0; j < n; ++j )
       {
-        len[ j ] = 1;
-        MPI_Get_address
-          ( &f_( x_.index( Element( send_id[ off++ ] ) ) ), &addr[ j ] );
-        addr[ j ] -= base;
-        type[ j ] = mpi_< range >().type;
+        int idx = x_.index( Element( id[ j ] ) );
+
+        coherent.boundary( idx );
+        disp[ j ] = idx;
       }
-      MPI_Type_create_struct( n, len, addr, type, &send[ i ] );
-      MPI_Type_commit( &send[ i ] );
-      coherent.write( send[ i ], send_rank[ i ] );
+      MPI_Type_create_indexed_block( n, 1, disp, mpi_< range >().type, &send );
+      MPI_Type_commit( &send );
+      coherent.write( send, it->first );
 
-      delete [] type;
-      delete [] addr;
-      delete [] len;
+      delete [] disp;
     }
-
-    delete [] send; delete [] recv;
-    delete [] send_id; delete [] recv_id;
-    delete [] send_req; delete [] recv_req;
-    delete [] send_id_num; delete [] recv_id_num;
-    delete [] send_rank; delete [] recv_rank;
   }
 
   void sync_setup( sync& s )
@@ -221,6 +136,19 @@ private:
     s.setup( f_.val(), f_.m(), mpi_< range >().type );
   }
 
+  void sync_setup( sync& s, const subjugator< Element, Neighbour >& subj )
+  {
+    int *owner = new int[ f_.m() ];
+
+    // The color is the owner rank, as in coherence_setup; sync::setup aborts
+    // if a color is beyond the communicator.
+    for ( typename Space::const_iterator it = x_.begin(); it != x_.end(); ++it )
+      owner[ Point( it ).index ] = std::max( subj.color( Point( it ).element ), -1 );
+    s.setup( f_.val(), f_.m(), mpi_< range >().type, owner );
+
+    delete [] owner;
+  }
+
   void marshalize( const portal& port ) const
   {
     port( x_ );
@@ -0,0 +1,123 @@
+/*
+ *
+ * Elastic Linear Algebra Interface (ELAI)
+ *
+ * Copyright 2013-2015 H. KOSHIMOTO, AIST
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __ELAI_LINEAR_MAP__
+#define __ELAI_LINEAR_MAP__
+
+#include <vector>
+#include "def.hpp"
+#include "coherence.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+
+namespace elai
+{
+
+// An abstract linear operator for the Krylov solvers, which need only
+// y = A x; e.g. Jacobian-free directional derivatives or Schur complements.
+// x comes with its halo consistent, and apply returns y with its halo
+// exchanged, as ELAI_SPMV does; a distributed map communicates by itself.
+// It is also an Operator of static_ksp.
+template< class Coef >
+class linear_map
+{
+public:
+  virtual ~linear_map() {}
+
+  virtual int m() const = 0;
+  virtual void apply( const vector< Coef >& x, vector< Coef >& y ) const = 0;
+  // The diagonal of A into d, if it is known.
+  virtual bool diag( vector< Coef >& d ) const
+  {
+    ( void )d;
+
+    return false;
+  }
+};
+
+// An assembled matrix as a linear_map.
+template< class Coef >
+class matrix_map : public linear_map< Coef >
+{
+  const matrix< Coef >& A_;
+#ifdef ELAI_USE_MPI
+  coherence *coherent_;
+  std::vector< int > rows_; // boundary rows first, then interior rows
+  int nbnd_;
+#endif
+
+public:
+  explicit matrix_map
+    ( const matrix< Coef >& A
+#ifdef ELAI_USE_MPI
+    , coherence *coherent = NULL
+#endif
+    )
+    : A_( A )
+#ifdef ELAI_USE_MPI
+    , coherent_( coherent ), rows_(), nbnd_( 0 )
+#endif
+  {
+#ifdef ELAI_USE_MPI
+    if ( coherent_ != NULL ) nbnd_ = coherent_->classify( A_.m(), rows_ );
+#endif
+  }
+  ~matrix_map() {}
+
+  const matrix< Coef >& mat() const { return A_; }
+
+  int m() const { return A_.m(); }
+
+  void apply( const vector< Coef >& x, vector< Coef >& y ) const
+  {
+#ifdef ELAI_USE_MPI
+    if ( coherent_ != NULL )
+    {
+      // The interior rows overlap the halo exchange of the boundary rows.
+      A_.prod( y, x, rows_, 0, nbnd_ );
+      coherent_->begin( y.val() );
+      A_.prod( y, x, rows_, nbnd_, rows_.size() );
+      coherent_->end();
+
+      return;
+    }
+#endif
+    y = A_ * x;
+  }
+
+  bool diag( vector< Coef >& d ) const
+  {
+    if ( d.m() != A_.m() ) d.setup( A_.m() );
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < A_.m(); ++i )
+    {
+      d( i ) = static_cast< Coef >( 0 );
+      for ( int k = A_.ind( i ); k < A_.ind( i + 1 ); ++k )
+        if ( A_.col( k ) == i ) { d( i ) = A_.val( k ); break; }
+    }
+
+    return true;
+  }
+};
+
+}
+
+#endif//__ELAI_LINEAR_MAP__
@@ -58,6 +58,35 @@ protected:
   virtual bool factor_() = 0;
   virtual bool solve_( const vector< Coef >& b, vector< Coef >& x ) = 0;
 
+  // k right-hand sides; one by one unless the solver takes them at once.
+  virtual bool solve_multi_( const vector< Coef > *b, vector< Coef > *x, int k )
+  {
+    bool flg = true;
+
+    for ( int r = 0; r < k; ++r ) flg = solve_( b[ r ], x[ r ] ) && flg;
+
+    return flg;
+  }
+
+  // Sparse right-hand sides, a row of B each; densified unless the solver
+  // takes them as they are.
+  virtual bool solve_sparse_( const matrix< Coef >& B, vector< Coef > *x )
+  {
+    vector< Coef > *b = new vector< Coef >[ B.m() ];
+    bool flg;
+
+    for ( int r = 0; r < B.m(); ++r )
+    {
+      b[ r ].setup( x[ r ].m() );
+      b[ r ] = static_cast< Coef >( 0 );
+      for ( int k = B.ind( r ); k < B.ind( r + 1 ); ++k ) b[ r ]( B.col( k ) ) = B.val()[ k ];
+    }
+    flg = solve_multi_( b, x, B.m() );
+    delete [] b;
+
+    return flg;
+  }
+
 public:
   lu
     ( matrix< Coef >& A
@@ -88,6 +117,16 @@ public:
     return solve_( b, x );
   }
 
+  bool solve( const vector< Coef > *b, vector< Coef > *x, int k )
+  {
+    return solve_multi_( b, x, k );
+  }
+
+  bool solve( const matrix< Coef >& B, vector< Coef > *x )
+  {
+    return solve_sparse_( B, x );
+  }
+
   size_t mem() const { return mem_; }
 };
 
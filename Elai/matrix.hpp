@@ -24,6 +24,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 #include "def.hpp"
 #include "coherence.hpp"
 #include "vector.hpp"
@@ -297,6 +298,29 @@ public:
     return z_;
   }
 
+  // y <- A x only on rows[ beg ], ..., rows[ end - 1 ]; the others are kept.
+  void prod
+    ( vector< range >& y
+    , const vector< range >& x
+    , const std::vector< int >& rows
+    , int beg
+    , int end
+    ) const
+  {
+    assert( y.m() == m_ && x.m() == n_ );
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int l = beg; l < end; ++l )
+    {
+      int i = rows[ l ];
+      range v = static_cast< range >( 0 );
+
+      for ( int k = ind_[ i ]; k < ind_[ i + 1 ]; ++k ) v += c_[ k ] * x( col_[ k ] );
+      y( i ) = v;
+    }
+  }
+
   matrix< range >& clear( const range c )
   {
     for ( int k = 0; k < nnz_; ++k ) c_[ k ] = c;
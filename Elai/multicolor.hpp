@@ -0,0 +1,218 @@
+/*
+ *
+ * Elastic Linear Algebra Interface (ELAI)
+ *
+ * Copyright 2013-2015 H. KOSHIMOTO, AIST
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __ELAI_MULTICOLOR__
+#define __ELAI_MULTICOLOR__
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "def.hpp"
+#include "matrix.hpp"
+#include "space.hpp"
+#include "family.hpp"
+
+namespace elai
+{
+
+// Block multicolor ordering of the local rows.
+// Rows are grouped into blocks of consecutive rows, and blocks are colored
+// so that no two blocks of a color are adjacent. Sweeps visit the colors
+// in turn; the blocks of a color run in parallel, rows of a block in order.
+// More colors and larger blocks converge better, but expose less parallelism:
+// colors is the least number of colors used ( when 1 < colors ), and block
+// is the number of rows per block.
+class multicolor
+{
+  typedef std::vector< std::vector< int > > Graph;
+
+  int m_, ncolor_, nblock_;
+  int *perm_;  // new -> old
+  int *iperm_; // old -> new
+  int *cptr_;  // color c holds blocks cptr_[ c ] .. cptr_[ c + 1 ]
+  int *bptr_;  // block b holds new rows bptr_[ b ] .. bptr_[ b + 1 ]
+
+  multicolor( const multicolor& );
+  multicolor& operator=( const multicolor& );
+
+  void destruct()
+  {
+    if ( perm_ != NULL ) { delete [] perm_; perm_ = NULL; }
+    if ( iperm_ != NULL ) { delete [] iperm_; iperm_ = NULL; }
+    if ( cptr_ != NULL ) { delete [] cptr_; cptr_ = NULL; }
+    if ( bptr_ != NULL ) { delete [] bptr_; bptr_ = NULL; }
+    m_ = ncolor_ = nblock_ = 0;
+  }
+
+  // adj has to be symmetric.
+  void color_( const Graph& adj, int colors, int block )
+  {
+    int m = adj.size();
+    int nb = ( m + block - 1 ) / block;
+    std::vector< int > color( nb, -1 ), mark, cnt;
+    int start = 0;
+
+    destruct();
+    m_ = m;
+    nblock_ = nb;
+    if ( colors < 1 ) colors = 1;
+
+    // Greedy in the natural order; the first free color is sought cyclically
+    // from the last one, so that at least colors colors are used.
+    for ( int b = 0; b < nb; ++b )
+    {
+      int c = -1;
+
+      for ( int i = b * block; i < std::min( m, ( b + 1 ) * block ); ++i )
+        for ( unsigned int k = 0; k < adj[ i ].size(); ++k )
+        {
+          int cb = color[ adj[ i ][ k ] / block ];
+
+          if ( 0 <= cb && adj[ i ][ k ] / block != b )
+          {
+            if ( static_cast< int >( mark.size() ) <= cb ) mark.resize( cb + 1, -1 );
+            mark[ cb ] = b;
+          }
+        }
+      for ( int n = 0; n < colors && c < 0; ++n )
+      {
+        int cc = ( start + n ) % colors;
+
+        if ( static_cast< int >( mark.size() ) <= cc || mark[ cc ] != b ) c = cc;
+      }
+      if ( c < 0 ) for ( c = colors; c < static_cast< int >( mark.size() ) && mark[ c ] == b; ++c );
+      if ( c < colors ) start = ( c + 1 ) % colors;
+      color[ b ] = c;
+      if ( ncolor_ <= c ) ncolor_ = c + 1;
+    }
+
+    // Blocks sorted by color, rows in the natural order within a block.
+    cnt.assign( ncolor_ + 1, 0 );
+    for ( int b = 0; b < nb; ++b ) ++cnt[ color[ b ] + 1 ];
+    for ( int c = 0; c < ncolor_; ++c ) cnt[ c + 1 ] += cnt[ c ];
+    cptr_ = new int[ ncolor_ + 1 ];
+    for ( int c = 0; c <= ncolor_; ++c ) cptr_[ c ] = cnt[ c ];
+
+    std::vector< int > order( nb );
+
+    for ( int b = 0; b < nb; ++b ) order[ cnt[ color[ b ] ]++ ] = b;
+    perm_ = new int[ m ];
+    iperm_ = new int[ m ];
+    bptr_ = new int[ nb + 1 ];
+    bptr_[ 0 ] = 0;
+    for ( int n = 0, r = 0; n < nb; ++n )
+    {
+      int b = order[ n ];
+
+      for ( int i = b * block; i < std::min( m, ( b + 1 ) * block ); ++i, ++r )
+      {
+        perm_[ r ] = i;
+        iperm_[ i ] = r;
+      }
+      bptr_[ n + 1 ] = r;
+    }
+  }
+
+public:
+  multicolor()
+    : m_( 0 ), ncolor_( 0 ), nblock_( 0 ), perm_( NULL ), iperm_( NULL ), cptr_( NULL ), bptr_( NULL )
+  {}
+  // From the pattern of A + A^T.
+  template< class Coef >
+  multicolor( const matrix< Coef >& A, int colors = 1, int block = 1 )
+    : m_( 0 ), ncolor_( 0 ), nblock_( 0 ), perm_( NULL ), iperm_( NULL ), cptr_( NULL ), bptr_( NULL )
+  {
+    Graph adj( A.m() );
+
+    for ( int i = 0; i < A.m(); ++i )
+      for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k )
+      {
+        int j = A.col( k );
+
+        if ( i == j || A.m() <= j ) continue;
+        adj[ i ].push_back( j );
+        adj[ j ].push_back( i );
+      }
+    color_( adj, colors, std::max( block, 1 ) );
+  }
+  // From the adjacency of a family on the elements of s, in the index of s.
+  template< class Element, class Neighbour >
+  multicolor
+    ( const family< Element, Neighbour >& f, const space< Element >& s
+    , int colors = 1, int block = 1
+    )
+    : m_( 0 ), ncolor_( 0 ), nblock_( 0 ), perm_( NULL ), iperm_( NULL ), cptr_( NULL ), bptr_( NULL )
+  {
+    Graph adj( s.size() );
+
+    f.adjacency( s, adj );
+    color_( adj, colors, std::max( block, 1 ) );
+  }
+  ~multicolor() { destruct(); }
+
+  int m() const { return m_; }
+  int colors() const { return ncolor_; }
+  int blocks() const { return nblock_; }
+  const int *perm() const { return perm_; }
+  const int *iperm() const { return iperm_; }
+  const int *cptr() const { return cptr_; }
+  const int *bptr() const { return bptr_; }
+
+  // PA = P A P^T with sorted columns; PA.val()[ k ] is A.val()[ map[ k ] ].
+  template< class Coef >
+  void permute( const matrix< Coef >& A, matrix< Coef >& PA, int *map ) const
+  {
+    int *ind = new int[ m_ + 1 ];
+    int *col = new int[ A.nnz() ];
+    Coef *val = new Coef[ A.nnz() ];
+    std::vector< std::pair< int, int > > row;
+
+    ind[ 0 ] = 0;
+    for ( int r = 0; r < m_; ++r )
+    {
+      int i = perm_[ r ];
+
+      row.clear();
+      for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k )
+        row.push_back( std::make_pair( A.col( k ) < m_ ? iperm_[ A.col( k ) ] : A.col( k ), k ) );
+      std::sort( row.begin(), row.end() );
+      ind[ r + 1 ] = ind[ r ] + row.size();
+      for ( unsigned int n = 0; n < row.size(); ++n )
+      {
+        col[ ind[ r ] + n ] = row[ n ].first;
+        val[ ind[ r ] + n ] = A.val( row[ n ].second );
+        map[ ind[ r ] + n ] = row[ n ].second;
+      }
+    }
+    PA.setup( m_, A.n(), A.nnz(), ind, col, val );
+
+    delete [] val;
+    delete [] col;
+    delete [] ind;
+  }
+
+  size_t mem() const
+  {
+    return sizeof( int ) * ( 2 * m_ + ncolor_ + nblock_ + 2 ) + sizeof( *this );
+  }
+};
+
+}
+
+#endif//__ELAI_MULTICOLOR__
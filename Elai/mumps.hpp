@@ -21,7 +21,11 @@
 #ifndef __ELAI_MUMPS__
 #define __ELAI_MUMPS__
 
+#include <algorithm>
+#include <vector>
 #include "def.hpp"
+#include "coherence.hpp"
+#include "linear_function.hpp"
 #include "lu.hpp"
 
 #define JOB_INIT	-1
@@ -99,24 +103,303 @@ class mumps : public lu< Coef >
 
   MumpsType mumps_;
   int bcast_;
+  int n_; // global dimension
+
+  // Distributed input; coherent_ is NULL for the centralized one.
+  coherence *coherent_;
+  std::vector< int > rows_;    // owned local rows
+  std::vector< int > global_;  // global index of each local element
+  std::vector< int > offsets_; // the owned rows of rank p are offsets_[ p ], ...
+  std::vector< Coef > aloc_;   // owned entries, unless they lead A
+  std::vector< Coef > loc_;    // owned part of the right-hand sides
+  // Distributed solution: the rows of the pivots on this rank
+  std::vector< int > isol_;
+  std::vector< Coef > sol_;
+  // On the host: the right-hand sides in the global order
+  std::vector< Coef > gbuf_, grhs_;
+  std::vector< int > iptr_, isparse_;
+  std::vector< Coef > vsparse_;
+
+  static Coef *ptr_( std::vector< Coef >& v ) { return v.empty() ? NULL : &v[ 0 ]; }
+  static int *ptr_( std::vector< int >& v ) { return v.empty() ? NULL : &v[ 0 ]; }
+
+  // Numbers the owned elements in the local order, rank by rank, and
+  // fetches the numbers of the external ones from their owners, by an
+  // exchange of ints on g, a function on the space of the local rows.
+  template< class Index >
+  int number_( Index& g )
+  {
+    const int m = A_.m();
+    coherence gc( g, comm_ );
+    int *tag = g.ran().val();
+    int n;
+
+    coherent_->classify( m, rows_ );
+    std::sort( rows_.begin(), rows_.end() );
+    n = rows_.size();
+    offsets_.assign( size_ + 1, 0 );
+    MPI_Allgather( &n, 1, MPI_INT, &offsets_[ 1 ], 1, MPI_INT, comm_ );
+    for ( int p = 0; p < size_; ++p ) offsets_[ p + 1 ] += offsets_[ p ];
+
+    for ( int i = 0; i < m; ++i ) tag[ i ] = -1;
+    for ( int l = 0; l < n; ++l ) tag[ rows_[ l ] ] = offsets_[ rank_ ] + l;
+    gc( tag );
+    global_.assign( tag, tag + m );
+
+    return offsets_[ size_ ];
+  }
+
+  bool owns_( int g ) const
+  { return offsets_[ rank_ ] <= g && g < offsets_[ rank_ + 1 ]; }
+
+  // Ghost-last numbering makes the owned entries a prefix of A.
+  bool leading_() const
+  { return coherent_->owned() == static_cast< int >( rows_.size() ); }
+
+  // Gathers the owned rows of k local right-hand sides to the host; the
+  // rank by rank numbering puts them in the global order.
+  void gather_( const vector< Coef > *b, int k )
+  {
+    const int n = rows_.size();
+    const MPI_Datatype type = mpi_< Coef >().type;
+    std::vector< int > counts, displs;
+
+    loc_.resize( n * k );
+    for ( int r = 0; r < k; ++r )
+      for ( int l = 0; l < n; ++l ) loc_[ r * n + l ] = b[ r ]( rows_[ l ] );
+    if ( rank_ == 0 )
+    {
+      counts.resize( size_ );
+      displs.resize( size_ );
+      for ( int p = 0; p < size_; ++p )
+      {
+        counts[ p ] = ( offsets_[ p + 1 ] - offsets_[ p ] ) * k;
+        displs[ p ] = offsets_[ p ] * k;
+      }
+      gbuf_.resize( n_ * k );
+      grhs_.resize( n_ * k );
+    }
+    MPI_Gatherv
+      ( ptr_( loc_ ), n * k, type, ptr_( gbuf_ ), ptr_( counts ), ptr_( displs ), type, 0, comm_ );
+    if ( rank_ == 0 )
+      for ( int p = 0; p < size_; ++p )
+      {
+        const int np = offsets_[ p + 1 ] - offsets_[ p ];
+
+        for ( int r = 0; r < k; ++r )
+          for ( int l = 0; l < np; ++l )
+            grhs_[ r * n_ + offsets_[ p ] + l ] = gbuf_[ offsets_[ p ] * k + r * np + l ];
+      }
+  }
+
+  // Gathers the owned entries of the sparse right-hand sides, a row of B
+  // each, to the host in the compressed column format of MUMPS.
+  void gather_sparse_( const matrix< Coef >& B )
+  {
+    const int k = B.m();
+    const MPI_Datatype type = mpi_< Coef >().type;
+    std::vector< int > cnt( k, 0 ), idx, allcnt, counts, displs;
+    std::vector< Coef > val, allval;
+
+    for ( int r = 0; r < k; ++r )
+      for ( int l = B.ind( r ); l < B.ind( r + 1 ); ++l )
+      {
+        int g = global_[ B.col( l ) ];
+
+        if ( !owns_( g ) ) continue;
+        idx.push_back( g + 1 );
+        val.push_back( B.val( l ) );
+        ++cnt[ r ];
+      }
+
+    int nnz = idx.size();
+
+    if ( rank_ == 0 )
+    {
+      allcnt.resize( size_ * k );
+      counts.resize( size_ );
+      displs.assign( size_ + 1, 0 );
+    }
+    MPI_Gather( ptr_( cnt ), k, MPI_INT, ptr_( allcnt ), k, MPI_INT, 0, comm_ );
+    MPI_Gather( &nnz, 1, MPI_INT, ptr_( counts ), 1, MPI_INT, 0, comm_ );
+    if ( rank_ == 0 )
+    {
+      for ( int p = 0; p < size_; ++p ) displs[ p + 1 ] = displs[ p ] + counts[ p ];
+      isparse_.resize( displs[ size_ ] );
+      allval.resize( displs[ size_ ] );
+      vsparse_.resize( displs[ size_ ] );
+    }
+    MPI_Gatherv( ptr_( idx ), nnz, MPI_INT, ptr_( isparse_ ), ptr_( counts ), ptr_( displs ), MPI_INT, 0, comm_ );
+    MPI_Gatherv( ptr_( val ), nnz, type, ptr_( allval ), ptr_( counts ), ptr_( displs ), type, 0, comm_ );
+    if ( rank_ != 0 ) return;
+
+    // Rank by rank to column by column.
+    std::vector< int > at( displs.begin(), displs.end() - 1 ), gidx( isparse_ );
+
+    iptr_.assign( k + 1, 1 );
+    for ( int r = 0, off = 0; r < k; ++r )
+    {
+      for ( int p = 0; p < size_; ++p )
+        for ( int c = 0; c < allcnt[ p * k + r ]; ++c, ++at[ p ], ++off )
+        {
+          isparse_[ off ] = gidx[ at[ p ] ];
+          vsparse_[ off ] = allval[ at[ p ] ];
+        }
+      iptr_[ r + 1 ] = off + 1;
+    }
+  }
+
+  // MUMPS leaves the solution on the ranks of the pivots; each entry goes
+  // to the owner of its row, and then the halo is exchanged.
+  void scatter_( vector< Coef > *x, int k )
+  {
+    const int nsol = isol_.size();
+    const MPI_Datatype type = mpi_< Coef >().type;
+    std::vector< int > owner( nsol ), scnt( size_, 0 ), rcnt( size_ ), sdis( size_, 0 ), rdis( size_, 0 );
+
+    for ( int l = 0; l < nsol; ++l )
+    {
+      owner[ l ] = std::upper_bound( offsets_.begin(), offsets_.end(), isol_[ l ] - 1 ) - offsets_.begin() - 1;
+      ++scnt[ owner[ l ] ];
+    }
+    MPI_Alltoall( ptr_( scnt ), 1, MPI_INT, ptr_( rcnt ), 1, MPI_INT, comm_ );
+    for ( int p = 1; p < size_; ++p )
+    {
+      sdis[ p ] = sdis[ p - 1 ] + scnt[ p - 1 ];
+      rdis[ p ] = rdis[ p - 1 ] + rcnt[ p - 1 ];
+    }
+
+    const int nrecv = rdis[ size_ - 1 ] + rcnt[ size_ - 1 ];
+    std::vector< int > sidx( nsol ), ridx( nrecv ), at( sdis );
+    std::vector< Coef > sval( nsol * k ), rval( nrecv * k );
+
+    for ( int l = 0; l < nsol; ++l )
+    {
+      int j = at[ owner[ l ] ]++;
+
+      sidx[ j ] = isol_[ l ] - 1;
+      for ( int r = 0; r < k; ++r ) sval[ j * k + r ] = sol_[ r * nsol + l ];
+    }
+    MPI_Alltoallv
+      ( ptr_( sidx ), ptr_( scnt ), ptr_( sdis ), MPI_INT
+      , ptr_( ridx ), ptr_( rcnt ), ptr_( rdis ), MPI_INT, comm_ );
+    for ( int p = 0; p < size_; ++p )
+    {
+      scnt[ p ] *= k; sdis[ p ] *= k;
+      rcnt[ p ] *= k; rdis[ p ] *= k;
+    }
+    MPI_Alltoallv
+      ( ptr_( sval ), ptr_( scnt ), ptr_( sdis ), type
+      , ptr_( rval ), ptr_( rcnt ), ptr_( rdis ), type, comm_ );
+    for ( int j = 0; j < nrecv; ++j )
+    {
+      int i = rows_[ ridx[ j ] - offsets_[ rank_ ] ];
+
+      for ( int r = 0; r < k; ++r ) x[ r ]( i ) = rval[ j * k + r ];
+    }
+    for ( int r = 0; r < k; ++r ) ( *coherent_ )( x[ r ].val() );
+  }
+
+  void init_( const mumps_options& opt )
+  {
+    bcast_ = opt.bcast;
+    mumps_.job = JOB_INIT;
+    mumps_.par = opt.par;
+    mumps_.sym = opt.sym;
+    mumps_.comm_fortran = MPI_Comm_c2f( comm_ );
+    Mumps::call( &mumps_ );
+  }
+
+  void analyse_( const mumps_options& opt )
+  {
+    mumps_.job = JOB_ANALYSE;
+    mumps_.ICNTL(  4 ) = opt.debug;	// log level
+    mumps_.ICNTL(  5 ) = 0;		// Assembled Format
+    mumps_.ICNTL(  6 ) = 7;		// permutation to avoid diagonal zero (automatic choice)
+    mumps_.ICNTL(  7 ) = 5;		// ordering (METIS, in case ICNTL(28) = 1)
+    mumps_.ICNTL( 10 ) = opt.iter;	// #of Iterative Refinement
+    mumps_.ICNTL( 11 ) = opt.stat;	// Error Analysis
+    mumps_.ICNTL( 14 ) = opt.work;	// Work space ( default: 20 )
+    mumps_.ICNTL( 24 ) = 1;		// Pivot On
+    mumps_.ICNTL( 28 ) = 1;		// Sequencial ordering
+    mumps_.ICNTL( 29 ) = 2;		// ParMetis ordering (in case ICNTL(28) = 2) 
+
+    mumps_.CNTL( 1 ) = opt.pivot_quality;	// Numerical Pivot Quality
+    mumps_.CNTL( 3 ) = opt.pivot_dynamic;	// Dynamic Pivot Threshold
+    mumps_.CNTL( 4 ) = opt.pivot_static;	// Static Pivot Threshold
+    mumps_.CNTL( 5 ) = opt.pivot_fixation;	// Null diagonal scale
+
+    mumps_.ICNTL( 20 ) = 0;		// dense RHS
+    Mumps::call( &mumps_ );
+
+    mem_ = mumps_.INFOG(17);		// sum of INFO(15); estimated memory usage in MB
+  }
 
   bool factor_()
   {
     mumps_.job = JOB_FACTORIZE;
 
-    if ( rank_ == 0 ) mumps_.a = A_.val();
-    //else mumps_.a_loc = A_.val();
+    if ( coherent_ == NULL )
+    {
+      if ( rank_ == 0 ) mumps_.a = A_.val();
+    }
+    else if ( leading_() ) mumps_.a_loc = A_.val();
+    else
+    {
+      aloc_.resize( mumps_.nz_loc );
+      for ( unsigned int l = 0, off = 0; l < rows_.size(); ++l )
+        for ( int k = A_.ind( rows_[ l ] ); k < A_.ind( rows_[ l ] + 1 ); ++k )
+          aloc_[ off++ ] = A_.val( k );
+      mumps_.a_loc = ptr_( aloc_ );
+    }
     Mumps::call( &mumps_ );
 
     mem_ = mumps_.INFOG( 19 );		// sum of INFO(16); total memory usage in MB
+    if ( coherent_ != NULL ) isol_.resize( std::max( mumps_.INFO( 23 ), 0 ) );
+
+    return 0 <= mumps_.INFOG( 1 );
+  }
+
+  // The solution is left on the ranks of the pivots ( ICNTL(21)=1 ).
+  bool solve_distributed_( int k )
+  {
+    sol_.resize( std::max( static_cast< int >( isol_.size() ), 1 ) * k );
+    mumps_.nrhs = k;
+    mumps_.lrhs = n_;
+    mumps_.lsol_loc = isol_.size();
+    mumps_.sol_loc = ptr_( sol_ );
+    mumps_.isol_loc = ptr_( isol_ );
+    Mumps::call( &mumps_ );
+
+    return 0 <= mumps_.INFOG( 1 );
+  }
+
+  // Centralized input: the solution overwrites grhs_ on the host.
+  bool solve_centralized_( vector< Coef > *x, int k )
+  {
+    mumps_.nrhs = k;
+    mumps_.lrhs = n_;
+    if ( rank_ == 0 ) mumps_.rhs = ptr_( grhs_ );
+    Mumps::call( &mumps_ );
+
+    if ( 0 <= mumps_.INFOG( 1 ) )
+      for ( int r = 0; r < k; ++r )
+      {
+        if ( rank_ == 0 ) std::copy( grhs_.begin() + r * n_, grhs_.begin() + ( r + 1 ) * n_, x[ r ].val() );
+        if ( bcast_ ) MPI_Bcast( x[ r ].val(), x[ r ].m(), mpi_< Coef >().type, 0, comm_ );
+      }
 
     return 0 <= mumps_.INFOG( 1 );
   }
 
   bool solve_( const vector< Coef >& b, vector< Coef >& x )
   {
-    mumps_.job = JOB_SOLVE;
+    if ( coherent_ != NULL ) return solve_multi_( &b, &x, 1 );
 
+    mumps_.job = JOB_SOLVE;
+    mumps_.ICNTL( 20 ) = 0;		// dense RHS
+    mumps_.nrhs = 1;
+    mumps_.lrhs = n_;
     if ( rank_ == 0 )
     {
       for ( int i = 0 ; i < x.m(); ++i ) x( i ) = b( i );
@@ -132,17 +415,71 @@ class mumps : public lu< Coef >
     return 0 <= mumps_.INFOG( 1 );
   }
 
+  // All k right-hand sides in one solution phase.
+  bool solve_multi_( const vector< Coef > *b, vector< Coef > *x, int k )
+  {
+    mumps_.job = JOB_SOLVE;
+    mumps_.ICNTL( 20 ) = 0;		// dense RHS
+
+    if ( coherent_ == NULL )
+    {
+      if ( rank_ == 0 )
+      {
+        grhs_.resize( n_ * k );
+        for ( int r = 0; r < k; ++r ) std::copy( b[ r ].val(), b[ r ].val() + n_, grhs_.begin() + r * n_ );
+      }
+
+      return solve_centralized_( x, k );
+    }
+
+    gather_( b, k );
+    if ( rank_ == 0 ) mumps_.rhs = ptr_( grhs_ );
+    if ( !solve_distributed_( k ) ) return false;
+    scatter_( x, k );
+
+    return true;
+  }
+
+  bool solve_sparse_( const matrix< Coef >& B, vector< Coef > *x )
+  {
+    const int k = B.m();
+
+    mumps_.job = JOB_SOLVE;
+    mumps_.ICNTL( 20 ) = 1;		// sparse RHS
+
+    if ( coherent_ == NULL )
+    {
+      if ( rank_ == 0 )
+      {
+        iptr_.resize( k + 1 );
+        isparse_.resize( B.nnz() );
+        for ( int r = 0; r <= k; ++r ) iptr_[ r ] = B.ind( r ) + 1;
+        for ( int l = 0; l < B.nnz(); ++l ) isparse_[ l ] = B.col( l ) + 1;
+        vsparse_.assign( B.val(), B.val() + B.nnz() );
+        grhs_.resize( n_ * k );
+      }
+    }
+    else gather_sparse_( B );
+    if ( rank_ == 0 )
+    {
+      mumps_.nz_rhs = isparse_.size();
+      mumps_.irhs_ptr = ptr_( iptr_ );
+      mumps_.irhs_sparse = ptr_( isparse_ );
+      mumps_.rhs_sparse = ptr_( vsparse_ );
+    }
+    if ( coherent_ == NULL ) return solve_centralized_( x, k );
+    if ( !solve_distributed_( k ) ) return false;
+    scatter_( x, k );
+
+    return true;
+  }
+
 public:
+  // Centralized input: A is the entire matrix on the host.
   mumps( matrix< Coef >& A, MPI_Comm comm, mumps_options opt = mumps_options() )
-    : lu< Coef >( A, comm ), mumps_()
+    : lu< Coef >( A, comm ), mumps_(), n_( A.m() ), coherent_( NULL )
   {
-    // Initialize
-    bcast_ = opt.bcast;
-    mumps_.job = JOB_INIT;
-    mumps_.par = opt.par;
-    mumps_.sym = opt.sym;
-    mumps_.comm_fortran = MPI_Comm_c2f( comm_ );
-    Mumps::call( &mumps_ );
+    init_( opt );
 
     // copy matrix
     if ( rank_ == 0 ) {
@@ -158,68 +495,64 @@ public:
 	  mumps_.jcn[ off++ ] = A_.col( k ) + 1;
       //mumps_.perm_in = perm;	// user ordering in case ICNTL(7) = 1
     }
+    mumps_.ICNTL( 18 ) = 0;		// Storage Centralized
+    mumps_.ICNTL( 21 ) = 0;		// Solution Centralized
 
-    // Analyse
-    mumps_.job = JOB_ANALYSE;
-    mumps_.ICNTL(  4 ) = opt.debug;	// log level
-    mumps_.ICNTL(  5 ) = 0;		// Assembled Format
-    mumps_.ICNTL(  6 ) = 7;		// permutation to avoid diagonal zero (automatic choice)
-    mumps_.ICNTL(  7 ) = 5;		// ordering (METIS, in case ICNTL(28) = 1)
-    mumps_.ICNTL( 10 ) = opt.iter;	// #of Iterative Refinement
-    mumps_.ICNTL( 11 ) = opt.stat;	// Error Analysis
-    mumps_.ICNTL( 14 ) = opt.work;	// Work space ( default: 20 )
-    mumps_.ICNTL( 24 ) = 1;		// Pivot On
-    mumps_.ICNTL( 28 ) = 1;		// Sequencial ordering
-    mumps_.ICNTL( 29 ) = 2;		// ParMetis ordering (in case ICNTL(28) = 2) 
+    analyse_( opt );
+  }
 
-    mumps_.CNTL( 1 ) = opt.pivot_quality;	// Numerical Pivot Quality
-    mumps_.CNTL( 3 ) = opt.pivot_dynamic;	// Dynamic Pivot Threshold
-    mumps_.CNTL( 4 ) = opt.pivot_static;	// Static Pivot Threshold
-    mumps_.CNTL( 5 ) = opt.pivot_fixation;	// Null diagonal scale
+  // Distributed assembled input: A is the local action of a linear_operator
+  // on this rank, of which only the owned rows are entered with the global
+  // indices; no rank holds the entire matrix. The right-hand sides and the
+  // solutions of solve are local, and the solution stays distributed.
+  // coherent is that of u, a function on the space of the rows of A.
+  template< class Element, class Neighbour >
+  mumps
+    ( matrix< Coef >& A
+    , const linear_function< Element, Neighbour, Coef >& u
+    , coherence& coherent
+    , mumps_options opt = mumps_options()
+    )
+    : lu< Coef >( A, coherent.comm() ), mumps_(), n_( 0 ), coherent_( &coherent )
+  {
+    linear_function< Element, Neighbour, int > g( u.dom() );
 
-    //if ( size_ == 1 )
-    if ( 1 )
-    { // SINGLE
-      mumps_.ICNTL( 18 ) = 0;		// Storage Centralized
-      mumps_.ICNTL( 20 ) = 0;		// dense RHS
-      mumps_.ICNTL( 21 ) = 0;		// Solution Centralized
-    }
-#if 0
-    else	// TODO
-    { // MULTI (for future-release)
-      mumps_.ICNTL( 18 ) = 3;		// Storage Distributed (user defined directly)
-      mumps_.ICNTL( 20 ) = 0;		// dense RHS
-      mumps_.ICNTL( 21 ) = 0;		// Solution Centralized
-      if ( rank_ == 0 )
-      {
-        mumps_.nz_loc = ?.nnz();
-        mumps_.irn_loc = ?.ind();
-        mumps_.jcn_loc = ?.col();
-        mumps_.mapping = mapping; // Affiliation Ranks
-      }
-      else
+    assert( g.ran().m() == A.m() );
+    n_ = number_( g );
+    init_( opt );
+
+    if ( rank_ == 0 ) mumps_.n = n_;
+    mumps_.nz_loc = 0;
+    for ( unsigned int l = 0; l < rows_.size(); ++l )
+      mumps_.nz_loc += A_.ind( rows_[ l ] + 1 ) - A_.ind( rows_[ l ] );
+    mumps_.irn_loc = new int[ mumps_.nz_loc ];
+    mumps_.jcn_loc = new int[ mumps_.nz_loc ];
+    for ( unsigned int l = 0, off = 0; l < rows_.size(); ++l )
+      for ( int k = A_.ind( rows_[ l ] ); k < A_.ind( rows_[ l ] + 1 ); ++k, ++off )
       {
-        mumps_.nz_loc = A_.nnz();
-        mumps_.irn = NULL;
-        mumps_.irn_loc = A_.ind();
-        mumps_.jcn = NULL;
-        mumps_.jcn_loc = A_.col();
+        mumps_.irn_loc[ off ] = global_[ rows_[ l ] ] + 1;
+        mumps_.jcn_loc[ off ] = global_[ A_.col( k ) ] + 1;
       }
-    }
-#endif
-    Mumps::call( &mumps_ );
+    mumps_.ICNTL( 18 ) = 3;		// Storage Distributed (user defined directly)
+    mumps_.ICNTL( 21 ) = 1;		// Solution Distributed
 
-    mem_ = mumps_.INFOG(17);		// sum of INFO(15); estimated memory usage in MB
+    analyse_( opt );
   }
   
   ~mumps()
   {
     if ( mumps_.jcn != NULL ) { delete [] mumps_.jcn; mumps_.jcn = NULL; }
     if ( mumps_.irn != NULL ) { delete [] mumps_.irn; mumps_.irn = NULL; }
+    if ( mumps_.jcn_loc != NULL ) { delete [] mumps_.jcn_loc; mumps_.jcn_loc = NULL; }
+    if ( mumps_.irn_loc != NULL ) { delete [] mumps_.irn_loc; mumps_.irn_loc = NULL; }
     mumps_.job = JOB_END;
     Mumps::call( &mumps_ );
   }
 
+  // The global dimension, and the global index of a local element.
+  int n() const { return n_; }
+  int global( int i ) const { return coherent_ == NULL ? i : global_[ i ]; }
+
   inline int info (int idx) { return mumps_.INFO(idx); }
   inline int infog(int idx) { return mumps_.INFOG(idx); }
   inline double rinfo (int idx) { return mumps_.RINFO(idx); }
@@ -39,6 +39,12 @@ protected:
   virtual void backward_( vector< Range >& x ) const = 0;
   virtual void forwardInv_( vector< Range >& x ) const = 0;
   virtual void backwardInv_( vector< Range >& x ) const = 0;
+  virtual void apply_( const vector< Range >& in, vector< Range >& out ) const
+  {
+    out = in;
+    forward_( out );
+    backward_( out );
+  }
 
 public:
   preconditioner( const matrix< Range >& A )
@@ -62,6 +68,10 @@ public:
   {
     backwardInv_( x );
   }
+  void apply( const vector< Range >& in, vector< Range >& out ) const // out = U^-1 L^-1 in
+  {
+    apply_( in, out );
+  }
 };
 
 }
@@ -0,0 +1,484 @@
+/*
+ *
+ * Elastic Linear Algebra Interface (ELAI)
+ *
+ * Copyright 2013-2015 H. KOSHIMOTO, AIST
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __ELAI_RAS__
+#define __ELAI_RAS__
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+#include "def.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "space.hpp"
+#include "family.hpp"
+#include "subjugator.hpp"
+#include "linear_function.hpp"
+#include "linear_operator.hpp"
+#include "coherence.hpp"
+#include "preconditioner.hpp"
+#include "ilu.hpp"
+#include "ilut.hpp"
+
+#ifdef ELAI_USE_MPI
+#include "mpi.h"
+
+namespace elai
+{
+
+// Restricted additive Schwarz: M^-1 = sum_p R0_p^T A_p^-1 R_p.
+// The subdomain of a rank is its owned rows grown by overlap levels of the
+// adjacency of the global operator; A_p is the global operator restricted
+// to it and is factored by ILU( lv ), or exactly when lv < 0. R_p gathers
+// the subdomain by one coherence exchange, and R0_p^T writes back only the
+// owned rows, so that no exchange is needed on the way back.
+// With 1 < parts, the owned rows are split into parts consecutive chunks,
+// each with its own overlap and factor, which run in parallel with threads.
+// coarse() adds a second level on the chunks of the owned rows.
+// The KSP works on the local operator a ( of subjugator::operator() ).
+template< class Element, class Neighbour, class Range >
+class ras : public preconditioner< Range >
+{
+  typedef space< Element > Space;
+  typedef family< Element, Neighbour > Family;
+  typedef subjugator< Element, Neighbour > Subjugator;
+  typedef linear_function< Element, Neighbour, Range > Function;
+  typedef linear_function< Element, Neighbour, int > Index;
+  typedef linear_operator< Element, Neighbour, Range > Operator;
+  typedef std::vector< std::vector< int > > Graph;
+
+  // A subdomain; rows in the global order.
+  struct Part
+  {
+    Part() : A(), solver( NULL ), ilu( NULL ), lu( NULL ), y(), z() {}
+    ~Part()
+    {
+      if ( ilu != NULL ) delete ilu;
+      if ( lu != NULL ) delete lu;
+    }
+    matrix< Range > A;
+    std::vector< int > map; // row -> index in w_
+    std::vector< int > src; // entry -> entry of the global operator
+    std::vector< std::pair< int, int > > own; // ( row, local index ) of the written rows
+    preconditioner< Range > *solver;
+    elai::ilu< Range > *ilu;
+    ilut< Range > *lu;
+    vector< Range > y, z;
+  };
+
+  const Operator& G_; // global
+  const Operator& a_; // local
+  int overlap_, lv_;
+  Space s_;  // subdomain of the rank, ghosts last by owner
+  Function *w_;
+  coherence *coherent_;
+  std::vector< std::pair< int, int > > own_; // ( index in w_, local index )
+  std::vector< Part * > part_;
+
+  // Coarse space: the indicators of nc_ consecutive chunks of the owned
+  // rows on each rank ( Nicolaides ), none when nc_ == 0. E_ = Z^T A Z is
+  // gathered on every rank and solved there redundantly. coarse() only
+  // requests pnc_ and pmode_, which factor() switches to.
+  int nc_, mode_, pnc_, pmode_;
+  MPI_Comm comm_;
+  int rank_, size_;
+  std::vector< int > chunk_; // of own_
+  std::vector< int > gc_;    // coarse index of each local row, ghosts too
+  Function *lf_;             // on the local space, for the ghosts of q_
+  coherence *lc_;
+  matrix< Range > E_;
+  ilut< Range > *elu_;
+  mutable std::vector< Range > sc_;
+  mutable vector< Range > rc_, yc_, q_;
+
+  ras( const ras& );
+  ras& operator=( const ras& );
+
+  // Appends to seed the rows within overlap levels of it; mark is 0 on the seeds.
+  static void grow_( const Graph& adj, std::vector< int >& seed, std::vector< int >& mark, int overlap )
+  {
+    unsigned int begin = 0;
+
+    for ( int l = 0; l < overlap; ++l )
+    {
+      unsigned int end = seed.size();
+
+      for ( unsigned int n = begin; n < end; ++n )
+        for ( unsigned int k = 0; k < adj[ seed[ n ] ].size(); ++k )
+        {
+          int j = adj[ seed[ n ] ][ k ];
+
+          if ( mark[ j ] < 0 ) { mark[ j ] = l + 1; seed.push_back( j ); }
+        }
+      begin = end;
+    }
+  }
+
+  void setup_( const Subjugator& loc, const Operator& a, int color, MPI_Comm comm, int parts )
+  {
+    const Space& f = G_.ran();
+    const Space& x = G_.dom();
+    const matrix< Range >& A = G_.action();
+    int N = f.size();
+    Graph adj( N );
+    std::vector< const Element * > elem( N );
+    std::vector< int > owner( N ), d2r( x.size(), -1 ), mark( N, -1 ), sk( N, -1 );
+    std::vector< std::pair< int, int > > own;
+
+    G_.topo().adjacency( f, adj );
+    for ( typename Space::const_iterator it = f.begin(); it != f.end(); ++it )
+    {
+      typename Space::const_point pt( it );
+
+      elem[ pt.index ] = &pt.element;
+      owner[ pt.index ] = loc.color( pt.element );
+      if ( x.contain( pt.element ) ) d2r[ x.index( pt.element ) ] = pt.index;
+      if ( owner[ pt.index ] == color )
+        own.push_back( std::make_pair( a.ran().index( Element( pt.element, color ) ), pt.index ) );
+    }
+    std::sort( own.begin(), own.end() );
+
+    // The subdomain of the rank: the owned rows first, then the ghosts.
+    std::vector< int > rows;
+    std::vector< std::pair< int, int > > ghost;
+
+    for ( unsigned int n = 0; n < own.size(); ++n )
+    {
+      rows.push_back( own[ n ].second );
+      mark[ own[ n ].second ] = 0;
+    }
+    grow_( adj, rows, mark, overlap_ );
+    for ( unsigned int n = own.size(); n < rows.size(); ++n )
+      ghost.push_back( std::make_pair( owner[ rows[ n ] ], rows[ n ] ) );
+    std::sort( ghost.begin(), ghost.end() );
+    for ( unsigned int n = 0; n < own.size(); ++n )
+    {
+      int g = own[ n ].second;
+
+      sk[ g ] = s_.size();
+      s_.join( Element( *elem[ g ], color ) );
+      own_.push_back( std::make_pair( sk[ g ], own[ n ].first ) );
+    }
+    for ( unsigned int n = 0; n < ghost.size(); ++n )
+    {
+      int g = ghost[ n ].second;
+
+      sk[ g ] = s_.size();
+      s_.join( Element( *elem[ g ], color ), Element( *elem[ g ], ghost[ n ].first ) );
+    }
+    w_ = new Function( s_ );
+    coherent_ = new coherence( *w_, comm );
+
+    // The subdomains of the parts, grown within the one of the rank.
+    int np = std::max( 1, std::min( parts, static_cast< int >( own.size() ) ) );
+    std::vector< int > tl( N, -1 );
+    std::vector< std::pair< int, int > > row;
+
+    for ( int p = 0; p < np; ++p )
+    {
+      Part *P = new Part();
+      int lo = own.size() * p / np, hi = own.size() * ( p + 1 ) / np;
+      std::vector< int > t;
+
+      part_.push_back( P );
+      for ( int n = 0; n < N; ++n ) mark[ n ] = -1;
+      for ( int n = lo; n < hi; ++n )
+      {
+        t.push_back( own[ n ].second );
+        mark[ own[ n ].second ] = 0;
+      }
+      grow_( adj, t, mark, overlap_ );
+      std::sort( t.begin(), t.end() );
+
+      int m = t.size();
+      std::vector< int > ind( m + 1, 0 ), col;
+      std::vector< Range > val;
+
+      for ( int r = 0; r < m; ++r ) tl[ t[ r ] ] = r;
+      for ( int r = 0; r < m; ++r )
+      {
+        int g = t[ r ];
+
+        row.clear();
+        for ( int k = A.ind( g ); k < A.ind( g + 1 ); ++k )
+        {
+          int j = d2r[ A.col( k ) ];
+
+          if ( 0 <= j && 0 <= tl[ j ] ) row.push_back( std::make_pair( tl[ j ], k ) );
+        }
+        std::sort( row.begin(), row.end() );
+        for ( unsigned int n = 0; n < row.size(); ++n )
+        {
+          col.push_back( row[ n ].first );
+          val.push_back( A.val( row[ n ].second ) );
+          P->src.push_back( row[ n ].second );
+        }
+        ind[ r + 1 ] = col.size();
+        P->map.push_back( sk[ g ] );
+      }
+      for ( int n = lo; n < hi; ++n ) P->own.push_back( std::make_pair( tl[ own[ n ].second ], own[ n ].first ) );
+      for ( int r = 0; r < m; ++r ) tl[ t[ r ] ] = -1;
+
+      P->A.setup( m, m, col.size(), &ind[ 0 ], col.empty() ? NULL : &col[ 0 ], val.empty() ? NULL : &val[ 0 ] );
+      P->y.setup( m );
+      P->z.setup( m );
+      if ( lv_ < 0 ) P->solver = P->lu = new ilut< Range >( P->A, static_cast< Range >( 0 ), -1 );
+      else P->solver = P->ilu = new elai::ilu< Range >( P->A, lv_ );
+    }
+  }
+
+  // Local solves; owned rows only.
+  void local_( vector< Range >& x ) const
+  {
+    vector< Range >& w = w_->ran();
+    int np = part_.size();
+
+    for ( unsigned int n = 0; n < own_.size(); ++n ) w( own_[ n ].first ) = x( own_[ n ].second );
+    ( *coherent_ )( w.val() );
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for schedule( dynamic ) if ( 1 < np )
+#endif
+    for ( int p = 0; p < np; ++p )
+    {
+      Part& P = *part_[ p ];
+
+      for ( int r = 0; r < P.A.m(); ++r ) P.y( r ) = w( P.map[ r ] );
+      P.solver->apply( P.y, P.z );
+      for ( unsigned int n = 0; n < P.own.size(); ++n ) x( P.own[ n ].second ) = P.z( P.own[ n ].first );
+    }
+  }
+
+  // q = Z E^-1 Z^T r on the owned rows.
+  void coarse_( const vector< Range >& r, vector< Range >& q ) const
+  {
+    for ( int c = 0; c < nc_; ++c ) sc_[ c ] = static_cast< Range >( 0 );
+    for ( unsigned int n = 0; n < own_.size(); ++n ) sc_[ chunk_[ n ] ] += r( own_[ n ].second );
+    MPI_Allgather( &sc_[ 0 ], nc_, mpi_< Range >().type, rc_.val(), nc_, mpi_< Range >().type, comm_ );
+    elu_->apply( rc_, yc_ );
+    for ( unsigned int n = 0; n < own_.size(); ++n ) q( own_[ n ].second ) = yc_( rank_ * nc_ + chunk_[ n ] );
+  }
+
+  // E_ from the owned rows of the local operator: each rank sums its nc_
+  // rows by column and gathers only their nonzeros, by one Allgather of the
+  // row lengths and one Allgatherv each of the columns and the values.
+  // An empty chunk gets a unit diagonal.
+  void assemble_()
+  {
+    const matrix< Range >& a = preconditioner< Range >::A_;
+    int K = size_ * nc_;
+    std::vector< std::map< int, Range > > row( nc_ );
+    std::vector< int > cnt( nc_, 0 ), len( nc_, 0 ), lcol;
+    std::vector< Range > lval;
+
+    for ( unsigned int n = 0; n < own_.size(); ++n )
+    {
+      int i = own_[ n ].second;
+
+      ++cnt[ chunk_[ n ] ];
+      for ( int k = a.ind( i ); k < a.ind( i + 1 ); ++k ) row[ chunk_[ n ] ][ gc_[ a.col( k ) ] ] += a.val( k );
+    }
+    for ( int c = 0; c < nc_; ++c )
+    {
+      if ( cnt[ c ] == 0 ) row[ c ][ rank_ * nc_ + c ] = static_cast< Range >( 1 );
+      for ( typename std::map< int, Range >::const_iterator it = row[ c ].begin(); it != row[ c ].end(); ++it )
+      {
+        if ( it->second == static_cast< Range >( 0 ) ) continue;
+        lcol.push_back( it->first );
+        lval.push_back( it->second );
+        ++len[ c ];
+      }
+    }
+
+    // Rows of the ranks come in the order of the coarse indices.
+    std::vector< int > ind( K + 1, 0 ), nnz( size_ ), disp( size_ ), col;
+    std::vector< Range > val;
+
+    MPI_Allgather( &len[ 0 ], nc_, MPI_INT, &ind[ 1 ], nc_, MPI_INT, comm_ );
+    for ( int I = 0; I < K; ++I ) ind[ I + 1 ] += ind[ I ];
+    for ( int r = 0; r < size_; ++r )
+    {
+      disp[ r ] = ind[ r * nc_ ];
+      nnz[ r ] = ind[ ( r + 1 ) * nc_ ] - disp[ r ];
+    }
+    col.resize( ind[ K ] );
+    val.resize( ind[ K ] );
+    MPI_Allgatherv
+      ( lcol.empty() ? NULL : &lcol[ 0 ], lcol.size(), MPI_INT
+      , col.empty() ? NULL : &col[ 0 ], &nnz[ 0 ], &disp[ 0 ], MPI_INT, comm_ );
+    MPI_Allgatherv
+      ( lval.empty() ? NULL : &lval[ 0 ], lval.size(), mpi_< Range >().type
+      , val.empty() ? NULL : &val[ 0 ], &nnz[ 0 ], &disp[ 0 ], mpi_< Range >().type, comm_ );
+    E_.setup( K, K, col.size(), &ind[ 0 ], col.empty() ? NULL : &col[ 0 ], val.empty() ? NULL : &val[ 0 ] );
+    if ( elu_ == NULL ) elu_ = new ilut< Range >( E_, static_cast< Range >( 0 ), -1 );
+    elu_->factor();
+  }
+
+  // The chunks of the coarse space and their indices, ghosts too. Collective.
+  void coarse_setup_()
+  {
+    int m = preconditioner< Range >::A_.m();
+    int no = own_.size();
+
+    if ( elu_ != NULL ) { delete elu_; elu_ = NULL; }
+    nc_ = pnc_;
+    if ( nc_ == 0 ) return;
+    chunk_.resize( no );
+    for ( int n = 0; n < no; ++n ) chunk_[ n ] = static_cast< long long >( n ) * nc_ / no;
+    if ( lf_ == NULL )
+    {
+      lf_ = new Function( a_.ran() );
+      lc_ = new coherence( *lf_, comm_ );
+    }
+
+    // The coarse indices of the ghosts from their owners.
+    Index g( a_.ran() );
+    coherence gc( g, comm_ );
+
+    for ( int n = 0; n < no; ++n ) g.ran()( own_[ n ].second ) = rank_ * nc_ + chunk_[ n ];
+    gc( g.ran().val() );
+    gc_.assign( g.ran().val(), g.ran().val() + m );
+
+    sc_.resize( nc_ );
+    rc_.setup( size_ * nc_ );
+    yc_.setup( size_ * nc_ );
+    q_.setup( m );
+  }
+
+protected:
+  // The whole M^-1; owned rows only, the ghosts are left to the sync.
+  void forward_( vector< Range >& x ) const
+  {
+    if ( nc_ == 0 ) { local_( x ); return; }
+
+    coarse_( x, q_ );
+    if ( mode_ == MULTIPLICATIVE )
+    {
+      // x - A q on the owned rows, with the ghosts of q.
+      const matrix< Range >& a = preconditioner< Range >::A_;
+
+      ( *lc_ )( q_.val() );
+      for ( unsigned int n = 0; n < own_.size(); ++n )
+      {
+        int i = own_[ n ].second;
+
+        for ( int k = a.ind( i ); k < a.ind( i + 1 ); ++k ) x( i ) -= a.val( k ) * q_( a.col( k ) );
+      }
+    }
+    local_( x );
+    for ( unsigned int n = 0; n < own_.size(); ++n ) x( own_[ n ].second ) += q_( own_[ n ].second );
+  }
+  void backward_( vector< Range >& x ) const {}
+  // M is not formed.
+  void forwardInv_( vector< Range >& x ) const {}
+  void backwardInv_( vector< Range >& x ) const {}
+  void apply_( const vector< Range >& in, vector< Range >& out ) const
+  {
+    out = in;
+    forward_( out );
+  }
+
+public:
+  enum { ADDITIVE, MULTIPLICATIVE };
+
+  // A is the global operator, loc its subjugator and a the local operator
+  // of the rank color.
+  ras
+    ( const Operator& A, const Subjugator& loc, const Operator& a, int color, MPI_Comm comm
+    , int overlap = 1
+    , int lv = 0 // < 0: exact LU
+    , int parts = 1
+    )
+    : preconditioner< Range >( a.action() ), G_( A ), a_( a ), overlap_( overlap ), lv_( lv )
+    , s_(), w_( NULL ), coherent_( NULL ), own_(), part_()
+    , nc_( 0 ), mode_( ADDITIVE ), pnc_( 0 ), pmode_( ADDITIVE ), comm_( comm ), rank_( 0 ), size_( 1 ), chunk_(), gc_()
+    , lf_( NULL ), lc_( NULL ), E_(), elu_( NULL ), sc_(), rc_(), yc_(), q_()
+  {
+    MPI_Comm_rank( comm, &rank_ );
+    MPI_Comm_size( comm, &size_ );
+    setup_( loc, a, color, comm, parts );
+  }
+  ~ras()
+  {
+    for ( unsigned int p = 0; p < part_.size(); ++p ) delete part_[ p ];
+    if ( elu_ != NULL ) delete elu_;
+    if ( lc_ != NULL ) delete lc_;
+    if ( lf_ != NULL ) delete lf_;
+    if ( coherent_ != NULL ) delete coherent_;
+    if ( w_ != NULL ) delete w_;
+  }
+
+  int overlap() const { return overlap_; }
+  int parts() const { return part_.size(); }
+  // Rows of the subdomain of the rank.
+  int size() const { return s_.size(); }
+
+  int coarse() const { return pnc_; }
+  // Adds the coarse correction with nc vectors per rank, the same on all
+  // ranks, or removes it when nc <= 0; ADDITIVE: M^-1 + Q,
+  // MULTIPLICATIVE: Q + M^-1 ( I - A Q ). Effective from the next factor().
+  void coarse( int nc, int mode = ADDITIVE )
+  {
+    pnc_ = std::max( nc, 0 );
+    pmode_ = mode;
+  }
+
+  // Takes the values of the global operator and factors the subdomains.
+  void factor()
+  {
+    const matrix< Range >& A = G_.action();
+    int np = part_.size();
+
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for schedule( dynamic ) if ( 1 < np )
+#endif
+    for ( int p = 0; p < np; ++p )
+    {
+      Part& P = *part_[ p ];
+
+      for ( unsigned int k = 0; k < P.src.size(); ++k ) P.A.val()[ k ] = A.val( P.src[ k ] );
+      if ( P.lu != NULL ) P.lu->factor();
+      else P.ilu->factor();
+    }
+    if ( pnc_ != nc_ ) coarse_setup_();
+    mode_ = pmode_;
+    if ( 0 < nc_ ) assemble_();
+  }
+
+  size_t mem() const
+  {
+    size_t sum = sizeof( *this );
+
+    for ( unsigned int p = 0; p < part_.size(); ++p )
+    {
+      const Part& P = *part_[ p ];
+
+      sum += P.A.mem() + sizeof( int ) * ( P.map.size() + P.src.size() + 2 * P.own.size() );
+      if ( P.lu != NULL ) sum += P.lu->mem();
+    }
+    if ( elu_ != NULL ) sum += E_.mem() + elu_->mem();
+
+    return sum;
+  }
+};
+
+}
+#endif
+
+#endif//__ELAI_RAS__
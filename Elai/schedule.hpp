@@ -0,0 +1,230 @@
+/*
+ *
+ * Elastic Linear Algebra Interface (ELAI)
+ *
+ * Copyright 2013-2015 H. KOSHIMOTO, AIST
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __ELAI_SCHEDULE__
+#define __ELAI_SCHEDULE__
+
+#include <cstddef>
+#include "def.hpp"
+#ifdef ELAI_USE_OPENMP
+extern "C"
+{
+#include <sched.h>
+}
+#endif
+
+namespace elai
+{
+
+#ifdef ELAI_USE_OPENMP
+// Waits until another thread sets *flag. After a short spin it yields,
+// since threads may outnumber the cores.
+inline void spin_wait( const int *flag )
+{
+  enum { SPIN = 256 };
+
+  for ( int spin = 0; ; ++spin )
+  {
+    int ready;
+
+    #pragma omp atomic read
+    ready = *flag;
+    if ( ready ) return;
+    if ( SPIN <= spin ) sched_yield();
+  }
+}
+#endif
+
+// Binds a row kernel ( target.*fn )( arg, i ) for level_schedule::run.
+template< class Target, class Arg, class Fn >
+class row_kernel
+{
+  Target& target_;
+  Arg& arg_;
+  Fn fn_;
+
+public:
+  row_kernel( Target& target, Arg& arg, Fn fn )
+    : target_( target ), arg_( arg ), fn_( fn )
+  {}
+  void operator()( int i ) const { ( target_.*fn_ )( arg_, i ); }
+};
+
+template< class Target, class Arg, class Fn >
+row_kernel< Target, Arg, Fn > bind_row( Target& target, Arg& arg, Fn fn )
+{
+  return row_kernel< Target, Arg, Fn >( target, arg, fn );
+}
+
+// Dependency levels of a triangular sweep over a CSR pattern with sorted
+// columns. In the lower sweep, row i depends on the columns j < i of the
+// row; in the upper sweep, on the columns i < j. Rows of one level are
+// independent of each other, so they run in parallel with threads.
+class level_schedule
+{
+  // Below this number of rows per level and thread, levels are too thin
+  // for a barrier each; rows then wait only for their own dependencies.
+  enum { THIN = 16 };
+
+  int m_, nlv_;
+  bool lower_;
+  const int *xadj_, *adjy_;
+  int *ptr_; // level l holds row_[ ptr_[ l ] .. ptr_[ l + 1 ] )
+  int *row_;
+
+  level_schedule( const level_schedule& );
+  level_schedule& operator=( const level_schedule& );
+
+  void destruct()
+  {
+    if ( ptr_ != NULL ) { delete [] ptr_; ptr_ = NULL; }
+    if ( row_ != NULL ) { delete [] row_; row_ = NULL; }
+    m_ = nlv_ = 0;
+  }
+
+#ifdef ELAI_USE_OPENMP
+  template< class Kernel >
+  void by_level_( const Kernel& f ) const
+  {
+    #pragma omp parallel
+    for ( int l = 0; l < nlv_; ++l )
+    {
+      #pragma omp for schedule( static )
+      for ( int k = ptr_[ l ]; k < ptr_[ l + 1 ]; ++k ) f( row_[ k ] );
+    }
+  }
+
+  // Threads take the rows cyclically in the level order, so that every
+  // row waited for is done or taken by a thread that does not wait for it.
+  // The flags belong to the run, so that runs may go on concurrently.
+  template< class Kernel >
+  void sync_free_( const Kernel& f ) const
+  {
+    int *done = new int[ m_ ];
+
+    for ( int i = 0; i < m_; ++i ) done[ i ] = 0;
+    #pragma omp parallel
+    {
+      int nth = omp_get_num_threads();
+
+      for ( int k = omp_get_thread_num(); k < m_; k += nth )
+      {
+        int i = row_[ k ];
+
+        for ( int off = xadj_[ i ]; off < xadj_[ i + 1 ]; ++off )
+        {
+          int j = adjy_[ off ];
+
+          if ( lower_ ? i <= j : j <= i ) continue;
+          spin_wait( done + j );
+        }
+        #pragma omp flush
+        f( i );
+        #pragma omp flush
+        #pragma omp atomic write
+        done[ i ] = 1;
+      }
+    }
+    delete [] done;
+  }
+#endif
+
+public:
+  level_schedule()
+    : m_( 0 ), nlv_( 0 ), lower_( true ), xadj_( NULL ), adjy_( NULL )
+    , ptr_( NULL ), row_( NULL )
+  {}
+  ~level_schedule() { destruct(); }
+
+  // The pattern is referred to, not copied.
+  void operator()( int m, const int *xadj, const int *adjy, bool lower )
+  {
+    int *lv = new int[ m ];
+
+    destruct();
+    m_ = m;
+    lower_ = lower;
+    xadj_ = xadj;
+    adjy_ = adjy;
+    for ( int n = 0; n < m; ++n )
+    {
+      int i = lower ? n : m - 1 - n;
+
+      lv[ i ] = 0;
+      for ( int off = xadj[ i ]; off < xadj[ i + 1 ]; ++off )
+      {
+        int j = adjy[ off ];
+
+        if ( lower ? i <= j : j <= i ) continue;
+        if ( lv[ i ] <= lv[ j ] ) lv[ i ] = lv[ j ] + 1;
+      }
+      if ( nlv_ <= lv[ i ] ) nlv_ = lv[ i ] + 1;
+    }
+
+    // Counting sort by level, in the order of the sweep within a level.
+    ptr_ = new int[ nlv_ + 1 ];
+    row_ = new int[ m ];
+    for ( int l = 0; l <= nlv_; ++l ) ptr_[ l ] = 0;
+    for ( int i = 0; i < m; ++i ) ++ptr_[ lv[ i ] + 1 ];
+    for ( int l = 0; l < nlv_; ++l ) ptr_[ l + 1 ] += ptr_[ l ];
+    for ( int n = 0; n < m; ++n )
+    {
+      int i = lower ? n : m - 1 - n;
+
+      row_[ ptr_[ lv[ i ] ]++ ] = i;
+    }
+    for ( int l = nlv_; 0 < l; --l ) ptr_[ l ] = ptr_[ l - 1 ];
+    ptr_[ 0 ] = 0;
+
+    delete [] lv;
+  }
+
+  int m() const { return m_; }
+  int levels() const { return nlv_; }
+  const int *ptr() const { return ptr_; }
+  const int *row() const { return row_; }
+
+  // Calls f( i ) for every row, each after the rows it depends on.
+  // Sequential in the order of the sweep without threads.
+  template< class Kernel >
+  void run( const Kernel& f ) const
+  {
+#ifdef ELAI_USE_OPENMP
+    int nth = omp_get_max_threads();
+
+    if ( 1 < nth && !omp_in_parallel() && 0 < m_ )
+    {
+      if ( m_ < THIN * nlv_ * nth ) sync_free_( f );
+      else by_level_( f );
+      return;
+    }
+#endif
+    if ( lower_ ) for ( int i = 0; i < m_; ++i ) f( i );
+    else for ( int i = m_ - 1; 0 <= i; --i ) f( i );
+  }
+
+  size_t mem() const
+  {
+    return sizeof( int ) * ( nlv_ + 1 + m_ ) + sizeof( *this );
+  }
+};
+
+}
+
+#endif//__ELAI_SCHEDULE__
@@ -28,6 +28,7 @@
 #include "blas.hpp"
 #include "preconditioner.hpp"
 #include "ksp.hpp"
+#include "multicolor.hpp"
 
 namespace elai
 {
@@ -41,6 +42,88 @@ private:
   // WORKSPACE
   vector< Coef > r_;
   Coef acc_;
+  const multicolor *order_;
+  int blocks_;
+
+  void relax_( vector< Coef >& x, int i ) const
+  {
+    Coef acc = b_( i ), diag = static_cast< Coef >( 1. );
+
+    for ( int k = A_.ind( i ); k < A_.ind( i + 1 ); ++k )
+    {
+      int j = A_.col( k );
+
+      if ( i == j ) diag = A_.val( k );
+      else acc -= A_.val( k ) * x( j );
+    }
+    x( i ) += acc_ * ( acc / diag - x( i ) );
+  }
+
+  // Hybrid: Gauss--Seidel inside the rows [ beg, end ), Jacobi on the old
+  // values xo outside. Their l1 norm is added to the diagonal for convergence.
+  void relax_hybrid_( vector< Coef >& x, const vector< Coef >& xo, int i, int beg, int end ) const
+  {
+    Coef acc = b_( i ), diag = static_cast< Coef >( 0. ), l1 = static_cast< Coef >( 0. );
+
+    for ( int k = A_.ind( i ); k < A_.ind( i + 1 ); ++k )
+    {
+      int j = A_.col( k );
+
+      if ( beg <= j && j < end )
+      {
+        acc -= A_.val( k ) * x( j );
+        if ( i == j ) diag = A_.val( k );
+      }
+      else
+      {
+        acc -= A_.val( k ) * xo( j );
+        l1 += fabs( A_.val( k ) );
+      }
+    }
+    if ( diag < 0 ) l1 = -l1;
+    if ( diag + l1 != static_cast< Coef >( 0. ) ) x( i ) += acc_ * acc / ( diag + l1 );
+  }
+
+  // Blocks of a color are not adjacent, so they are relaxed in parallel.
+  void sweep_( vector< Coef >& x )
+  {
+    if ( order_ == NULL && 0 < blocks_ )
+    {
+      const int m = A_.m(), nb = blocks_;
+
+      // r_ keeps the old values; it is recomputed after each sweep.
+      r_ = x;
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for ( int b = 0; b < nb; ++b )
+      {
+        const int beg = static_cast< int >( static_cast< long long >( m ) * b / nb );
+        const int end = static_cast< int >( static_cast< long long >( m ) * ( b + 1 ) / nb );
+
+        for ( int i = beg; i < end; ++i ) relax_hybrid_( x, r_, i, beg, end );
+      }
+      return;
+    }
+    if ( order_ == NULL )
+    {
+      for ( int i = 0; i < A_.m(); ++i ) relax_( x, i );
+      return;
+    }
+
+    const int *perm = order_->perm();
+    const int *cptr = order_->cptr();
+    const int *bptr = order_->bptr();
+
+    for ( int c = 0; c < order_->colors(); ++c )
+    {
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for ( int b = cptr[ c ]; b < cptr[ c + 1 ]; ++b )
+        for ( int r = bptr[ b ]; r < bptr[ b + 1 ]; ++r ) relax_( x, perm[ r ] );
+    }
+  }
 
   bool solve_( vector< Coef >& x )
   {
@@ -74,19 +157,7 @@ private:
 
       if ( isOK( converged ) ) return true;
 
-      for ( int i = 0; i < A_.m(); ++i )
-      {
-        Coef acc = b_( i ), diag = static_cast< Coef >( 1. );
-
-        for ( int k = A_.ind( i ); k < A_.ind( i + 1 ); ++k )
-        {
-          int j = A_.col( k );
-
-          if ( i == j ) diag = A_.val( k );
-          else acc -= A_.val( k ) * x( j );
-        }
-        x( i ) += acc_ * ( acc / diag - x( i ) );
-      }
+      sweep_( x );
       ELAI_SYNC( x );
 
       r_ = b_ - A_ * x;
@@ -135,19 +206,7 @@ private:
       ELAI_SYNC( x );
       ELAI_PROF_END( prec_elapsed_ );
 
-      for ( int i = 0; i < A_.m(); ++i )
-      {
-        Coef acc = b_( i ), diag = static_cast< Coef >( 1. );
-
-        for ( int k = A_.ind( i ); k < A_.ind( i + 1 ); ++k )
-        {
-          int j = A_.col( k );
-
-          if ( i == j ) diag = A_.val( k );
-          else acc -= A_.val( k ) * x( j );
-        }
-        x( i ) += acc_ * ( acc / diag - x( i ) );
-      }
+      sweep_( x );
       ELAI_SYNC( x );
 
       r_ = b_ - A_ * x;
@@ -173,7 +232,7 @@ public:
 #endif
       )
     , r_( A_.m() )
-    , acc_( static_cast< Coef >( 1. ) )
+    , acc_( static_cast< Coef >( 1. ) ), order_( NULL ), blocks_( 0 )
   {}
   ~sor() {}
 
@@ -190,6 +249,23 @@ public:
     return acc;
   }
 
+  // Sweeps in a multicolor order, or in the natural order with NULL.
+  void ordering( const multicolor *order ) { order_ = order; }
+  const multicolor *ordering() const { return order_; }
+
+  // Hybrid Gauss--Seidel on blocks of rows ( e.g. one per thread ) with the
+  // l1 correction, instead of the sequential sweep; 0 turns it off.
+  // A multicolor order takes precedence.
+  int hybrid() const { return blocks_; }
+  int hybrid( int blocks )
+  {
+    int old = blocks_;
+
+    blocks_ = blocks < 0 ? 0 : blocks;
+
+    return old;
+  }
+
   size_t mem() const
   {
     size_t sum = ksp< Coef >::mem();
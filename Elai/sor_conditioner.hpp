@@ -26,6 +26,7 @@
 #include "matrix.hpp"
 #include "blas.hpp"
 #include "preconditioner.hpp"
+#include "multicolor.hpp"
 
 namespace elai
 {
@@ -41,6 +42,79 @@ class sor_conditioner : public preconditioner< Range >
 {
   int *diag_;
   Range omega_, iomega_;
+  const multicolor *order_;
+  int blocks_;
+  Range *dl1_;
+
+  int rank_( int i ) const { return order_ == NULL ? i : order_->iperm()[ i ]; }
+
+  // The hybrid sweeps go on blocks of rows, the b-th one from bound_( b ).
+  bool hybrid_() const { return order_ == NULL && 0 < blocks_; }
+  int blocks_of_() const { return hybrid_() ? blocks_ : 1; }
+  int bound_( int b ) const
+  {
+    const long long m = preconditioner< Range >::A_.m();
+
+    return static_cast< int >( m * b / blocks_of_() );
+  }
+  // The pivot of the row i, with the l1 norm outside its block in hybrid.
+  Range pivot_( int i ) const
+  {
+    return hybrid_() ? dl1_[ i ] : preconditioner< Range >::A_.val( diag_[ i ] );
+  }
+
+  // As in sor::relax_hybrid_, the l1 norm of the entries outside the block
+  // is added to the diagonal with its sign.
+  void l1_()
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+
+    if ( dl1_ == NULL ) dl1_ = new Range[ A.m() ];
+    for ( int b = 0; b < blocks_; ++b )
+    {
+      const int beg = bound_( b ), end = bound_( b + 1 );
+
+      for ( int i = beg; i < end; ++i )
+      {
+        Range diag = A.val( diag_[ i ] ), l1 = static_cast< Range >( 0. );
+
+        for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k )
+          if ( A.col( k ) < beg || end <= A.col( k ) ) l1 += fabs( A.val( k ) );
+        dl1_[ i ] = diag < 0 ? diag - l1 : diag + l1;
+      }
+    }
+  }
+
+  // Row kernels in a multicolor order: L and U are taken in the new order.
+  void forward_row_( vector< Range >& x, int i ) const
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+    const int *iperm = order_->iperm();
+    Range diag = static_cast< Range >( 1 );
+
+    for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k )
+    {
+      int j = A.col( k );
+
+      if ( i == j ) diag = A.val( k );
+      else if ( iperm[ j ] < iperm[ i ] ) x( i ) -= x( j ) * A.val( k );
+    }
+    x( i ) /= diag * iomega_;
+  }
+  void backward_row_( vector< Range >& x, int i ) const
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+    const int *iperm = order_->iperm();
+    Range acc = static_cast< Range >( 0. );
+
+    for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k )
+    {
+      int j = A.col( k );
+
+      if ( iperm[ i ] < iperm[ j ] ) acc += x( j ) * A.val( k );
+    }
+    x( i ) = ( static_cast< Range >( 2. ) - omega_ ) * x( i ) - omega_ * acc / A.val( diag_[ i ] );
+  }
 
 protected:
   void forward_( vector< Range >& x ) const
@@ -50,16 +124,49 @@ protected:
     const int *col = A.col();
     const Range *coef = A.val();
 
-    for ( int i = 0; i < A.m(); ++i )
+    if ( order_ != NULL )
+    {
+      const int *perm = order_->perm();
+      const int *cptr = order_->cptr();
+      const int *bptr = order_->bptr();
+
+      for ( int c = 0; c < order_->colors(); ++c )
+      {
+#ifdef ELAI_USE_OPENMP
+        #pragma omp parallel for
+#endif
+        for ( int b = cptr[ c ]; b < cptr[ c + 1 ]; ++b )
+          for ( int r = bptr[ b ]; r < bptr[ b + 1 ]; ++r ) forward_row_( x, perm[ r ] );
+      }
+      return;
+    }
+    // Blocks drop their coupling and are swept in parallel.
+    if ( hybrid_() )
     {
-      for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for ( int b = 0; b < blocks_; ++b )
       {
-        int j = col[ k ];
+        const int beg = bound_( b ), end = bound_( b + 1 );
 
-        if ( i < j ) break;
-        else if ( i == j ) x( i ) /= coef[ k ] * iomega_;
-        else x( i ) -= x( j ) * coef[ k ];
+        for ( int i = beg; i < end; ++i )
+        {
+          Range acc = x( i );
+
+          for ( int k = ind[ i ]; k < diag_[ i ]; ++k )
+            if ( beg <= col[ k ] ) acc -= x( col[ k ] ) * coef[ k ];
+          x( i ) = acc / ( dl1_[ i ] * iomega_ );
+        }
       }
+      return;
+    }
+    for ( int i = 0; i < A.m(); ++i )
+    {
+      Range acc = x( i );
+
+      for ( int k = ind[ i ]; k < diag_[ i ]; ++k ) acc -= x( col[ k ] ) * coef[ k ];
+      x( i ) = acc / ( coef[ diag_[ i ] ] * iomega_ );
     }
   }
   void backward_( vector< Range >& x ) const
@@ -70,18 +177,50 @@ protected:
     const Range *coef = A.val();
     const Range omega = ( static_cast< Range >( 2. ) - omega_ );
 
-    for ( int i = A.m() - 1; 0 <= i ; --i )
+    if ( order_ != NULL )
     {
-      const Range diag = coef[ diag_[ i ] ];
+      const int *perm = order_->perm();
+      const int *cptr = order_->cptr();
+      const int *bptr = order_->bptr();
 
-      for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
+      for ( int c = order_->colors() - 1; 0 <= c; --c )
+      {
+#ifdef ELAI_USE_OPENMP
+        #pragma omp parallel for
+#endif
+        for ( int b = cptr[ c ]; b < cptr[ c + 1 ]; ++b )
+          for ( int r = bptr[ b + 1 ] - 1; bptr[ b ] <= r; --r ) backward_row_( x, perm[ r ] );
+      }
+      return;
+    }
+    if ( hybrid_() )
+    {
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for ( int b = 0; b < blocks_; ++b )
       {
-        int j = col[ k ];
+        const int beg = bound_( b ), end = bound_( b + 1 );
 
-        if ( j <= i ) continue;
-        else x( i ) -=  x( j ) * omega_ * coef[ k ] / ( omega * diag );
+        for ( int i = end - 1; beg <= i; --i )
+        {
+          Range acc = static_cast< Range >( 0. );
+
+          for ( int k = diag_[ i ] + 1; k < ind[ i + 1 ]; ++k )
+            if ( col[ k ] < end ) acc += x( col[ k ] ) * coef[ k ];
+          x( i ) = omega * x( i ) - omega_ * acc / dl1_[ i ];
+        }
       }
-      x( i ) *= omega;
+      return;
+    }
+    // Columns are sorted as in forward_, so U starts next to the diagonal;
+    // one division by the diagonal for each row.
+    for ( int i = A.m() - 1; 0 <= i ; --i )
+    {
+      Range acc = static_cast< Range >( 0. );
+
+      for ( int k = diag_[ i ] + 1; k < ind[ i + 1 ]; ++k ) acc += x( col[ k ] ) * coef[ k ];
+      x( i ) = omega * x( i ) - omega_ * acc / coef[ diag_[ i ] ];
     }
   }
   void forwardInv_( vector< Range >& x ) const
@@ -92,16 +231,21 @@ protected:
     const int *col = A.col();
     const Range *coef = A.val();
 
-    for ( int i = 0; i < A.m(); ++i )
+    for ( int b = 0; b < blocks_of_(); ++b )
     {
-      x( i ) = static_cast< Range >( 0. );
-      for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
+      const int beg = bound_( b ), end = bound_( b + 1 );
+
+      for ( int i = beg; i < end; ++i )
       {
-        int j = col[ k ];
+        x( i ) = static_cast< Range >( 0. );
+        for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
+        {
+          int j = col[ k ];
 
-        if ( i < j ) break;
-        else if ( i == j ) x( i ) += tmp( j ) * coef[ k ] * iomega_;
-        else x( i ) += tmp( j ) * coef[ k ];
+          if ( j < beg || end <= j || rank_( i ) < rank_( j ) ) continue;
+          else if ( i == j ) x( i ) += tmp( j ) * pivot_( i ) * iomega_;
+          else x( i ) += tmp( j ) * coef[ k ];
+        }
       }
     }
   }
@@ -114,25 +258,32 @@ protected:
     const Range *coef = A.val();
     const Range omega = ( static_cast< Range >( 2. ) - omega_ );
 
-    for ( int i = 0; i < A.m(); ++i )
+    for ( int b = 0; b < blocks_of_(); ++b )
     {
-      const Range diag = coef[ diag_[ i ] ];
+      const int beg = bound_( b ), end = bound_( b + 1 );
 
-      x( i ) = static_cast< Range >( 0. );
-      for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
+      for ( int i = beg; i < end; ++i )
       {
-        int j = col[ k ];
+        const Range diag = pivot_( i );
+
+        x( i ) = static_cast< Range >( 0. );
+        for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
+        {
+          int j = col[ k ];
 
-        if ( i < j ) continue;
-        else if ( i == j ) x( i ) += tmp( j ) / omega;
-        else x( i ) += tmp( j ) * omega_ * coef[ k ] / ( omega * diag );
+          if ( j < beg || end <= j || rank_( i ) < rank_( j ) ) continue;
+          else if ( i == j ) x( i ) += tmp( j ) / omega;
+          else x( i ) += tmp( j ) * omega_ * coef[ k ] / ( omega * diag );
+        }
       }
     }
   }
 
 public:
-  sor_conditioner( const matrix< Range >& A, Range omega )
-    : preconditioner< Range >( A ), diag_( NULL ), omega_( omega )
+  // With order, the sweeps run color by color ( see multicolor ).
+  sor_conditioner( const matrix< Range >& A, Range omega, const multicolor *order = NULL )
+    : preconditioner< Range >( A ), diag_( NULL ), omega_( omega ), order_( order )
+    , blocks_( 0 ), dl1_( NULL )
   {
     diag_ = new int[ A.m() ];
     for ( int i = 0; i < A.m(); ++i )
@@ -145,6 +296,66 @@ public:
   ~sor_conditioner()
   {
     delete [] diag_;
+    delete [] dl1_;
+  }
+
+  Range omega() const { return omega_; }
+  Range diag( int i ) const { return preconditioner< Range >::A_.val( diag_[ i ] ); }
+
+  // Hybrid SSOR on blocks of rows ( e.g. one per thread ) with the l1
+  // correction, as sor::hybrid; 0 turns it off. A multicolor order takes
+  // precedence. upper() and eisenstat() need the exact splitting.
+  int hybrid() const { return order_ == NULL ? blocks_ : 0; }
+  int hybrid( int blocks )
+  {
+    int old = hybrid();
+
+    blocks_ = blocks < 0 ? 0 : blocks;
+    if ( hybrid_() ) l1_();
+
+    return old;
+  }
+
+  // y = U' x, to take an initial guess into the split system below.
+  void upper( const vector< Range >& x, vector< Range >& y ) const
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+    const Range iomega = static_cast< Range >( 1. ) / ( static_cast< Range >( 2. ) - omega_ );
+
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < A.m(); ++i )
+    {
+      Range acc = static_cast< Range >( 0. );
+
+      for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k )
+        if ( rank_( i ) < rank_( A.col( k ) ) ) acc += A.val( k ) * x( A.col( k ) );
+      y( i ) = iomega * ( x( i ) + omega_ * acc / A.val( diag_[ i ] ) );
+    }
+  }
+
+  // Eisenstat's trick: w = L'^-1 A U'^-1 v by two sweeps and no SpMV, since
+  // A = L' + ( 2 - w ) / w D U' + ( 1 - 2 / w ) D; t is left with U'^-1 v.
+  void eisenstat( const vector< Range >& v, vector< Range >& w, vector< Range >& t ) const
+  {
+    const Range s = ( static_cast< Range >( 2. ) - omega_ ) * iomega_;
+    const Range k = static_cast< Range >( 1. ) - static_cast< Range >( 2. ) * iomega_;
+
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < v.m(); ++i ) t( i ) = v( i );
+    backward_( t );
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < v.m(); ++i ) w( i ) = diag( i ) * ( s * v( i ) + k * t( i ) );
+    forward_( w );
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < v.m(); ++i ) w( i ) += t( i );
   }
 };
 
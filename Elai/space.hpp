@@ -311,6 +311,30 @@ public:
     return index( const_external_point( it ).internal );
   }
 
+  // Owned-first / ghost-last numbering: governed elements come first, then
+  // the internal sides of marginals grouped by the colors of their external
+  // elements. Set operations renumber the result in the element order again.
+  space< Element >& renumber()
+  {
+    std::multimap< int, Element > ghost;
+    int i = 0;
+
+    for ( iterator it = xi_.begin(); it != xi_.end(); ++it )
+      if ( !internal_contain( point( it ).element ) ) point( it ).index = i++;
+    for ( const_marginal_iterator it = i2e_.begin(); it != i2e_.end(); ++it )
+    {
+      const_internal_point pt( it );
+
+      ghost.insert( std::make_pair( pt.external.color(), pt.internal ) );
+    }
+    for ( typename std::multimap< int, Element >::const_iterator it = ghost.begin()
+        ; it != ghost.end(); ++it
+        ) index( it->second ) = i++;
+    assert( i == size() );
+
+    return *this;
+  }
+
   iterator begin() { return xi_.begin(); }
   const_iterator begin() const { return xi_.begin(); }
   const_iterator end() const { return xi_.end(); }
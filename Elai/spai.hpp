@@ -0,0 +1,210 @@
+/*
+ *
+ * Elastic Linear Algebra Interface (ELAI)
+ *
+ * Copyright 2013-2015 H. KOSHIMOTO, AIST
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __ELAI_SPAI__
+#define __ELAI_SPAI__
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "def.hpp"
+#include "expression.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "blas.hpp"
+#include "preconditioner.hpp"
+
+namespace elai
+{
+
+// Sparse approximate inverse for general A, on a static pattern: M with
+// M A ~ I, whose row i minimizes || A( J, I )^T m - e_i || over its pattern
+// J, where I is the union of the columns of the rows J of A. The rows are
+// independent least-squares problems, solved by Householder QR.
+// The application is one row-parallel SpMV with M.
+template< class Range >
+class spai : public preconditioner< Range >
+{
+  std::vector< int > pind_, pcol_;
+  matrix< Range > M_;
+  mutable vector< Range > w_;
+
+  // Least squares of the dense r x n matrix H ( column major ), r >= n,
+  // against b; the solution is left in b[ 0 .. n ).
+  static void lsq_( int r, int n, std::vector< Range >& H, std::vector< Range >& b )
+  {
+    for ( int k = 0; k < n; ++k )
+    {
+      Range *h = &H[ k * r ];
+      Range norm = static_cast< Range >( 0 ), alpha, vv = static_cast< Range >( 0 );
+
+      for ( int i = k; i < r; ++i ) norm += h[ i ] * h[ i ];
+      norm = std::sqrt( norm );
+      if ( norm == static_cast< Range >( 0 ) ) { h[ k ] = static_cast< Range >( 1 ); continue; }
+      alpha = h[ k ] < 0 ? norm : -norm;
+      // v = h - alpha e_k is kept in h[ k .. r ), R( k, k ) = alpha.
+      h[ k ] -= alpha;
+      for ( int i = k; i < r; ++i ) vv += h[ i ] * h[ i ];
+      for ( int j = k + 1; j < n; ++j )
+      {
+        Range *c = &H[ j * r ];
+        Range s = static_cast< Range >( 0 );
+
+        for ( int i = k; i < r; ++i ) s += h[ i ] * c[ i ];
+        s = 2 * s / vv;
+        for ( int i = k; i < r; ++i ) c[ i ] -= s * h[ i ];
+      }
+      {
+        Range s = static_cast< Range >( 0 );
+
+        for ( int i = k; i < r; ++i ) s += h[ i ] * b[ i ];
+        s = 2 * s / vv;
+        for ( int i = k; i < r; ++i ) b[ i ] -= s * h[ i ];
+      }
+      h[ k ] = alpha;
+    }
+    for ( int k = n - 1; 0 <= k; --k )
+    {
+      for ( int j = k + 1; j < n; ++j ) b[ k ] -= H[ j * r + k ] * b[ j ];
+      b[ k ] /= H[ k * r + k ];
+    }
+  }
+
+  // A pattern, sorted, with the diagonal added.
+  void full_( int m, const int *ind, const int *col )
+  {
+    pind_.assign( 1, 0 );
+    pcol_.clear();
+    for ( int i = 0; i < m; ++i )
+    {
+      int beg = pcol_.size();
+
+      for ( int k = ind[ i ]; k < ind[ i + 1 ]; ++k )
+        if ( 0 <= col[ k ] && col[ k ] < m ) pcol_.push_back( col[ k ] );
+      pcol_.push_back( i );
+      std::sort( pcol_.begin() + beg, pcol_.end() );
+      pcol_.erase( std::unique( pcol_.begin() + beg, pcol_.end() ), pcol_.end() );
+      pind_.push_back( pcol_.size() );
+    }
+  }
+
+protected:
+  void forward_( vector< Range >& x ) const
+  {
+    w_ = M_ * x;
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < x.m(); ++i ) x( i ) = w_( i );
+  }
+  void backward_( vector< Range >& x ) const {}
+  void forwardInv_( vector< Range >& x ) const {} // M is not formed.
+  void backwardInv_( vector< Range >& x ) const {}
+  void apply_( const vector< Range >& in, vector< Range >& out ) const
+  {
+    if ( out.m() != in.m() ) out.setup( in.m() );
+    out = M_ * in;
+  }
+
+public:
+  spai( const matrix< Range >& A )
+    : preconditioner< Range >( A ), pind_(), pcol_(), M_(), w_( A.m() )
+  {
+    full_( A.m(), A.ind(), A.col() );
+  }
+
+  // Takes the pattern from an adjacency, e.g. of clique::fill( lv );
+  // the columns out of [ 0, m ) are ignored.
+  void pattern( int m, const int *xadj, const int *adjy )
+  {
+    assert( m == preconditioner< Range >::A_.m() );
+    full_( m, xadj, adjy );
+  }
+
+  void factor()
+  {
+    const matrix< Range >& A = preconditioner< Range >::A_;
+    const int m = A.m(), nnz = pcol_.size();
+    Range *val = new Range[ nnz ];
+
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel
+#endif
+    {
+      std::vector< int > pos( m, -1 ), I;
+      std::vector< Range > H, b;
+
+#ifdef ELAI_USE_OPENMP
+      #pragma omp for schedule( dynamic, 64 )
+#endif
+      for ( int i = 0; i < m; ++i )
+      {
+        const int beg = pind_[ i ], n = pind_[ i + 1 ] - beg;
+        int r;
+
+        // I: the columns of the rows J of A, and i itself.
+        I.clear();
+        pos[ i ] = 0;
+        I.push_back( i );
+        for ( int c = 0; c < n; ++c )
+        {
+          int j = pcol_[ beg + c ];
+
+          for ( int k = A.ind( j ); k < A.ind( j + 1 ); ++k )
+            if ( A.col( k ) < m && pos[ A.col( k ) ] < 0 )
+            {
+              pos[ A.col( k ) ] = I.size();
+              I.push_back( A.col( k ) );
+            }
+        }
+        r = std::max( static_cast< int >( I.size() ), n );
+
+        // H( :, c ) = A( J[ c ], I )^T and b = e_i.
+        H.assign( r * n, static_cast< Range >( 0 ) );
+        b.assign( r, static_cast< Range >( 0 ) );
+        b[ 0 ] = static_cast< Range >( 1 );
+        for ( int c = 0; c < n; ++c )
+        {
+          int j = pcol_[ beg + c ];
+
+          for ( int k = A.ind( j ); k < A.ind( j + 1 ); ++k )
+            if ( A.col( k ) < m ) H[ c * r + pos[ A.col( k ) ] ] = A.val( k );
+        }
+        for ( unsigned int a = 0; a < I.size(); ++a ) pos[ I[ a ] ] = -1;
+
+        lsq_( r, n, H, b );
+        for ( int c = 0; c < n; ++c ) val[ beg + c ] = b[ c ];
+      }
+    }
+    M_.setup( m, m, nnz, &pind_[ 0 ], &pcol_[ 0 ], val );
+    delete [] val;
+  }
+
+  // Entries of M.
+  int nnz() const { return pcol_.size(); }
+
+  size_t mem() const
+  {
+    return M_.mem() + sizeof( int ) * ( pind_.size() + pcol_.size() ) + w_.mem();
+  }
+};
+
+}
+
+#endif//__ELAI_SPAI__
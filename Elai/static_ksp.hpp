@@ -0,0 +1,515 @@
+/*
+ *
+ * Elastic Linear Algebra Interface (ELAI)
+ *
+ * Copyright 2013-2015 H. KOSHIMOTO, AIST
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __ELAI_STATIC_KSP__
+#define __ELAI_STATIC_KSP__
+
+#include <cmath>
+#include <iostream>
+#include <set>
+#include "def.hpp"
+#include "coherence.hpp"
+#include "expression.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "blas.hpp"
+
+namespace elai
+{
+
+// Solvers dispatched at compile time, as an alternative to ksp. They are
+// parameterized on the operator and the preconditioner:
+//   Operator: int m() const;
+//             void apply( const vector< Coef >& x, vector< Coef >& y ) const; // y = A x
+//   Prec:     void apply( const vector< Coef >& in, vector< Coef >& out ) const; // out = M^-1 in
+// Any preconditioner< Coef > is a Prec through its virtual interface, while
+// the light types below are inlined and fused with the neighbouring
+// products and updates.
+
+template< class Coef >
+class matrix_operator
+{
+  const matrix< Coef >& A_;
+
+public:
+  explicit matrix_operator( const matrix< Coef >& A ) : A_( A ) {}
+
+  int m() const { return A_.m(); }
+  const matrix< Coef >& mat() const { return A_; }
+  void apply( const vector< Coef >& x, vector< Coef >& y ) const { y = A_ * x; }
+};
+
+template< class Coef >
+class identity_conditioner
+{
+public:
+  void apply( const vector< Coef >& in, vector< Coef >& out ) const
+  {
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < in.m(); ++i ) out( i ) = in( i );
+  }
+};
+
+// Point Jacobi with the inverse diagonal kept.
+template< class Coef >
+class diagonal_conditioner
+{
+  vector< Coef > d_;
+
+public:
+  explicit diagonal_conditioner( const matrix< Coef >& A ) : d_( A.m() ) { factor( A ); }
+
+  void factor( const matrix< Coef >& A )
+  {
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < A.m(); ++i )
+    {
+      d_( i ) = static_cast< Coef >( 1. );
+      for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k )
+        if ( A.col( k ) == i && A.val( k ) != static_cast< Coef >( 0. ) ) d_( i ) = static_cast< Coef >( 1. ) / A.val( k );
+    }
+  }
+
+  Coef d( int i ) const { return d_( i ); }
+  void apply( const vector< Coef >& in, vector< Coef >& out ) const
+  {
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < in.m(); ++i ) out( i ) = d_( i ) * in( i );
+  }
+};
+
+// Settings, convergence and reductions shared by the solvers below.
+template< class Coef >
+class static_ksp
+{
+protected:
+  const vector< Coef >& b_;
+  int iter_max_;
+  Coef athres_, rthres_;
+  int n_; // The leading rows in the products.
+#ifdef ELAI_USE_MPI
+  coherence *coherent_;
+  mutable std::set< void * > bases_; // exchanged, released with the solver
+#endif
+
+  void sync_( vector< Coef >& u ) const
+  {
+#ifdef ELAI_USE_MPI
+    if ( coherent_ == NULL ) return;
+    bases_.insert( u.val() );
+    ( *coherent_ )( u.val() );
+#else
+    ( void )u;
+#endif
+  }
+
+  // Sums k values over the ranks.
+  void reduce_( Coef *buf, int k ) const
+  {
+#ifdef ELAI_USE_MPI
+    if ( coherent_ != NULL ) coherent_->allreduce( buf, k, mpi_< Coef >().type );
+#else
+    ( void )buf;
+    ( void )k;
+#endif
+  }
+
+  Coef dot_( const vector< Coef >& u, const vector< Coef >& v ) const
+  {
+    Coef acc = static_cast< Coef >( 0. );
+
+#ifdef ELAI_USE_MPI
+    if ( coherent_ != NULL ) return coherent_->prod( u.val(), v.val(), u.m() );
+#endif
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for reduction( +:acc )
+#endif
+    for ( int i = 0; i < u.m(); ++i ) acc += u( i ) * v( i );
+
+    return acc;
+  }
+
+  // The criteria of ksp.
+  bool converged_( Coef res, Coef res0, Coef norm ) const
+  {
+    if ( fabs( res / res0 ) <= rthres_ || fabs( res ) <= athres_ ) return true;
+
+    return static_cast< Coef >( 1e-50 ) < fabs( norm ) && fabs( res / norm ) <= rthres_;
+  }
+
+  // q = A p and the local part of p^t q.
+  template< class Operator >
+  Coef apply_dot_( const Operator& A, const vector< Coef >& p, vector< Coef >& q ) const
+  {
+    A.apply( p, q );
+    sync_( q );
+
+    return dot_( p, q );
+  }
+  // Fused for a matrix: one pass over the rows.
+  Coef apply_dot_( const matrix_operator< Coef >& op, const vector< Coef >& p, vector< Coef >& q ) const
+  {
+    const matrix< Coef >& A = op.mat();
+    const int m = A.m(), n = n_;
+    Coef acc = static_cast< Coef >( 0. );
+
+    if ( n < 0 ) return apply_dot_< matrix_operator< Coef > >( op, p, q );
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for reduction( +:acc )
+#endif
+    for ( int i = 0; i < m; ++i )
+    {
+      Coef v = static_cast< Coef >( 0. );
+
+      for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k ) v += A.val( k ) * p( A.col( k ) );
+      q( i ) = v;
+      if ( i < n ) acc += p( i ) * v;
+    }
+    sync_( q );
+
+    return acc;
+  }
+
+  // x += alpha p, r -= alpha q, z = M^-1 r and the local parts of
+  // ( r^t r, r^t z, x^t x ) in s.
+  template< class Prec >
+  void update_
+    ( const Prec& P, Coef alpha
+    , vector< Coef >& x, vector< Coef >& r, vector< Coef >& z
+    , const vector< Coef >& p, const vector< Coef >& q, Coef *s
+    ) const
+  {
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < x.m(); ++i )
+    {
+      x( i ) += alpha * p( i );
+      r( i ) -= alpha * q( i );
+    }
+    P.apply( r, z );
+    sync_( z );
+    s[ 0 ] = dot_( r, r );
+    s[ 1 ] = dot_( r, z );
+    s[ 2 ] = dot_( x, x );
+  }
+  // Fused for a diagonal: one pass over the vectors.
+  void update_
+    ( const diagonal_conditioner< Coef >& P, Coef alpha
+    , vector< Coef >& x, vector< Coef >& r, vector< Coef >& z
+    , const vector< Coef >& p, const vector< Coef >& q, Coef *s
+    ) const
+  {
+    const int n = n_;
+    Coef rr = static_cast< Coef >( 0. ), rz = static_cast< Coef >( 0. ), xx = static_cast< Coef >( 0. );
+
+    if ( n < 0 ) { update_< diagonal_conditioner< Coef > >( P, alpha, x, r, z, p, q, s ); return; }
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for reduction( +:rr, rz, xx )
+#endif
+    for ( int i = 0; i < x.m(); ++i )
+    {
+      x( i ) += alpha * p( i );
+      r( i ) -= alpha * q( i );
+      z( i ) = P.d( i ) * r( i );
+      if ( i < n )
+      {
+        rr += r( i ) * r( i );
+        rz += r( i ) * z( i );
+        xx += x( i ) * x( i );
+      }
+    }
+    sync_( z );
+    s[ 0 ] = rr;
+    s[ 1 ] = rz;
+    s[ 2 ] = xx;
+  }
+
+public:
+  static_ksp
+    ( const vector< Coef >& b
+#ifdef ELAI_USE_MPI
+    , coherence *coherent = NULL
+#endif
+    )
+    : b_( b ), iter_max_( b.m() / 2 )
+    , athres_( static_cast< Coef >( 1e-30 ) ), rthres_( static_cast< Coef >( 1e-12 ) )
+    , n_( b.m() )
+#ifdef ELAI_USE_MPI
+    , coherent_( coherent ), bases_()
+#endif
+  {
+#ifdef ELAI_USE_MPI
+    // Without ghost-last numbering, the products go through coherence.
+    if ( coherent_ != NULL ) n_ = coherent_->owned();
+#endif
+  }
+  ~static_ksp()
+  {
+#ifdef ELAI_USE_MPI
+    for ( std::set< void * >::iterator it = bases_.begin(); it != bases_.end(); ++it )
+      coherent_->release( *it );
+#endif
+  }
+
+  int iter_max() const { return iter_max_; }
+  int iter_max( int max )
+  {
+    int old = iter_max_;
+
+    iter_max_ = max;
+
+    return old;
+  }
+
+  Coef abs_thres() const { return athres_; }
+  Coef abs_thres( Coef thres )
+  {
+    Coef old = athres_;
+
+    athres_ = thres;
+
+    return old;
+  }
+
+  Coef rel_thres() const { return rthres_; }
+  Coef rel_thres( Coef thres )
+  {
+    Coef old = rthres_;
+
+    rthres_ = thres;
+
+    return old;
+  }
+};
+
+template< class Coef, class Operator, class Prec >
+class static_cg : public static_ksp< Coef >
+{
+  typedef static_ksp< Coef > Base;
+
+  const Operator& A_;
+  const Prec& P_;
+  // WORKSPACE
+  vector< Coef > p_, q_, r_, z_;
+
+public:
+  static_cg
+    ( const Operator& A
+    , const vector< Coef >& b
+    , const Prec& P
+#ifdef ELAI_USE_MPI
+    , coherence *coherent = NULL
+#endif
+    )
+    : Base
+      ( b
+#ifdef ELAI_USE_MPI
+      , coherent
+#endif
+      )
+    , A_( A ), P_( P ), p_( A.m() ), q_( A.m() ), r_( A.m() ), z_( A.m() )
+  {}
+
+  bool solve( vector< Coef >& x )
+  {
+    const int m = A_.m();
+    Coef s[ 3 ], res, res0, rho, rho0;
+
+    A_.apply( x, q_ );
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < m; ++i ) r_( i ) = Base::b_( i ) - q_( i );
+    Base::sync_( r_ );
+    P_.apply( r_, z_ );
+    Base::sync_( z_ );
+    s[ 0 ] = Base::dot_( r_, r_ );
+    s[ 1 ] = Base::dot_( r_, z_ );
+    s[ 2 ] = Base::dot_( x, x );
+    Base::reduce_( s, 3 );
+    res = res0 = sqrt( s[ 0 ] );
+    rho = s[ 1 ];
+    rho0 = static_cast< Coef >( 1. );
+    p_ = static_cast< Coef >( 0. );
+    if ( res0 <= static_cast< Coef >( 1e-50 ) ) return true;
+
+    for ( int i = 0; i < Base::iter_max_; ++i )
+    {
+      Coef alpha, beta, pq;
+
+#ifdef ELAI_DEBUG
+      std::cerr << " ||x||=" << s[ 2 ]
+                << " ||Ax-b||=" << res
+                << "  " << res / res0 << std::endl;
+#endif
+      if ( std::isnan( res ) ) return false;
+      if ( Base::converged_( res, res0, s[ 2 ] ) ) return true;
+
+      beta = rho / rho0;
+      rho0 = rho;
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for ( int k = 0; k < m; ++k ) p_( k ) = z_( k ) + beta * p_( k );
+
+      pq = Base::apply_dot_( A_, p_, q_ );
+      Base::reduce_( &pq, 1 );
+      alpha = rho / pq;
+
+      // r^t r, r^t z and x^t x in one reduction.
+      Base::update_( P_, alpha, x, r_, z_, p_, q_, s );
+      Base::reduce_( s, 3 );
+      res = sqrt( s[ 0 ] );
+      rho = s[ 1 ];
+    }
+
+    return false;
+  }
+
+  size_t mem() const
+  {
+    return p_.mem() + q_.mem() + r_.mem() + z_.mem();
+  }
+};
+
+// Right-preconditioned BiCGStab.
+template< class Coef, class Operator, class Prec >
+class static_bicgstab : public static_ksp< Coef >
+{
+  typedef static_ksp< Coef > Base;
+
+  const Operator& A_;
+  const Prec& P_;
+  // WORKSPACE
+  vector< Coef > p_, ph_, r_, r0_, s_, sh_, t_, v_;
+
+public:
+  static_bicgstab
+    ( const Operator& A
+    , const vector< Coef >& b
+    , const Prec& P
+#ifdef ELAI_USE_MPI
+    , coherence *coherent = NULL
+#endif
+    )
+    : Base
+      ( b
+#ifdef ELAI_USE_MPI
+      , coherent
+#endif
+      )
+    , A_( A ), P_( P ), p_( A.m() ), ph_( A.m() ), r_( A.m() ), r0_( A.m() )
+    , s_( A.m() ), sh_( A.m() ), t_( A.m() ), v_( A.m() )
+  {}
+
+  bool solve( vector< Coef >& x )
+  {
+    const int m = A_.m();
+    Coef s[ 3 ], res, res0, rho, alpha, omega;
+
+    A_.apply( x, v_ );
+#ifdef ELAI_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for ( int i = 0; i < m; ++i ) r0_( i ) = r_( i ) = Base::b_( i ) - v_( i );
+    Base::sync_( r_ );
+    Base::sync_( r0_ );
+    s[ 0 ] = Base::dot_( r_, r_ );
+    s[ 1 ] = Base::dot_( x, x );
+    Base::reduce_( s, 2 );
+    res = res0 = sqrt( s[ 0 ] );
+    rho = alpha = omega = static_cast< Coef >( 1. );
+    p_ = static_cast< Coef >( 0. );
+    v_ = static_cast< Coef >( 0. );
+    if ( res0 <= static_cast< Coef >( 1e-50 ) ) return true;
+
+    for ( int i = 0; i < Base::iter_max_; ++i )
+    {
+      Coef rho1, beta;
+
+#ifdef ELAI_DEBUG
+      std::cerr << " ||x||=" << s[ 1 ]
+                << " ||Ax-b||=" << res
+                << "  " << res / res0 << std::endl;
+#endif
+      if ( std::isnan( res ) ) return false;
+      if ( Base::converged_( res, res0, s[ 1 ] ) ) return true;
+
+      rho1 = Base::dot_( r0_, r_ );
+      Base::reduce_( &rho1, 1 );
+      beta = ( rho1 / rho ) * ( alpha / omega );
+      rho = rho1;
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for ( int k = 0; k < m; ++k ) p_( k ) = r_( k ) + beta * ( p_( k ) - omega * v_( k ) );
+
+      P_.apply( p_, ph_ );
+      Base::sync_( ph_ );
+      A_.apply( ph_, v_ );
+      Base::sync_( v_ );
+      s[ 0 ] = Base::dot_( r0_, v_ );
+      Base::reduce_( s, 1 );
+      alpha = rho / s[ 0 ];
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for ( int k = 0; k < m; ++k ) s_( k ) = r_( k ) - alpha * v_( k );
+
+      P_.apply( s_, sh_ );
+      Base::sync_( sh_ );
+      A_.apply( sh_, t_ );
+      Base::sync_( t_ );
+      s[ 0 ] = Base::dot_( t_, s_ );
+      s[ 1 ] = Base::dot_( t_, t_ );
+      Base::reduce_( s, 2 );
+      omega = s[ 0 ] / s[ 1 ];
+#ifdef ELAI_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for ( int k = 0; k < m; ++k )
+      {
+        x( k ) += alpha * ph_( k ) + omega * sh_( k );
+        r_( k ) = s_( k ) - omega * t_( k );
+      }
+      s[ 0 ] = Base::dot_( r_, r_ );
+      s[ 1 ] = Base::dot_( x, x );
+      Base::reduce_( s, 2 );
+      res = sqrt( s[ 0 ] );
+    }
+
+    return false;
+  }
+
+  size_t mem() const
+  {
+    return p_.mem() + ph_.mem() + r_.mem() + r0_.mem() + s_.mem() + sh_.mem() + t_.mem() + v_.mem();
+  }
+};
+
+}
+
+#endif//__ELAI_STATIC_KSP__
@@ -25,7 +25,10 @@
 #include "family.hpp"
 
 #ifdef ELAI_USE_MPI
+#include <map>
+#include <vector>
 #include "mpi.h"
+#include "exchange.hpp"
 #endif
 
 namespace elai
@@ -80,139 +83,77 @@ private:
 #ifdef ELAI_USE_MPI
   void marginal_setup()
   {
-    int myrank;
-    MPI_Comm_rank( intra_, &myrank ); // LOCAL RANK
+    typedef typename Element::id_type id_type;
+    typedef std::map< int, std::vector< id_type > > Request;
 
-    if ( myrank == 0 )
-    { // Inter Communicator is available only for leaders.
-      int mysize, myrid;
-      MPI_Comm_size( inter_, &mysize ); // LEADER SIZE == NUMBER of REGIONS
-      MPI_Comm_rank( inter_, &myrid );
+    int myrank, cnt = 0;
+    Request ask;
 
-      int MNN[ mysize ][ mysize ];
+    // External elements by their regions; every rank in the region has
+    // the same base, hence the same order.
+    for ( typename Space::const_marginal_iterator it = base_.internal_begin()
+        ; it != base_.internal_end(); ++it
+        ) ask[ Marginal( it ).external.color() ].push_back( Marginal( it ).external() );
+    for ( typename Request::const_iterator it = ask.begin(); it != ask.end(); ++it )
+      cnt += it->second.size();
 
-      for ( int i = 0; i < mysize; ++i ) MNN[ myrid ][ i ] = 0;
-      for ( typename Space::const_marginal_iterator it = base_.internal_begin()
-          ; it != base_.internal_end(); ++it
-          ) MNN[ myrid ][ Marginal( it ).external.color() ] += 1;
-      MPI_Allgather( MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, MNN, mysize, MPI_INT, inter_ );
+    std::vector< int > cols( cnt );
 
-      // FOR SEND EXTERNAL ELEMENTS
-      int cnt_send_regs = 0;
-      int cnt_send_elms = 0;
-      for ( int i = 0; i < mysize; ++i )
-      {
-        if ( MNN[ myrid ][ i ] <= 0 ) continue;
-        cnt_send_regs += 1;
-        cnt_send_elms += MNN[ myrid ][ i ];
-      }
-      int send_regs[ cnt_send_regs ];
-      int send_nums[ cnt_send_regs ];
-      typename Element::id_type send_elms[ cnt_send_elms ];
-      for ( int i = 0, j = 0, k = 0, off = 0; i < mysize; ++i )
-      {
-        if ( MNN[ myrid ][ i ] <= 0 ) continue;
-        send_regs[ j ] = i;
-        send_nums[ j ] = MNN[ myrid ][ i ];
-        for ( typename Space::const_marginal_iterator it = base_.internal_begin()
-            ; it != base_.internal_end(); ++it
-            )
-        {
-          if ( i != Marginal( it ).external.color() ) continue;
-          send_elms[ off + k ] = Marginal( it ).external();
-          ++k;
-        }
-        off += MNN[ myrid ][ i ];
-        k = 0;
-        ++j;
-      }
+    MPI_Comm_rank( intra_, &myrank ); // LOCAL RANK
+    if ( myrank == 0 )
+    { // Inter Communicator is available only for leaders.
+      int myrid;
+      Request asked;
 
-      // FOR RECV INTERNAL ELEMENTS
-      int cnt_recv_regs = 0;
-      int cnt_recv_elms = 0;
-      for ( int j = 0; j < mysize; ++j )
-      {
-        if ( MNN[ j ][ myrid ] <= 0 ) continue;
-        cnt_recv_regs += 1;
-        cnt_recv_elms += MNN[ j ][ myrid ];
-      }
-      int recv_regs[ cnt_recv_regs ];
-      int recv_nums[ cnt_recv_regs ];
-      typename Element::id_type recv_elms[ cnt_recv_elms ];
-      MPI_Request recv_req[ cnt_recv_regs ];
-      for ( int i = 0, j = 0; i < mysize; ++i )
-      {
-        if ( MNN[ i ][ myrid ] <= 0 ) continue;
-        recv_regs[ j ] = i;
-        recv_nums[ j ] = MNN[ i ][ myrid ];
-        ++j;
-      }
+      MPI_Comm_rank( inter_, &myrid );
 
       // SEND EXTERNAL ELEMENTS & RECV INTERNAL ELEMENTS
-      for ( int i = 0, off = 0; i < cnt_recv_regs; ++i )
-      {
-        MPI_Irecv
-          ( &recv_elms[ off ]
-          , recv_nums[ i ], mpi_< typename Element::id_type >().type
-          , recv_regs[ i ], myrid, inter_, &recv_req[ i ]
-          );
-        off += recv_nums[ i ];
-      }
-      for ( int i = 0, off = 0; i < cnt_send_regs; ++i )
-      {
-        MPI_Send
-          ( &send_elms[ off ]
-          , send_nums[ i ], mpi_< typename Element::id_type >().type
-          , send_regs[ i ], send_regs[ i ], inter_
-          );
-        off += send_nums[ i ];
-      }
-      if ( 0 < cnt_recv_regs ) MPI_Waitall( cnt_recv_regs, recv_req, MPI_STATUSES_IGNORE );
+      sparse_exchange( inter_, ask, asked );
 
       // FOR SEND INTERNAL COLORS
-      int send_cols[ cnt_recv_elms ];
-      for ( int i = 0, off = 0; i < cnt_recv_regs; ++i )
+      std::map< int, std::vector< int > > send_cols;
+      for ( typename Request::const_iterator it = asked.begin(); it != asked.end(); ++it )
       {
-        for ( int j = 0; j < recv_nums[ i ]; ++j )
-        {
-          send_cols[ off ] = color_[ base_.index( Element( recv_elms[ off ] ) ) ];
-          ++off;
-        }
-      }
+        std::vector< int >& col = send_cols[ it->first ];
 
-      // FOR RECV EXTERNAL COLORS
-      int recv_cols[ cnt_send_elms ];
-      MPI_Request send_req[ cnt_send_elms ];
+        for ( unsigned int j = 0; j < it->second.size(); ++j )
+          col.push_back( color_[ base_.index( Element( it->second[ j ] ) ) ] );
+      }
 
       // SEND INTERNAL COLORS & RECV EXTERNAL COLORS
-      for ( int i = 0, off = 0; i < cnt_send_regs; ++i )
+      std::vector< MPI_Request > req( ask.size() + asked.size() );
+      int k = 0, off = 0;
+
+      for ( typename Request::const_iterator it = ask.begin(); it != ask.end(); ++it, ++k )
       {
         MPI_Irecv
-          ( &recv_cols[ off ]
-          , send_nums[ i ], MPI_INT
-          , send_regs[ i ], myrid, inter_, &send_req[ i ]
+          ( &cols[ off ]
+          , it->second.size(), MPI_INT
+          , it->first, myrid, inter_, &req[ k ]
           );
-        off += send_nums[ i ];
+        off += it->second.size();
       }
-      for ( int i = 0, off = 0; i < cnt_recv_regs; ++i )
+      for ( std::map< int, std::vector< int > >::iterator it = send_cols.begin()
+          ; it != send_cols.end(); ++it, ++k
+          )
       {
-        MPI_Send
-          ( &send_cols[ off ]
-          , recv_nums[ i ], MPI_INT
-          , recv_regs[ i ], recv_regs[ i ], inter_
+        MPI_Isend
+          ( &it->second[ 0 ]
+          , it->second.size(), MPI_INT
+          , it->first, it->first, inter_, &req[ k ]
           );
-        off += recv_nums[ i ];
       }
-      if ( 0 < cnt_send_regs ) MPI_Waitall( cnt_send_regs, send_req, MPI_STATUSES_IGNORE );
-
-      // UPDATE COLORS
-      for ( int i = 0; i < cnt_send_elms; ++i )
-        color_[ base_.external_index( Element( send_elms[ i ] ) ) ] = recv_cols[ i ];
+      if ( 0 < k ) MPI_Waitall( k, &req[ 0 ], MPI_STATUSES_IGNORE );
     }
 
-    // SYNC COLORS IN THE REGION
-    MPI_Barrier( intra_ );
-    MPI_Bcast( color_, base_.size(), MPI_INT, 0, intra_ );
+    // SYNC ONLY MARGINAL COLORS IN THE REGION
+    if ( 0 < cnt ) MPI_Bcast( &cols[ 0 ], cnt, MPI_INT, 0, intra_ );
+
+    // UPDATE COLORS
+    cnt = 0;
+    for ( typename Request::const_iterator it = ask.begin(); it != ask.end(); ++it )
+      for ( unsigned int j = 0; j < it->second.size(); ++j )
+        color_[ base_.external_index( Element( it->second[ j ] ) ) ] = cols[ cnt++ ];
   }
 #endif
 
@@ -241,6 +182,7 @@ public:
   }
 
   int color( const Element& x ) const { return color_[ base_.index( x ) ]; }
+  const std::vector< int >& palette() const { return palette_; }
 
   Space operator()( int color )
   {
@@ -280,7 +222,9 @@ public:
       }
     }
 
-    return sub | margin;
+    Space local( sub | margin );
+
+    return local.renumber();
   }
 
   Family operator()( int color, const Space& sub )
@@ -20,6 +20,8 @@
 #ifndef __ELAI_SYNC__
 #define __ELAI_SYNC__
 
+#include <cstring>
+#include <iostream>
 #include "def.hpp"
 
 #ifdef ELAI_USE_MPI
@@ -35,15 +37,42 @@ class sync
   int cnt_;
   MPI_Datatype type_;
 
+  // Owner-based mode
+  int root_;
+  int *perm_;   // indices sorted by their owners
+  int *cnts_;   // owned counts of ranks
+  int *displs_; // offsets of ranks in perm_
+  char *buf_;
+  int bytes_;
+
+  void terminate()
+  {
+    if ( buf_ != NULL ) { delete [] buf_; buf_ = NULL; }
+    if ( displs_ != NULL ) { delete [] displs_; displs_ = NULL; }
+    if ( cnts_ != NULL ) { delete [] cnts_; cnts_ = NULL; }
+    if ( perm_ != NULL ) { delete [] perm_; perm_ = NULL; }
+  }
+
 public:
   template< class Target >
   sync( Target& obj, MPI_Comm comm )
     : comm_( comm ), ptr_( NULL ), cnt_( 0 ), type_()
+    , root_( -1 ), perm_( NULL ), cnts_( NULL ), displs_( NULL ), buf_( NULL ), bytes_( 0 )
   {
     obj.sync_setup( *this );
   }
+  // Each rank contributes only the elements it owns, given by the coloring
+  // of subj; they are gathered to all ranks, or to root only if 0 <= root.
+  template< class Target, class Subjugator >
+  sync( Target& obj, const Subjugator& subj, MPI_Comm comm, int root = -1 )
+    : comm_( comm ), ptr_( NULL ), cnt_( 0 ), type_()
+    , root_( root ), perm_( NULL ), cnts_( NULL ), displs_( NULL ), buf_( NULL ), bytes_( 0 )
+  {
+    obj.sync_setup( *this, subj );
+  }
   ~sync()
   {
+    terminate();
   }
 
   void setup( void *ptr, int cnt, MPI_Datatype type )
@@ -53,9 +82,72 @@ public:
     type_ = type;
   }
 
+  // owner[ i ] is the rank owning the i-th element, or -1 if none. Aborts
+  // if an owner is not in the communicator.
+  void setup( void *ptr, int cnt, MPI_Datatype type, const int *owner )
+  {
+    int size;
+
+    setup( ptr, cnt, type );
+    terminate();
+    MPI_Comm_size( comm_, &size );
+    MPI_Type_size( type_, &bytes_ );
+
+    for ( int i = 0; i < cnt; ++i )
+      if ( size <= owner[ i ] )
+      {
+        std::cerr << "THE OWNER " << owner[ i ] << " OF THE ELEMENT " << i
+                  << " IS NOT IN THE COMMUNICATOR OF " << size << " RANKS." << std::endl;
+        MPI_Abort( comm_, 1 );
+      }
+
+    cnts_ = new int[ size ];
+    displs_ = new int[ size ];
+    for ( int r = 0; r < size; ++r ) cnts_[ r ] = 0;
+    for ( int i = 0; i < cnt_; ++i ) if ( 0 <= owner[ i ] ) cnts_[ owner[ i ] ] += 1;
+    displs_[ 0 ] = 0;
+    for ( int r = 1; r < size; ++r ) displs_[ r ] = displs_[ r - 1 ] + cnts_[ r - 1 ];
+
+    int n = displs_[ size - 1 ] + cnts_[ size - 1 ];
+    int *off = new int[ size ];
+
+    perm_ = new int[ n ];
+    for ( int r = 0; r < size; ++r ) off[ r ] = displs_[ r ];
+    for ( int i = 0; i < cnt_; ++i ) if ( 0 <= owner[ i ] ) perm_[ off[ owner[ i ] ]++ ] = i;
+    buf_ = new char[ static_cast< size_t >( bytes_ ) * n ];
+
+    delete [] off;
+  }
+
   void operator()()
   {
-    MPI_Allreduce( MPI_IN_PLACE, ptr_, cnt_, type_, MPI_SUM, comm_ );
+    if ( perm_ == NULL )
+    {
+      MPI_Allreduce( MPI_IN_PLACE, ptr_, cnt_, type_, MPI_SUM, comm_ );
+      return;
+    }
+
+    int rank, size;
+    char *base = static_cast< char * >( ptr_ );
+
+    MPI_Comm_rank( comm_, &rank );
+    MPI_Comm_size( comm_, &size );
+
+    int n = displs_[ size - 1 ] + cnts_[ size - 1 ];
+    char *own = buf_ + static_cast< size_t >( bytes_ ) * displs_[ rank ];
+
+    for ( int l = displs_[ rank ]; l < displs_[ rank ] + cnts_[ rank ]; ++l )
+      std::memcpy( buf_ + static_cast< size_t >( bytes_ ) * l, base + static_cast< size_t >( bytes_ ) * perm_[ l ], bytes_ );
+    if ( root_ < 0 )
+      MPI_Allgatherv( MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, buf_, cnts_, displs_, type_, comm_ );
+    else
+      MPI_Gatherv
+        ( rank == root_ ? MPI_IN_PLACE : own, cnts_[ rank ], type_
+        , buf_, cnts_, displs_, type_, root_, comm_
+        );
+    if ( 0 <= root_ && rank != root_ ) return;
+    for ( int l = 0; l < n; ++l )
+      std::memcpy( base + static_cast< size_t >( bytes_ ) * perm_[ l ], buf_ + static_cast< size_t >( bytes_ ) * l, bytes_ );
   }
 };
 
@@ -27,6 +27,10 @@ extern "C"
 #include <sys/time.h>
 }
 
+#ifdef ELAI_USE_OPENMP
+#include <omp.h>
+#endif
+
 #ifdef ELAI_DEBUG
 
 #define ELAI_CHECK( stmt )
@@ -83,6 +87,41 @@ public:
   }
 };
 
+// Sets the number of threads while the scope lives; n <= 0 keeps it as is.
+#ifdef ELAI_USE_OPENMP
+// The most threads for the kernels, or <= 0 for no limit; mpi_init sets
+// it to 1 without the thread support of MPI.
+inline int& thread_limit()
+{
+  static int limit = 0;
+
+  return limit;
+}
+#endif
+
+class thread_scope
+{
+#ifdef ELAI_USE_OPENMP
+  int old_;
+#endif
+
+public:
+  thread_scope( int n )
+#ifdef ELAI_USE_OPENMP
+    : old_( omp_get_max_threads() )
+  {
+    if ( 0 < thread_limit() && ( n <= 0 || thread_limit() < n ) ) n = thread_limit();
+    if ( 0 < n ) omp_set_num_threads( n );
+  }
+  ~thread_scope() { omp_set_num_threads( old_ ); }
+#else
+  {
+    ( void )n;
+  }
+  ~thread_scope() {}
+#endif
+};
+
 }
 
 #endif//__ELAI_UTIL__
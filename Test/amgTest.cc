@@ -0,0 +1,129 @@
+#include <iostream>
+#include <map>
+#include <vector>
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "amg.hpp"
+#include "cg.hpp"
+
+using namespace std;
+
+typedef elai::vector< double > Vector;
+typedef elai::matrix< double > Matrix;
+typedef elai::amg< double > AMG;
+typedef elai::cg< double > CG;
+
+// 5-point Laplacian on an nx x nx grid, in the natural or the red-black
+// order; both have the same rows and nonzeros but not the same pattern.
+Matrix grid( int nx, bool redblack = false )
+{
+  const int n = nx * nx;
+  vector< int > p( n ), ind( n + 1 ), col;
+  vector< double > c;
+  vector< map< int, double > > row( n );
+
+  for ( int i = 0; i < n; ++i ) p[ i ] = redblack ? ( i % 2 == 0 ? i / 2 : ( n + 1 ) / 2 + i / 2 ) : i;
+  for ( int i = 0; i < n; ++i )
+  {
+    int x = i % nx, y = i / nx;
+    map< int, double >& r = row[ p[ i ] ];
+
+    if ( 0 < y ) r[ p[ i - nx ] ] = -1.;
+    if ( 0 < x ) r[ p[ i - 1 ] ] = -1.;
+    r[ p[ i ] ] = 4.;
+    if ( x < nx - 1 ) r[ p[ i + 1 ] ] = -1.;
+    if ( y < nx - 1 ) r[ p[ i + nx ] ] = -1.;
+  }
+  ind[ 0 ] = 0;
+  for ( int i = 0; i < n; ++i )
+  {
+    for ( map< int, double >::iterator it = row[ i ].begin(); it != row[ i ].end(); ++it )
+    {
+      col.push_back( it->first );
+      c.push_back( it->second );
+    }
+    ind[ i + 1 ] = col.size();
+  }
+
+  return Matrix( n, n, col.size(), &ind[ 0 ], &col[ 0 ], &c[ 0 ] );
+}
+
+double residual( const Matrix& A, const Vector& x, const Vector& b )
+{
+  Vector r( b - A * x );
+  double res = r * r;
+
+  return res;
+}
+
+int main()
+{
+  using namespace elai;
+
+  // 5-point Laplacian on a 32x32 grid
+  Matrix A( grid( 32 ) );
+  Vector x( A.m() ), b( A.m() );
+  bool flg = true;
+
+  b = 1.;
+
+  {
+    AMG prec( A, AMG::CHEBYSHEV );
+    CG solver( A, b, &prec );
+
+    prec.factor();
+    cout << "levels=" << prec.levels() << " rows=";
+    for ( int l = 0; l < prec.levels(); ++l ) cout << prec.rows( l ) << " ";
+    cout << "complexity=" << prec.complexity() << endl;
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "AMG Chebyshev " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+
+    // The same pattern keeps the aggregates.
+    for ( int k = 0; k < A.nnz(); ++k ) A.val()[ k ] *= 2.;
+    prec.factor();
+    x = 0.;
+    ok = solver.solve( x );
+    flg = flg && ok;
+    cout << "AMG Chebyshev 2A " << ( ok ? "Solved" : "Diverged" )
+         << " ||2Ax-b||^2=" << residual( A, x, b ) << endl;
+    for ( int k = 0; k < A.nnz(); ++k ) A.val()[ k ] *= .5;
+  }
+  {
+    AMG prec( A, AMG::L1_JACOBI );
+    CG solver( A, b, &prec );
+
+    prec.factor();
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "AMG l1-Jacobi " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+  }
+  {
+    // Another pattern of as many nonzeros rebuilds the hierarchy as anew.
+    Matrix C( A );
+    AMG prec( C, AMG::CHEBYSHEV );
+
+    prec.factor();
+    C = grid( 32, true );
+    prec.factor();
+
+    AMG fresh( C, AMG::CHEBYSHEV );
+    bool ok;
+
+    fresh.factor();
+    ok = prec.levels() == fresh.levels() && prec.complexity() == fresh.complexity();
+    for ( int l = 0; ok && l < prec.levels(); ++l ) ok = prec.rows( l ) == fresh.rows( l );
+    flg = flg && ok;
+    cout << "AMG new pattern " << ( ok ? "OK" : "NG" ) << endl;
+  }
+
+  return flg ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <vector>
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "jacobi_conditioner.hpp"
+#include "block_jacobi_conditioner.hpp"
+#include "cg.hpp"
+
+using namespace std;
+
+typedef elai::vector< double > Vector;
+typedef elai::matrix< double > Matrix;
+typedef elai::preconditioner< double > Prec;
+typedef elai::jacobi_conditioner< double > JacobiP;
+typedef elai::block_jacobi_conditioner< double > BlockJacobiP;
+typedef elai::cg< double > CG;
+
+double residual( const Matrix& A, const Vector& x, const Vector& b )
+{
+  Vector r( b - A * x );
+  double res = r * r;
+
+  return res;
+}
+
+bool run( const char *name, const Matrix& A, const Vector& b, const Prec& prec )
+{
+  CG solver( A, b, &prec );
+  Vector x( A.m() );
+
+  x = 0.;
+
+  bool flg = solver.solve( x );
+
+  cout << name << " " << ( flg ? "Solved" : "Diverged" )
+       << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+
+  return flg;
+}
+
+int main()
+{
+  using namespace elai;
+
+  // 3 unknowns coupled in each node of a 16x16 grid
+  const int nx = 16, n = nx * nx, dof = 3;
+  const double B[ dof ][ dof ] = { { 8., 2., 1. }, { 2., 8., 2. }, { 1., 2., 8. } };
+  std::vector< int > ind( n * dof + 1 ), col, node;
+  std::vector< double > c;
+
+  ind[ 0 ] = 0;
+  for ( int p = 0; p < n; ++p )
+  {
+    int x = p % nx, y = p / nx;
+
+    for ( int d = 0; d < dof; ++d )
+    {
+      int i = p * dof + d;
+
+      if ( 0 < y ) { col.push_back( i - nx * dof ); c.push_back( -1. ); }
+      if ( 0 < x ) { col.push_back( i - dof ); c.push_back( -1. ); }
+      for ( int e = 0; e < dof; ++e ) { col.push_back( p * dof + e ); c.push_back( B[ d ][ e ] ); }
+      if ( x < nx - 1 ) { col.push_back( i + dof ); c.push_back( -1. ); }
+      if ( y < nx - 1 ) { col.push_back( i + nx * dof ); c.push_back( -1. ); }
+      ind[ i + 1 ] = col.size();
+      node.push_back( p );
+    }
+  }
+
+  Matrix A( n * dof, n * dof, col.size(), &ind[ 0 ], &col[ 0 ], &c[ 0 ] );
+  Vector b( A.m() );
+  bool flg = true;
+
+  b = 1.;
+
+  {
+    JacobiP prec( A );
+
+    flg = run( "Jacobi", A, b, prec ) && flg;
+  }
+  {
+    BlockJacobiP prec( A, dof );
+
+    prec.factor();
+    cout << "blocks=" << prec.blocks() << endl;
+    flg = run( "BlockJacobi( 3 )", A, b, prec ) && flg;
+  }
+  {
+    BlockJacobiP prec( A, node );
+
+    prec.factor();
+    cout << "blocks=" << prec.blocks() << endl;
+    flg = run( "BlockJacobi( node )", A, b, prec ) && flg;
+  }
+  {
+    BlockJacobiP prec( A, 5 );
+
+    prec.factor();
+    cout << "blocks=" << prec.blocks() << endl;
+    flg = run( "BlockJacobi( 5 )", A, b, prec ) && flg;
+  }
+  // bs < 1 is taken as 1, i.e. point Jacobi.
+  {
+    BlockJacobiP prec( A, 0 );
+
+    prec.factor();
+    cout << "blocks=" << prec.blocks() << endl;
+    flg = run( "BlockJacobi( 0 )", A, b, prec ) && prec.blocks() == A.m() && flg;
+  }
+
+  return flg ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <vector>
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "chebyshev_conditioner.hpp"
+#include "cg.hpp"
+
+using namespace std;
+
+typedef elai::vector< double > Vector;
+typedef elai::matrix< double > Matrix;
+typedef elai::chebyshev_conditioner< double > ChebyshevP;
+typedef elai::cg< double > CG;
+
+double residual( const Matrix& A, const Vector& x, const Vector& b )
+{
+  Vector r( b - A * x );
+  double res = r * r;
+
+  return res;
+}
+
+int main()
+{
+  using namespace elai;
+
+  // 5-point Laplacian on a 32x32 grid
+  const int nx = 32, n = nx * nx;
+  std::vector< int > ind( n + 1 ), col;
+  std::vector< double > c;
+
+  ind[ 0 ] = 0;
+  for ( int i = 0; i < n; ++i )
+  {
+    int x = i % nx, y = i / nx;
+
+    if ( 0 < y ) { col.push_back( i - nx ); c.push_back( -1. ); }
+    if ( 0 < x ) { col.push_back( i - 1 ); c.push_back( -1. ); }
+    col.push_back( i ); c.push_back( 4. );
+    if ( x < nx - 1 ) { col.push_back( i + 1 ); c.push_back( -1. ); }
+    if ( y < nx - 1 ) { col.push_back( i + nx ); c.push_back( -1. ); }
+    ind[ i + 1 ] = col.size();
+  }
+
+  Matrix A( n, n, col.size(), &ind[ 0 ], &col[ 0 ], &c[ 0 ] );
+  Vector x( n ), b( n );
+  bool flg = true;
+
+  b = 1.;
+
+  for ( int degree = 0; degree <= 6; degree += 3 )
+  {
+    ChebyshevP prec( A, degree );
+    CG solver( A, b, &prec );
+
+    prec.factor();
+    cout << "degree=" << degree << " lmin=" << prec.lmin() << " lmax=" << prec.lmax() << endl;
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "Chebyshev " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+  }
+  {
+    // As a smoother: only the upper part of the spectrum.
+    ChebyshevP prec( A, 2 );
+    CG solver( A, b, &prec );
+
+    prec.factor( 10, 30. );
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "Chebyshev( 30 ) " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+  }
+
+  return flg ? 0 : 1;
+}
@@ -148,6 +148,12 @@ int main( int argc, char **argv )
     for ( int i = 0; i < n; ++i ) f( Element( i, PSI, myrank ) ) = 2 * i;
     coherent( f.ran().val() );
     cout << f.ran();
+
+    // Split-phase exchange
+    for ( int i = 0; i < n; ++i ) f( Element( i, PSI, myrank ) ) = 4 * i;
+    coherent.begin( f.ran().val() );
+    coherent.end();
+    cout << f.ran();
   }
   else if ( myrank == 1 )
   {
@@ -167,6 +173,12 @@ int main( int argc, char **argv )
     for ( int i = 0; i < n; ++i ) f( Element( i, PSI, myrank ) ) = 2 * i + 1;
     coherent( f.ran().val() );
     cout << f.ran();
+
+    // Split-phase exchange
+    for ( int i = 0; i < n; ++i ) f( Element( i, PSI, myrank ) ) = 4 * i + 1;
+    coherent.begin( f.ran().val() );
+    coherent.end();
+    cout << f.ran();
   }
   MPI_Finalize();
 }
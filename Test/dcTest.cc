@@ -210,5 +210,12 @@ int main( int argc, char **argv )
   F_sync();
   if ( myrank == 0 ) cout << "all: " << F.ran();
 
+  Function G( all );
+  Sync G_sync( G, subj, MPI_COMM_WORLD );
+
+  G.reflect( f, subj );
+  G_sync();
+  if ( myrank == 0 ) cout << "all( owners ): " << G.ran();
+
   MPI_Finalize();
 }
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <vector>
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "sor_conditioner.hpp"
+#include "eisenstat.hpp"
+#include "cg.hpp"
+
+using namespace std;
+
+typedef elai::vector< double > Vector;
+typedef elai::matrix< double > Matrix;
+typedef elai::sor_conditioner< double > SorP;
+typedef elai::eisenstat_cg< double > ECG;
+typedef elai::eisenstat_bicgstab< double > EBCGS;
+typedef elai::cg< double > CG;
+
+// 5-point stencil on an nx x nx grid, with the west and east coefficients
+Matrix grid( int nx, double w, double e )
+{
+  const int n = nx * nx;
+  vector< int > ind( n + 1 ), col;
+  vector< double > c;
+
+  ind[ 0 ] = 0;
+  for ( int i = 0; i < n; ++i )
+  {
+    int x = i % nx, y = i / nx;
+
+    if ( 0 < y ) { col.push_back( i - nx ); c.push_back( -1. ); }
+    if ( 0 < x ) { col.push_back( i - 1 ); c.push_back( w ); }
+    col.push_back( i ); c.push_back( 4. );
+    if ( x < nx - 1 ) { col.push_back( i + 1 ); c.push_back( e ); }
+    if ( y < nx - 1 ) { col.push_back( i + nx ); c.push_back( -1. ); }
+    ind[ i + 1 ] = col.size();
+  }
+
+  return Matrix( n, n, col.size(), &ind[ 0 ], &col[ 0 ], &c[ 0 ] );
+}
+
+double residual( const Matrix& A, const Vector& x, const Vector& b )
+{
+  Vector r( b - A * x );
+  double res = r * r;
+
+  return res;
+}
+
+int main()
+{
+  using namespace elai;
+
+  bool flg = true;
+
+  {
+    Matrix A( grid( 32, -1., -1. ) );
+    Vector x( A.m() ), b( A.m() );
+    SorP prec( A, 1.5 );
+    ECG solver( A, b, prec );
+
+    b = 1.;
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "Eisenstat CG " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+  }
+  {
+    Matrix A( grid( 32, -1.5, -.5 ) );
+    Vector x( A.m() ), b( A.m() );
+    SorP prec( A, 1.2 );
+    EBCGS solver( A, b, prec );
+
+    b = 1.;
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "Eisenstat BiCGStab " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+  }
+
+  // Hybrid SSOR on 4 blocks, as sor::hybrid; Eisenstat needs the exact
+  // splitting, so it goes with the plain CG.
+  {
+    Matrix A( grid( 32, -1., -1. ) );
+    Vector x( A.m() ), y( A.m() ), b( A.m() );
+    SorP prec( A, 1.5 );
+    CG solver( A, b, &prec );
+
+    prec.hybrid( 4 );
+    for ( int i = 0; i < A.m(); ++i ) y( i ) = i % 7;
+    x = y;
+    prec.forward( x );
+    prec.forwardInv( x );
+    y = x - y;
+
+    double err = y * y;
+
+    b = 1.;
+    x = 0.;
+
+    bool ok = solver.solve( x ) && err < 1e-20;
+
+    flg = flg && ok;
+    cout << "Hybrid SSOR CG " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << " inverse " << err << endl;
+  }
+
+  return flg ? 0 : 1;
+}
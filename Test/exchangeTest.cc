@@ -0,0 +1,155 @@
+#include <iostream>
+#include <map>
+#include <vector>
+#include "mpi.h"
+#include "space.hpp"
+#include "family.hpp"
+#include "subjugator.hpp"
+#include "generator.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "linear_function.hpp"
+#include "linear_operator.hpp"
+#include "coherence.hpp"
+#include "exchange.hpp"
+
+using namespace std;
+
+typedef elai::generator< double > Generator;
+typedef Generator::Space Space;
+typedef elai::subjugator< Generator::Element, Generator::Neighbour > Subjugator;
+typedef elai::coherence Coherence;
+typedef elai::vector< double > Vector;
+typedef elai::matrix< double > Matrix;
+typedef elai::linear_function< Generator::Element, Generator::Neighbour, double > Function;
+typedef elai::linear_operator< Generator::Element, Generator::Neighbour, double > Operator;
+typedef map< int, vector< int > > Lists;
+
+int myrank, mysize;
+
+// 5-point Laplacian on an nx x nx grid
+Matrix grid( int nx )
+{
+  const int n = nx * nx;
+  vector< int > ind( n + 1 ), col;
+  vector< double > c;
+
+  ind[ 0 ] = 0;
+  for ( int i = 0; i < n; ++i )
+  {
+    int x = i % nx, y = i / nx;
+
+    if ( 0 < y ) { col.push_back( i - nx ); c.push_back( -1. ); }
+    if ( 0 < x ) { col.push_back( i - 1 ); c.push_back( -1. ); }
+    col.push_back( i ); c.push_back( 4. );
+    if ( x < nx - 1 ) { col.push_back( i + 1 ); c.push_back( -1. ); }
+    if ( y < nx - 1 ) { col.push_back( i + nx ); c.push_back( -1. ); }
+    ind[ i + 1 ] = col.size();
+  }
+
+  return Matrix( n, n, col.size(), &ind[ 0 ], &col[ 0 ], &c[ 0 ] );
+}
+
+// Prints OK on the rank 0 only if flg holds on every rank.
+bool report( const char *name, bool flg )
+{
+  int ok = flg ? 1 : 0, all;
+
+  MPI_Allreduce( &ok, &all, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD );
+  if ( myrank == 0 ) cout << name << " " << ( all == 1 ? "OK" : "NG" ) << endl;
+
+  return all == 1;
+}
+
+// Each rank sends to the next one and the one after, the list of r being
+// { r, r + 1, ... } of r % 3 entries; no rank knows its senders.
+bool sparse()
+{
+  bool flg = true;
+
+  for ( int round = 0; round < 2; ++round )
+  {
+    Lists out, in, expected;
+
+    for ( int d = 1; d <= 2 && d < mysize; ++d )
+    {
+      int to = ( myrank + d ) % mysize, from = ( myrank - d + mysize ) % mysize;
+
+      out[ to ].clear();
+      for ( int k = 0; k < myrank % 3; ++k ) out[ to ].push_back( myrank + k + round );
+      expected[ from ].clear();
+      for ( int k = 0; k < from % 3; ++k ) expected[ from ].push_back( from + k + round );
+    }
+    elai::sparse_exchange( MPI_COMM_WORLD, out, in );
+    flg = flg && in == expected;
+  }
+
+  return report( "sparse_exchange", flg );
+}
+
+// Exchanges of more bases than keep persistent requests; the least
+// recently used ones give theirs up, and release() frees them at once.
+bool persistent()
+{
+  Matrix A0( grid( 8 ) );
+  const int n = A0.m();
+  Vector b0( n );
+  Generator gen( A0 );
+  Operator A( gen.space(), gen.space(), gen.family(), A0 );
+  vector< int > ranks;
+
+  for ( int i = 0; i < n; ++i ) b0( i ) = i + 1.;
+  for ( int i = 0; i < mysize; ++i ) ranks.push_back( i );
+
+  Subjugator loc( A.dom(), A.topo(), ranks );
+  Space base( loc( myrank ) );
+  Function U( A.dom(), b0 ), u( base );
+  Coherence coherent( u, MPI_COMM_WORLD );
+
+  u.reflectIn( U, loc );
+
+  const int m = u.ran().m(), owned = coherent.owned();
+  const int nv = 40;
+  const Vector ref( u.ran() );
+  vector< Vector > v( nv, Vector( m ) );
+  bool flg = true, lru;
+
+  // begin() and end() are split as in the overlapped SpMV on odd bases.
+  for ( int round = 1; round <= 3; ++round )
+    for ( int k = 0; k < nv; ++k )
+    {
+      for ( int i = 0; i < m; ++i ) v[ k ]( i ) = i < owned ? round * ( k + 1 ) * ref( i ) : 0.;
+      if ( k % 2 == 0 ) coherent( v[ k ].val() );
+      else
+      {
+        coherent.begin( v[ k ].val() );
+        coherent.end();
+      }
+      for ( int i = 0; i < m; ++i ) flg = flg && v[ k ]( i ) == round * ( k + 1 ) * ref( i );
+    }
+  flg = report( "persistent exchange", flg );
+
+  // With neighbours, each exchange binds requests to its base.
+  lru = coherent.persistents() == 0 || coherent.persistents() == 32;
+  for ( int k = 0; k < nv; ++k ) coherent.release( v[ k ].val() );
+  lru = lru && coherent.persistents() == 0;
+  flg = report( "release", lru ) && flg;
+
+  return flg;
+}
+
+int main( int argc, char **argv )
+{
+  bool flg = true;
+
+  MPI_Init( &argc, &argv );
+  MPI_Comm_size( MPI_COMM_WORLD, &mysize );
+  MPI_Comm_rank( MPI_COMM_WORLD, &myrank );
+
+  flg = sparse() && flg;
+  flg = persistent() && flg;
+
+  MPI_Finalize();
+
+  return flg ? 0 : 1;
+}
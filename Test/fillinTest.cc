@@ -1,6 +1,7 @@
 #include <iostream>
 #include <map>
 #include <set>
+#include <vector>
 #include "vector.hpp"
 #include "matrix.hpp"
 #include "linear_function.hpp"
@@ -117,9 +118,41 @@ typedef elai::linear_function< Element, Neighbour, float > Function;
 typedef elai::matrix< float > Matrix;
 typedef elai::linear_operator< Element, Neighbour, float > Operator;
 typedef elai::fillin< float > Fillin;
+typedef std::vector< std::map< int, int > > Rows;
+
+// Symmetric rule of ILU( lv ) by maps from the columns to the levels: the
+// lower part merges the rows k < j < i, and a fill ( i, j ) is mirrored.
+Rows mirrored( const Matrix& A, int lv, float thres )
+{
+  Rows adj( A.m() );
+
+  for ( int i = 0; i < A.m(); ++i )
+    for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k )
+      if ( A.col( k ) == i || thres <= fabs( A.val( k ) ) ) adj[ i ][ A.col( k ) ] = 0;
+  for ( int i = 0; i < A.m(); ++i )
+    for ( map< int, int >::const_iterator it = adj[ i ].begin(); it != adj[ i ].end() && it->first < i; ++it )
+    {
+      if ( lv <= it->second ) continue;
+      for ( map< int, int >::const_iterator jt = adj[ it->first ].begin()
+          ; jt != adj[ it->first ].end() && jt->first < i; ++jt
+          )
+      {
+        if ( jt->first <= it->first || lv <= jt->second ) continue;
+
+        int l = max( it->second, jt->second ) + 1;
+
+        adj[ i ].insert( make_pair( jt->first, l ) );
+        adj[ jt->first ].insert( make_pair( i, l ) );
+      }
+    }
+
+  return adj;
+}
 
 int main()
 {
+  bool flg = true;
+
   {
     Space s1;
     s1.join( Element( 1, PSI ) );
@@ -160,5 +193,52 @@ int main()
     Matrix a( f.m(), f.n(), f.nnz(), f.xadj(), f.adjy(), f.coef() );
     cout << A.action();
     cout << a;
+
+    // Sum rule
+    Fillin g( A.action() );
+    g( 2, 0., true );
+    Matrix b( g.m(), g.n(), g.nnz(), g.xadj(), g.adjy(), g.coef() );
+    cout << b;
+  }
+  // A threshold drops some upper entries of a symmetric pattern; the
+  // pattern is to follow the symmetric rule.
+  {
+    const int n = 18;
+    std::vector< int > ind( n + 1 ), col;
+    std::vector< float > c;
+
+    ind[ 0 ] = 0;
+    for ( int i = 0; i < n; ++i )
+    {
+      for ( int j = i - 3; j <= i + 3; ++j )
+      {
+        if ( j < 0 || n <= j || j == i - 2 || j == i + 2 ) continue;
+        col.push_back( j );
+        c.push_back( i == j ? 4. : i < j && ( i + j ) % 3 == 0 ? -.1 : -1. );
+      }
+      ind[ i + 1 ] = col.size();
+    }
+
+    Matrix A( n, n, col.size(), &ind[ 0 ], &col[ 0 ], &c[ 0 ] );
+
+    for ( int lv = 0; lv < 3; ++lv )
+    {
+      Fillin f( A );
+      Rows ref( mirrored( A, lv, .5 ) );
+      bool same = true;
+
+      f( lv, .5 );
+      for ( int i = 0; i < n; ++i )
+      {
+        Rows::value_type::const_iterator it = ref[ i ].begin();
+
+        same = same && f.xadj()[ i + 1 ] - f.xadj()[ i ] == static_cast< int >( ref[ i ].size() );
+        for ( int k = f.xadj()[ i ]; same && k < f.xadj()[ i + 1 ]; ++k, ++it ) same = f.adjy()[ k ] == it->first;
+      }
+      flg = flg && same;
+      cout << "lv=" << lv << " nnz=" << f.nnz() << ( same ? " OK" : " NG" ) << endl;
+    }
   }
+
+  return flg ? 0 : 1;
 }
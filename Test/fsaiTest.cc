@@ -0,0 +1,81 @@
+#include <iostream>
+#include <vector>
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "generator.hpp"
+#include "clique.hpp"
+#include "fsai.hpp"
+#include "cg.hpp"
+
+using namespace std;
+
+typedef elai::vector< double > Vector;
+typedef elai::matrix< double > Matrix;
+typedef elai::generator< double > Generator;
+typedef elai::clique< Generator::Element, Generator::Neighbour > Clique;
+typedef elai::fsai< double > FSAI;
+typedef elai::cg< double > CG;
+
+double residual( const Matrix& A, const Vector& x, const Vector& b )
+{
+  Vector r( b - A * x );
+  double res = r * r;
+
+  return res;
+}
+
+int main()
+{
+  using namespace elai;
+
+  // 5-point stencil on a 32x32 grid
+  const int nx = 32, n = nx * nx;
+  std::vector< int > ind( n + 1 ), col;
+  std::vector< double > c;
+
+  ind[ 0 ] = 0;
+  for ( int i = 0; i < n; ++i )
+  {
+    int x = i % nx, y = i / nx;
+
+    if ( 0 < y ) { col.push_back( i - nx ); c.push_back( -1. ); }
+    if ( 0 < x ) { col.push_back( i - 1 ); c.push_back( -1. ); }
+    col.push_back( i ); c.push_back( 4. );
+    if ( x < nx - 1 ) { col.push_back( i + 1 ); c.push_back( -1. ); }
+    if ( y < nx - 1 ) { col.push_back( i + nx ); c.push_back( -1. ); }
+    ind[ i + 1 ] = col.size();
+  }
+
+  Matrix A( n, n, col.size(), &ind[ 0 ], &col[ 0 ], &c[ 0 ] );
+  Vector x( n ), b( n );
+  Generator gen( A );
+  bool flg = true;
+
+  b = 1.;
+
+  for ( int lv = 0; lv <= 2; lv += 2 )
+  {
+    FSAI prec( A );
+    CG solver( A, b, &prec );
+
+    // The pattern of A, or of 2-level adjacents.
+    if ( 0 < lv )
+    {
+      Clique adj( gen.space(), gen.family() );
+
+      adj.fill( lv );
+      prec.pattern( adj.n(), adj.xadj(), adj.adjy() );
+    }
+    prec.factor();
+    cout << "lv=" << lv << " nnz=" << prec.nnz() << endl;
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "FSAI " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+  }
+
+  return flg ? 0 : 1;
+}
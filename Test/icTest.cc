@@ -2,6 +2,7 @@
 #include "vector.hpp"
 #include "matrix.hpp"
 #include "ic.hpp"
+#include "blas.hpp"
 #include "cg.hpp"
 
 using namespace std;
@@ -11,6 +12,25 @@ typedef elai::matrix< float > Matrix;
 typedef elai::ic< float > IC;
 typedef elai::cg< float > CG;
 
+// The split factors against the combined ones: forwardInv undoes the
+// forward sweep, and apply() is the forward sweep then the backward one.
+float split_error( const IC& prec, const Vector& b )
+{
+  Vector y( b ), z( b.m() );
+  float err = 0.;
+
+  prec.forward( y );
+  prec.forwardInv( y );
+  for ( int i = 0; i < b.m(); ++i ) err += ( y( i ) - b( i ) ) * ( y( i ) - b( i ) );
+  y = b;
+  prec.forward( y );
+  prec.backward( y );
+  prec.apply( b, z );
+  for ( int i = 0; i < b.m(); ++i ) err += ( y( i ) - z( i ) ) * ( y( i ) - z( i ) );
+
+  return err;
+}
+
 int main()
 {
   using namespace elai;
@@ -51,4 +71,15 @@ int main()
     cout << x;
   }
   else cout << "Diverged!!" << endl;
+
+  // IC(0) of a tridiagonal matrix is exact, so apply() solves A x = b.
+  Vector r( b.m() );
+  float err = split_error( prec, b ), res;
+
+  prec.apply( b, x );
+  r = b - A * x;
+  res = r * r;
+  cout << "Split " << ( err < 1e-8 && res < 1e-8 ? "OK" : "NG" ) << endl;
+
+  return err < 1e-8 && res < 1e-8 ? 0 : 1;
 }
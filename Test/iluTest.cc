@@ -2,6 +2,7 @@
 #include "vector.hpp"
 #include "matrix.hpp"
 #include "ilu.hpp"
+#include "blas.hpp"
 #include "bicgstab.hpp"
 
 using namespace std;
@@ -11,6 +12,32 @@ typedef elai::matrix< float > Matrix;
 typedef elai::ilu< float > ILU;
 typedef elai::bicgstab< float > BCGS;
 
+// The split factors against the combined ones: forwardInv undoes the
+// forward sweep, backwardInv adds U x to x, and apply() is the forward
+// sweep then the backward one.
+float split_error( const ILU& prec, const Vector& b )
+{
+  Vector y( b ), z( b );
+  float err = 0.;
+
+  prec.backward( z );
+  y = z;
+  prec.backwardInv( y );
+  for ( int i = 0; i < b.m(); ++i ) err += ( y( i ) - z( i ) - b( i ) ) * ( y( i ) - z( i ) - b( i ) );
+  y = b;
+
+  prec.forward( y );
+  prec.forwardInv( y );
+  for ( int i = 0; i < b.m(); ++i ) err += ( y( i ) - b( i ) ) * ( y( i ) - b( i ) );
+  y = b;
+  prec.forward( y );
+  prec.backward( y );
+  prec.apply( b, z );
+  for ( int i = 0; i < b.m(); ++i ) err += ( y( i ) - z( i ) ) * ( y( i ) - z( i ) );
+
+  return err;
+}
+
 int main()
 {
   using namespace elai;
@@ -51,4 +78,48 @@ int main()
     cout << x;
   }
   else cout << "Diverged!!" << endl;
+
+  // ILU(0) of a tridiagonal matrix is exact, so apply() solves A x = b.
+  Vector r( b.m() );
+  float err = split_error( prec, b ), res;
+
+  prec.apply( b, x );
+  r = b - A * x;
+  res = r * r;
+  flg = err < 1e-8 && res < 1e-8;
+  cout << "Split " << ( flg ? "OK" : "NG" ) << endl;
+
+  // Iterative factorization, warm-started from the factors above.
+  prec.refactor( 3 );
+  x = 0.;
+  if ( solver.solve( x ) )
+  {
+    cout << "Solved.." << endl;
+    cout << x;
+  }
+  else cout << "Diverged!!" << endl;
+  err = split_error( prec, b );
+  cout << "Split " << ( err < 1e-8 ? "OK" : "NG" ) << endl;
+  flg = flg && err < 1e-8;
+
+  // Cold start from A: the sweeps reach the factors of factor() on this
+  // pattern within n sweeps, so both preconditioners give the same x.
+  {
+    ILU exact( A ), cold( A );
+    Vector y( n );
+    float diff;
+
+    exact.factor( 1e-05 );
+    cold.refactor( n, false );
+    exact.apply( b, x );
+    cold.apply( b, y );
+    r = x - y;
+    diff = r * r;
+    r = b - A * y;
+    res = r * r;
+    cout << "Cold " << ( diff < 1e-8 && res < 1e-8 ? "OK" : "NG" ) << endl;
+    flg = flg && diff < 1e-8 && res < 1e-8;
+  }
+
+  return flg ? 0 : 1;
 }
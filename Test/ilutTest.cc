@@ -0,0 +1,97 @@
+#include <iostream>
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "ilut.hpp"
+#include "bicgstab.hpp"
+
+using namespace std;
+
+typedef elai::vector< double > Vector;
+typedef elai::matrix< double > Matrix;
+typedef elai::ilut< double > ILUT;
+typedef elai::bicgstab< double > BCGS;
+
+double residual( const Matrix& A, const Vector& x, const Vector& b )
+{
+  Vector r( b - A * x );
+  double res = r * r;
+
+  return res;
+}
+
+int main()
+{
+  using namespace elai;
+
+  // Convection-diffusion on an 8x8 grid
+  const int nx = 8, n = nx * nx;
+  int ind[ n + 1 ], col[ 5 * n ];
+  double c[ 5 * n ];
+  int nnz = 0;
+
+  ind[ 0 ] = 0;
+  for ( int i = 0; i < n; ++i )
+  {
+    int x = i % nx, y = i / nx;
+
+    if ( 0 < y ) { col[ nnz ] = i - nx; c[ nnz++ ] = -1.; }
+    if ( 0 < x ) { col[ nnz ] = i - 1; c[ nnz++ ] = -1.5; }
+    col[ nnz ] = i; c[ nnz++ ] = 4.;
+    if ( x < nx - 1 ) { col[ nnz ] = i + 1; c[ nnz++ ] = -0.5; }
+    if ( y < nx - 1 ) { col[ nnz ] = i + nx; c[ nnz++ ] = -1.; }
+    ind[ i + 1 ] = nnz;
+  }
+
+  Matrix A( n, n, nnz, ind, col, c );
+  Vector x( n ), b( n );
+  bool flg = true;
+
+  b = 1.;
+
+  {
+    ILUT prec( A, 1e-2, 3 );
+    BCGS solver( A, b, &prec );
+
+    prec.factor();
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "ILUT(1e-2,3) nnz=" << prec.nnz() << " "
+         << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+  }
+  {
+    // Memory-budget mode: about as many entries as A.
+    ILUT prec( A );
+    BCGS solver( A, b, &prec );
+
+    prec.budget( 1. );
+    prec.factor();
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "ILUT budget p=" << prec.fill() << " nnz=" << prec.nnz() << "/" << A.nnz() << " "
+         << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+  }
+  {
+    // No dropping is the exact LU.
+    ILUT prec( A, 0., -1 );
+
+    prec.factor();
+    x = b;
+    prec.forward( x );
+    prec.backward( x );
+
+    double res = residual( A, x, b );
+
+    flg = flg && res < 1e-20;
+    cout << "LU ||Ax-b||^2=" << res << endl;
+  }
+
+  return flg ? 0 : 1;
+}
@@ -0,0 +1,247 @@
+#include <iostream>
+#include <vector>
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "linear_map.hpp"
+#include "jacobi_conditioner.hpp"
+#include "jacobi.hpp"
+#include "cg.hpp"
+#include "bicgstab.hpp"
+#include "bicgsafe.hpp"
+#include "gmres.hpp"
+#include "static_ksp.hpp"
+
+using namespace std;
+
+typedef elai::vector< double > Vector;
+typedef elai::matrix< double > Matrix;
+typedef elai::linear_map< double > Map;
+typedef elai::matrix_map< double > MatrixMap;
+typedef elai::identity_conditioner< double > Identity;
+
+// 5-point Laplacian on an nx x nx grid, never assembled
+class stencil : public Map
+{
+  int nx_;
+
+public:
+  explicit stencil( int nx ) : nx_( nx ) {}
+
+  int m() const { return nx_ * nx_; }
+
+  void apply( const Vector& u, Vector& v ) const
+  {
+    for ( int i = 0; i < m(); ++i )
+    {
+      int x = i % nx_, y = i / nx_;
+      double acc = 4. * u( i );
+
+      if ( 0 < y ) acc -= u( i - nx_ );
+      if ( 0 < x ) acc -= u( i - 1 );
+      if ( x < nx_ - 1 ) acc -= u( i + 1 );
+      if ( y < nx_ - 1 ) acc -= u( i + nx_ );
+      v( i ) = acc;
+    }
+  }
+
+  bool diag( Vector& d ) const
+  {
+    d = 4.;
+
+    return true;
+  }
+};
+
+// F( u ) = L u + u^3 - b, of which the Jacobian J v is a forward difference
+class jacobian : public Map
+{
+  const stencil& L_;
+  const Vector& u_;
+  const Vector& b_;
+  Vector& F0_;
+  Vector& w_;
+  Vector& Fw_;
+
+public:
+  jacobian( const stencil& L, const Vector& u, const Vector& b, Vector& F0, Vector& w, Vector& Fw )
+    : L_( L ), u_( u ), b_( b ), F0_( F0 ), w_( w ), Fw_( Fw )
+  {}
+
+  int m() const { return L_.m(); }
+
+  void F( const Vector& u, Vector& v ) const
+  {
+    L_.apply( u, v );
+    for ( int i = 0; i < m(); ++i ) v( i ) += u( i ) * u( i ) * u( i ) - b_( i );
+  }
+
+  void apply( const Vector& v, Vector& Jv ) const
+  {
+    double nv = v * v, eps;
+
+    if ( nv == 0. ) { Jv = 0.; return; }
+    eps = 1e-7 / sqrt( nv );
+    for ( int i = 0; i < m(); ++i ) w_( i ) = u_( i ) + eps * v( i );
+    F( w_, Fw_ );
+    for ( int i = 0; i < m(); ++i ) Jv( i ) = ( Fw_( i ) - F0_( i ) ) / eps;
+  }
+};
+
+// The same Laplacian, assembled
+Matrix grid( int nx )
+{
+  const int n = nx * nx;
+  vector< int > ind( n + 1 ), col;
+  vector< double > c;
+
+  ind[ 0 ] = 0;
+  for ( int i = 0; i < n; ++i )
+  {
+    int x = i % nx, y = i / nx;
+
+    if ( 0 < y ) { col.push_back( i - nx ); c.push_back( -1. ); }
+    if ( 0 < x ) { col.push_back( i - 1 ); c.push_back( -1. ); }
+    col.push_back( i ); c.push_back( 4. );
+    if ( x < nx - 1 ) { col.push_back( i + 1 ); c.push_back( -1. ); }
+    if ( y < nx - 1 ) { col.push_back( i + nx ); c.push_back( -1. ); }
+    ind[ i + 1 ] = col.size();
+  }
+
+  return Matrix( n, n, col.size(), &ind[ 0 ], &col[ 0 ], &c[ 0 ] );
+}
+
+double residual( const Map& A, const Vector& x, const Vector& b )
+{
+  Vector r( A.m() );
+
+  A.apply( x, r );
+  r = b - r;
+
+  double res = r * r;
+
+  return res;
+}
+
+int main()
+{
+  using namespace elai;
+
+  const int nx = 24;
+  stencil L( nx );
+  Matrix A( grid( nx ) );
+  MatrixMap M( A );
+  Vector x( L.m() ), b( L.m() ), d;
+  bool flg = true;
+
+  b = 1.;
+
+  M.diag( d );
+  cout << "diag " << d( 0 ) << " " << d( L.m() - 1 ) << endl;
+  {
+    cg< double > solver( L, b );
+
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "CG stencil " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( M, x, b ) << endl;
+  }
+  {
+    // The preconditioners still take an assembled matrix.
+    jacobi_conditioner< double > prec( A );
+    cg< double > solver( L, b, &prec );
+
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "CG stencil Jacobi " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( M, x, b ) << endl;
+  }
+  {
+    bicgstab< double > solver( L, b );
+
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "BiCGStab stencil " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( M, x, b ) << endl;
+  }
+  {
+    bicgsafe< double > solver( L, b );
+
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "BiCGSafe stencil " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( M, x, b ) << endl;
+  }
+  {
+    gmres< double > solver( M, b );
+
+    solver.iter_max( 400 );
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "GMRES matrix_map " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( L, x, b ) << endl;
+  }
+  {
+    // The diagonal comes from the map.
+    jacobi< double > solver( L, b );
+
+    solver.iter_max( 20 );
+    x = 0.;
+    solver.solve( x );
+    cout << "Jacobi stencil 20 sweeps ||Ax-b||^2=" << residual( M, x, b ) << endl;
+  }
+  {
+    Identity prec;
+    static_cg< double, stencil, Identity > solver( L, b, prec );
+
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "static CG stencil " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( L, x, b ) << endl;
+  }
+  {
+    // Jacobian-free Newton-Krylov on L u + u^3 = c.
+    Vector u( L.m() ), c( L.m() ), F0( L.m() ), w( L.m() ), Fw( L.m() ), du( L.m() ), rhs( L.m() );
+    jacobian J( L, u, c, F0, w, Fw );
+
+    double res = 0.;
+
+    c = .01;
+    u = 0.;
+    for ( int k = 0; k < 10; ++k )
+    {
+      J.F( u, F0 );
+      res = F0 * F0;
+      cout << "Newton " << k << " ||F||^2=" << res << endl;
+      if ( res < 1e-20 ) break;
+      for ( int i = 0; i < L.m(); ++i ) rhs( i ) = -F0( i );
+      du = 0.;
+
+      gmres< double > solver( J, rhs );
+
+      solver.rel_thres( 1e-8 );
+      solver.solve( du );
+      u = u + du;
+    }
+    flg = flg && res < 1e-20;
+  }
+
+  return flg ? 0 : 1;
+}
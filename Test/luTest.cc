@@ -1,23 +1,164 @@
 #include <iostream>
+#include <vector>
 #include "mpi.h"
+#include "space.hpp"
+#include "family.hpp"
+#include "subjugator.hpp"
+#include "generator.hpp"
 #include "vector.hpp"
 #include "matrix.hpp"
+#include "blas.hpp"
+#include "linear_function.hpp"
+#include "linear_operator.hpp"
+#include "coherence.hpp"
 #include "lu.hpp"
 #include "mumps.hpp"
 
 using namespace std;
 
+typedef elai::generator< double > Generator;
+typedef Generator::Space Space;
+typedef Generator::Family Family;
+typedef elai::subjugator< Generator::Element, Generator::Neighbour > Subjugator;
+typedef elai::coherence Coherence;
 typedef elai::vector< double > Vector;
 typedef elai::matrix< double > Matrix;
+typedef elai::linear_function< Generator::Element, Generator::Neighbour, double > Function;
+typedef elai::linear_operator< Generator::Element, Generator::Neighbour, double > Operator;
 typedef elai::mumps< double > LU;
 
+int myrank, mysize;
+
+// Convection-diffusion on an nx x nx grid
+Matrix grid( int nx )
+{
+  const int n = nx * nx;
+  vector< int > ind( n + 1 ), col;
+  vector< double > c;
+
+  ind[ 0 ] = 0;
+  for ( int i = 0; i < n; ++i )
+  {
+    int x = i % nx, y = i / nx;
+
+    if ( 0 < y ) { col.push_back( i - nx ); c.push_back( -1.3 ); }
+    if ( 0 < x ) { col.push_back( i - 1 ); c.push_back( -1. ); }
+    col.push_back( i ); c.push_back( 4. );
+    if ( x < nx - 1 ) { col.push_back( i + 1 ); c.push_back( -1. ); }
+    if ( y < nx - 1 ) { col.push_back( i + nx ); c.push_back( -.7 ); }
+    ind[ i + 1 ] = col.size();
+  }
+
+  return Matrix( n, n, col.size(), &ind[ 0 ], &col[ 0 ], &c[ 0 ] );
+}
+
+// ||Ax-b||^2 of the first owned rows of each rank, summed over the ranks
+double residual( const Matrix& A, const Vector& x, const Vector& b, int owned )
+{
+  Vector r( b - A * x );
+  double res = 0., sum;
+
+  for ( int i = 0; i < owned; ++i ) res += r( i ) * r( i );
+  MPI_Allreduce( &res, &sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
+
+  return sum;
+}
+
+// Prints OK on the rank 0 only if flg holds on every rank.
+bool report( const char *name, bool flg )
+{
+  int ok = flg ? 1 : 0, all;
+
+  MPI_Allreduce( &ok, &all, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD );
+  if ( myrank == 0 ) cout << name << " " << ( all == 1 ? "OK" : "NG" ) << endl;
+
+  return all == 1;
+}
+
+// Distributed input: each rank enters the owned rows of its local operator.
+bool distributed()
+{
+  Matrix A0( grid( 8 ) );
+  Vector b0( A0.m() );
+  Generator gen( A0 );
+  Operator A( gen.space(), gen.space(), gen.family(), A0 );
+  vector< int > ranks;
+
+  b0 = 1.;
+  for ( int i = 0; i < mysize; ++i ) ranks.push_back( i );
+
+  Subjugator loc( A.dom(), A.topo(), ranks );
+  Space base( loc( myrank ) );
+  Family topo( loc( myrank, base ) );
+  Operator a( base, topo );
+  Function U( A.dom(), b0 ), V( A.dom(), b0 ), u( base ), v( base );
+  Coherence coherent( u, MPI_COMM_WORLD );
+
+  U.clear( 0e0 );
+  a.reflectIn( A, loc );
+  u.reflectIn( U, loc );
+  v.reflectIn( V, loc );
+
+  LU lu( a.action(), u, coherent );
+  const int owned = coherent.owned();
+  bool flg;
+
+  lu.factor();
+  flg = lu.solve( v.ran(), u.ran() );
+  flg = flg && lu.n() == A0.m();
+  flg = flg && residual( a.action(), u.ran(), v.ran(), owned ) < 1e-20;
+  flg = report( "Distributed", flg );
+
+  // Three right-hand sides in one solution phase: b, 2b and the unit
+  // vector of the global row 0.
+  const int m = a.action().m();
+  Vector b[ 3 ], x[ 3 ];
+  bool multi;
+
+  for ( int r = 0; r < 3; ++r )
+  {
+    b[ r ].setup( m );
+    x[ r ].setup( m );
+    b[ r ] = 0.;
+  }
+  for ( int i = 0; i < m; ++i )
+  {
+    b[ 0 ]( i ) = v.ran()( i );
+    b[ 1 ]( i ) = 2. * v.ran()( i );
+    if ( lu.global( i ) == 0 ) b[ 2 ]( i ) = 1.;
+  }
+  multi = lu.solve( b, x, 3 );
+  for ( int r = 0; r < 3; ++r ) multi = residual( a.action(), x[ r ], b[ r ], owned ) < 1e-20 && multi;
+  flg = report( "Distributed multi", multi ) && flg;
+
+  // The same unit vector and b, as sparse right-hand sides.
+  vector< int > ind( 3, 0 ), col;
+  vector< double > c;
+  bool sparse;
+
+  for ( int i = 0; i < m; ++i )
+    if ( lu.global( i ) == 0 ) { col.push_back( i ); c.push_back( 1. ); }
+  ind[ 1 ] = col.size();
+  for ( int i = 0; i < m; ++i ) { col.push_back( i ); c.push_back( v.ran()( i ) ); }
+  ind[ 2 ] = col.size();
+
+  Matrix B( 2, m, col.size(), &ind[ 0 ], col.empty() ? NULL : &col[ 0 ], c.empty() ? NULL : &c[ 0 ] );
+
+  sparse = lu.solve( B, x );
+  sparse = residual( a.action(), x[ 0 ], b[ 2 ], owned ) < 1e-20 && sparse;
+  sparse = residual( a.action(), x[ 1 ], b[ 0 ], owned ) < 1e-20 && sparse;
+
+  return report( "Distributed sparse", sparse ) && flg;
+}
+
 int main( int argc, char **argv )
 {
   using namespace elai;
-  int rank;
+  bool flg = true;
 
   MPI_Init( &argc, &argv );
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( MPI_COMM_WORLD, &myrank );
+  MPI_Comm_size( MPI_COMM_WORLD, &mysize );
 
   int n = 5;
   int nnz = 13;
@@ -48,13 +189,49 @@ int main( int argc, char **argv )
     b( i ) = 1.;
   }
 
+  // The solution is left on the host only.
   lu->factor();
-  lu->solve( b, x );
-  if ( rank == 0 ) cout << x;
+  flg = lu->solve( b, x );
+  if ( myrank == 0 ) cout << x;
+  flg = report( "Centralized", flg && residual( A, x, b, myrank == 0 ? n : 0 ) < 1e-20 );
 
   // Exact solution x =
   //  2.5 4 4.5 4 2.5
 
+  // b and 2b at once, and e_0 as a sparse right-hand side. The solutions
+  // are on the host only, so only there the residuals count.
+  {
+    const int host = myrank == 0 ? n : 0;
+    Vector bs[ 2 ], xs[ 2 ];
+    int bind[] = { 0, 1 }, bcol[] = { 0 };
+    double bc[] = { 1. };
+    Matrix B( 1, n, 1, bind, bcol, bc );
+    bool multi, sparse;
+
+    for ( int r = 0; r < 2; ++r )
+    {
+      bs[ r ].setup( n );
+      xs[ r ].setup( n );
+      bs[ r ] = r + 1.;
+    }
+    multi = lu->solve( bs, xs, 2 );
+    multi = residual( A, xs[ 0 ], bs[ 0 ], host ) < 1e-20 && multi;
+    multi = residual( A, xs[ 1 ], bs[ 1 ], host ) < 1e-20 && multi;
+    if ( myrank == 0 ) cout << xs[ 1 ];
+    flg = report( "Centralized multi", multi ) && flg;
+
+    bs[ 0 ] = 0.;
+    bs[ 0 ]( 0 ) = 1.;
+    sparse = lu->solve( B, xs );
+    sparse = residual( A, xs[ 0 ], bs[ 0 ], host ) < 1e-20 && sparse;
+    if ( myrank == 0 ) cout << xs[ 0 ];
+    flg = report( "Centralized sparse", sparse ) && flg;
+  }
+
+  // Exact solutions x =
+  //  5 8 9 8 5
+  //  .833333 .666667 .5 .333333 .166667
+
   delete lu;
 
   /*
@@ -62,9 +239,13 @@ int main( int argc, char **argv )
   lu = new LU( A, MPI_COMM_WORLD );
   lu->factor();
   lu->solve( b, x );
-  if ( rank == 0 ) cout << x;
+  if ( myrank == 0 ) cout << x;
   delete lu;
   */
 
+  flg = distributed() && flg;
+
   MPI_Finalize();
+
+  return flg ? 0 : 1;
 }
@@ -0,0 +1,154 @@
+#include <iostream>
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "multicolor.hpp"
+#include "ilu.hpp"
+#include "ic.hpp"
+#include "sor.hpp"
+#include "sor_conditioner.hpp"
+#include "bicgstab.hpp"
+#include "cg.hpp"
+
+using namespace std;
+
+typedef elai::vector< double > Vector;
+typedef elai::matrix< double > Matrix;
+typedef elai::multicolor Order;
+typedef elai::ilu< double > ILU;
+typedef elai::ic< double > IC;
+typedef elai::sor< double > SOR;
+typedef elai::sor_conditioner< double > SorP;
+typedef elai::bicgstab< double > BCGS;
+typedef elai::cg< double > CG;
+
+// No two blocks of a color may be adjacent.
+bool check( const Matrix& A, const Order& order )
+{
+  const int *iperm = order.iperm();
+  const int *cptr = order.cptr();
+  const int *bptr = order.bptr();
+  int *color = new int[ A.m() ], *block = new int[ A.m() ];
+  bool flg = true;
+
+  for ( int c = 0; c < order.colors(); ++c )
+    for ( int b = cptr[ c ]; b < cptr[ c + 1 ]; ++b )
+      for ( int r = bptr[ b ]; r < bptr[ b + 1 ]; ++r )
+      {
+        color[ order.perm()[ r ] ] = c;
+        block[ order.perm()[ r ] ] = b;
+      }
+  for ( int i = 0; i < A.m(); ++i )
+  {
+    if ( order.perm()[ iperm[ i ] ] != i ) flg = false;
+    for ( int k = A.ind( i ); k < A.ind( i + 1 ); ++k )
+    {
+      int j = A.col( k );
+
+      if ( block[ i ] != block[ j ] && color[ i ] == color[ j ] ) flg = false;
+    }
+  }
+
+  delete [] block;
+  delete [] color;
+
+  return flg;
+}
+
+double residual( const Matrix& A, const Vector& x, const Vector& b )
+{
+  Vector r( b - A * x );
+  double res = r * r;
+
+  return res;
+}
+
+int main()
+{
+  using namespace elai;
+
+  // 5-point Laplacian on an 8x8 grid
+  const int nx = 8, n = nx * nx;
+  int ind[ n + 1 ], col[ 5 * n ];
+  double c[ 5 * n ];
+  int nnz = 0;
+
+  ind[ 0 ] = 0;
+  for ( int i = 0; i < n; ++i )
+  {
+    int x = i % nx, y = i / nx;
+
+    if ( 0 < y ) { col[ nnz ] = i - nx; c[ nnz++ ] = -1.; }
+    if ( 0 < x ) { col[ nnz ] = i - 1; c[ nnz++ ] = -1.; }
+    col[ nnz ] = i; c[ nnz++ ] = 4.;
+    if ( x < nx - 1 ) { col[ nnz ] = i + 1; c[ nnz++ ] = -1.; }
+    if ( y < nx - 1 ) { col[ nnz ] = i + nx; c[ nnz++ ] = -1.; }
+    ind[ i + 1 ] = nnz;
+  }
+
+  Matrix A( n, n, nnz, ind, col, c );
+  Vector x( n ), b( n );
+  bool flg = true, ok;
+
+  b = 1.;
+
+  Order rb( A );
+  Order mc( A, 4 );
+  Order bmc( A, 1, 4 );
+
+  ok = check( A, rb );
+  flg = flg && ok;
+  cout << "red-black: colors=" << rb.colors() << " " << ( ok ? "OK" : "NG" ) << endl;
+  ok = check( A, mc );
+  flg = flg && ok;
+  cout << "4 colors: colors=" << mc.colors() << " " << ( ok ? "OK" : "NG" ) << endl;
+  ok = check( A, bmc );
+  flg = flg && ok;
+  cout << "block 4: colors=" << bmc.colors() << " blocks=" << bmc.blocks()
+       << " " << ( ok ? "OK" : "NG" ) << endl;
+
+  {
+    SOR solver( A, b );
+
+    solver.ordering( &rb );
+    solver.iter_max( 500 );
+    x = 0.;
+    ok = solver.solve( x );
+    flg = flg && ok;
+    cout << "SOR " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+  }
+  {
+    ILU prec( A, mc );
+    BCGS solver( A, b, &prec );
+
+    prec.factor();
+    x = 0.;
+    ok = solver.solve( x );
+    flg = flg && ok;
+    cout << "ILU(0) " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+  }
+  {
+    IC prec( A, rb );
+    CG solver( A, b, &prec );
+
+    prec.factor();
+    x = 0.;
+    ok = solver.solve( x );
+    flg = flg && ok;
+    cout << "IC(0) " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+  }
+  {
+    SorP prec( A, 1.2, &bmc );
+    BCGS solver( A, b, &prec );
+
+    x = 0.;
+    ok = solver.solve( x );
+    flg = flg && ok;
+    cout << "SSOR " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+  }
+
+  return flg ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+#include <iostream>
+#include <vector>
+#include "mpi.h"
+#include "space.hpp"
+#include "family.hpp"
+#include "subjugator.hpp"
+#include "generator.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "linear_function.hpp"
+#include "linear_operator.hpp"
+#include "coherence.hpp"
+#include "ras.hpp"
+#include "bicgstab.hpp"
+
+using namespace std;
+
+typedef elai::generator< double > Generator;
+typedef Generator::Space Space;
+typedef Generator::Family Family;
+typedef elai::subjugator< Generator::Element, Generator::Neighbour > Subjugator;
+typedef elai::coherence Coherence;
+typedef elai::vector< double > Vector;
+typedef elai::matrix< double > Matrix;
+typedef elai::linear_function< Generator::Element, Generator::Neighbour, double > Function;
+typedef elai::linear_operator< Generator::Element, Generator::Neighbour, double > Operator;
+typedef elai::ras< Generator::Element, Generator::Neighbour, double > RAS;
+typedef elai::bicgstab< double > BCGS;
+
+int myrank, mysize;
+
+// Convection-diffusion on an nx x nx grid
+Matrix grid( int nx )
+{
+  const int n = nx * nx;
+  vector< int > ind( n + 1 ), col;
+  vector< double > c;
+
+  ind[ 0 ] = 0;
+  for ( int i = 0; i < n; ++i )
+  {
+    int x = i % nx, y = i / nx;
+
+    if ( 0 < y ) { col.push_back( i - nx ); c.push_back( -1.3 ); }
+    if ( 0 < x ) { col.push_back( i - 1 ); c.push_back( -1. ); }
+    col.push_back( i ); c.push_back( 4. );
+    if ( x < nx - 1 ) { col.push_back( i + 1 ); c.push_back( -1. ); }
+    if ( y < nx - 1 ) { col.push_back( i + nx ); c.push_back( -.7 ); }
+    ind[ i + 1 ] = col.size();
+  }
+
+  return Matrix( n, n, col.size(), &ind[ 0 ], &col[ 0 ], &c[ 0 ] );
+}
+
+// overlap, ILU level ( < 0: exact LU ), parts and coarse vectors per rank
+bool run( Operator& A, const Vector& b0, int overlap, int lv, int parts, int nc = 0, int mode = RAS::ADDITIVE )
+{
+  vector< int > ranks;
+
+  for ( int i = 0; i < mysize; ++i ) ranks.push_back( i );
+
+  Subjugator loc( A.dom(), A.topo(), ranks );
+  Space base( loc( myrank ) );
+  Family topo( loc( myrank, base ) );
+  Operator a( base, topo );
+  Function U( A.dom(), b0 ), V( A.dom(), b0 ), u( base ), v( base );
+  Coherence coherent( u, MPI_COMM_WORLD );
+  RAS prec( A, loc, a, myrank, MPI_COMM_WORLD, overlap, lv, parts );
+
+  U.clear( 0e0 );
+  a.reflectIn( A, loc );
+  u.reflectIn( U, loc );
+  v.reflectIn( V, loc );
+
+  BCGS solver( a.action(), v.ran(), &prec, &coherent );
+  bool flg;
+
+  if ( 0 < nc ) prec.coarse( nc, mode );
+  prec.factor();
+  flg = solver.solve( u.ran() );
+
+  // The residual of the owned rows.
+  Vector r( a.action() * u.ran() - v.ran() );
+  double res = 0., sum;
+
+  for ( int i = 0; i < coherent.owned(); ++i ) res += r( i ) * r( i );
+  MPI_Allreduce( &res, &sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
+  if ( myrank == 0 )
+    cout << "RAS( " << overlap << ", " << lv << ", " << parts << ", " << nc << ", " << mode << " ) "
+         << ( flg ? "Solved" : "Diverged" ) << " ||Ax-b||^2=" << sum << endl;
+
+  // coarse( 0 ) removes the coarse level from the next factor() on.
+  if ( 0 < nc )
+  {
+    prec.coarse( 0 );
+    u.ran() = 0.;
+    flg = solver.solve( u.ran() );
+    prec.factor();
+    u.ran() = 0.;
+    flg = solver.solve( u.ran() ) && flg;
+    if ( myrank == 0 )
+      cout << "RAS coarse( 0 ) " << prec.coarse() << " " << ( flg ? "Solved" : "Diverged" ) << endl;
+  }
+
+  return flg;
+}
+
+int main( int argc, char **argv )
+{
+  bool flg = true;
+
+  MPI_Init( &argc, &argv );
+  MPI_Comm_size( MPI_COMM_WORLD, &mysize );
+  MPI_Comm_rank( MPI_COMM_WORLD, &myrank );
+
+  {
+    Matrix A0( grid( 8 ) );
+    Vector b0( A0.m() );
+    Generator gen( A0 );
+    Operator A( gen.space(), gen.space(), gen.family(), A0 );
+
+    b0 = 1.;
+    flg = run( A, b0, 0, 0, 1 ) && flg;
+    flg = run( A, b0, 1, 0, 1 ) && flg;
+    flg = run( A, b0, 2, 1, 2 ) && flg;
+    flg = run( A, b0, 1, -1, 1 ) && flg;
+    flg = run( A, b0, 1, 0, 1, 1, RAS::ADDITIVE ) && flg;
+    flg = run( A, b0, 1, -1, 1, 3, RAS::MULTIPLICATIVE ) && flg;
+  }
+
+  MPI_Finalize();
+
+  return flg ? 0 : 1;
+}
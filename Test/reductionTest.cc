@@ -0,0 +1,127 @@
+#include <iostream>
+#include <vector>
+#include "mpi.h"
+#include "space.hpp"
+#include "family.hpp"
+#include "subjugator.hpp"
+#include "generator.hpp"
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "linear_function.hpp"
+#include "linear_operator.hpp"
+#include "coherence.hpp"
+
+using namespace std;
+
+typedef elai::generator< double > Generator;
+typedef Generator::Space Space;
+typedef Generator::Family Family;
+typedef elai::subjugator< Generator::Element, Generator::Neighbour > Subjugator;
+typedef elai::coherence Coherence;
+typedef elai::coherent_reduction< double > Reduction;
+typedef elai::vector< double > Vector;
+typedef elai::matrix< double > Matrix;
+typedef elai::linear_function< Generator::Element, Generator::Neighbour, double > Function;
+typedef elai::linear_operator< Generator::Element, Generator::Neighbour, double > Operator;
+
+int myrank, mysize;
+
+// 5-point Laplacian on an nx x nx grid
+Matrix grid( int nx )
+{
+  const int n = nx * nx;
+  vector< int > ind( n + 1 ), col;
+  vector< double > c;
+
+  ind[ 0 ] = 0;
+  for ( int i = 0; i < n; ++i )
+  {
+    int x = i % nx, y = i / nx;
+
+    if ( 0 < y ) { col.push_back( i - nx ); c.push_back( -1. ); }
+    if ( 0 < x ) { col.push_back( i - 1 ); c.push_back( -1. ); }
+    col.push_back( i ); c.push_back( 4. );
+    if ( x < nx - 1 ) { col.push_back( i + 1 ); c.push_back( -1. ); }
+    if ( y < nx - 1 ) { col.push_back( i + nx ); c.push_back( -1. ); }
+    ind[ i + 1 ] = col.size();
+  }
+
+  return Matrix( n, n, col.size(), &ind[ 0 ], &col[ 0 ], &c[ 0 ] );
+}
+
+// Prints OK on the rank 0 only if flg holds on every rank.
+bool report( const char *name, bool flg )
+{
+  int ok = flg ? 1 : 0, all;
+
+  MPI_Allreduce( &ok, &all, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD );
+  if ( myrank == 0 ) cout << name << " " << ( all == 1 ? "OK" : "NG" ) << endl;
+
+  return all == 1;
+}
+
+int main( int argc, char **argv )
+{
+  bool flg = true;
+
+  MPI_Init( &argc, &argv );
+  MPI_Comm_size( MPI_COMM_WORLD, &mysize );
+  MPI_Comm_rank( MPI_COMM_WORLD, &myrank );
+
+  {
+    Matrix A0( grid( 8 ) );
+    const int n = A0.m();
+    Vector b0( n );
+    Generator gen( A0 );
+    Operator A( gen.space(), gen.space(), gen.family(), A0 );
+    vector< int > ranks;
+
+    // Every element holds its global number from 1.
+    for ( int i = 0; i < n; ++i ) b0( i ) = i + 1.;
+    for ( int i = 0; i < mysize; ++i ) ranks.push_back( i );
+
+    Subjugator loc( A.dom(), A.topo(), ranks );
+    Space base( loc( myrank ) );
+    Function U( A.dom(), b0 ), u( base );
+    Coherence coherent( u, MPI_COMM_WORLD );
+
+    u.reflectIn( U, loc );
+
+    const int m = u.ran().m();
+    const Vector ref( u.ran() );
+    const double sq = n * ( n + 1. ) * ( 2. * n + 1. ) / 6.;
+
+    // A product corrected on the ghosts, a plain sum and two flags in one
+    // round trip, overlapped by a halo exchange.
+    {
+      Reduction reduce( &coherent );
+      double full = 0., cnt = coherent.owned();
+      bool mine = myrank == 0, all = true;
+
+      for ( int i = 0; i < m; ++i ) full += ref( i ) * ref( i );
+      reduce.prod( full, ref.val(), ref.val() ).sum( cnt ).flag( mine ).flag( all );
+      reduce.begin();
+      coherent( u.ran().val() );
+      reduce.end();
+
+      flg = report( "prod", full == sq ) && flg;
+      flg = report( "sum", cnt == n ) && flg;
+      // true only where true on all ranks
+      flg = report( "flag", mine == ( mysize == 1 ) && all ) && flg;
+    }
+
+    // operator() runs begin() and end(), and the slots may be refilled.
+    {
+      Reduction reduce( &coherent );
+      double part = coherent.prod( ref.val(), ref.val(), m );
+
+      reduce.sum( part );
+      reduce();
+      flg = report( "again", part == sq && !reduce.pending() ) && flg;
+    }
+  }
+
+  MPI_Finalize();
+
+  return flg ? 0 : 1;
+}
@@ -48,6 +48,15 @@ int main()
   else cout << "Diverged!!" << endl;
   cout << x;
 
+  // Hybrid Gauss--Seidel on 2 blocks of rows
+  solver.hybrid( 2 );
+  solver.iter_max( 200 );
+  for ( int i = 0; i < n; ++i ) x( i ) = 0.;
+  flg = solver.solve( x );
+  if ( flg ) cout << "Solved.." << endl;
+  else cout << "Diverged!!" << endl;
+  cout << x;
+
   // Exact solution x =
   //  2.5 4 4.5 4 2.5
 }
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <vector>
+#include "vector.hpp"
+#include "matrix.hpp"
+#include "jacobi_conditioner.hpp"
+#include "ilu.hpp"
+#include "static_ksp.hpp"
+
+using namespace std;
+
+typedef elai::vector< double > Vector;
+typedef elai::matrix< double > Matrix;
+typedef elai::matrix_operator< double > Operator;
+typedef elai::diagonal_conditioner< double > Diagonal;
+typedef elai::identity_conditioner< double > Identity;
+typedef elai::preconditioner< double > Prec;
+typedef elai::ilu< double > ILU;
+
+// 5-point stencil on an nx x nx grid, with the west and east coefficients
+Matrix grid( int nx, double w, double e )
+{
+  const int n = nx * nx;
+  vector< int > ind( n + 1 ), col;
+  vector< double > c;
+
+  ind[ 0 ] = 0;
+  for ( int i = 0; i < n; ++i )
+  {
+    int x = i % nx, y = i / nx;
+
+    if ( 0 < y ) { col.push_back( i - nx ); c.push_back( -1. ); }
+    if ( 0 < x ) { col.push_back( i - 1 ); c.push_back( w ); }
+    col.push_back( i ); c.push_back( 4. + ( i % 7 ) * .1 );
+    if ( x < nx - 1 ) { col.push_back( i + 1 ); c.push_back( e ); }
+    if ( y < nx - 1 ) { col.push_back( i + nx ); c.push_back( -1. ); }
+    ind[ i + 1 ] = col.size();
+  }
+
+  return Matrix( n, n, col.size(), &ind[ 0 ], &col[ 0 ], &c[ 0 ] );
+}
+
+double residual( const Matrix& A, const Vector& x, const Vector& b )
+{
+  Vector r( b - A * x );
+  double res = r * r;
+
+  return res;
+}
+
+int main()
+{
+  using namespace elai;
+
+  bool flg = true;
+
+  {
+    Matrix A( grid( 32, -1., -1. ) );
+    Operator op( A );
+    Vector x( A.m() ), b( A.m() );
+
+    b = 1.;
+    {
+      // Inlined and fused.
+      Diagonal prec( A );
+      static_cg< double, Operator, Diagonal > solver( op, b, prec );
+
+      x = 0.;
+
+      bool ok = solver.solve( x );
+
+      flg = flg && ok;
+      cout << "CG Diagonal " << ( ok ? "Solved" : "Diverged" )
+           << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+    }
+    {
+      Identity prec;
+      static_cg< double, Operator, Identity > solver( op, b, prec );
+
+      x = 0.;
+
+      bool ok = solver.solve( x );
+
+      flg = flg && ok;
+      cout << "CG Identity " << ( ok ? "Solved" : "Diverged" )
+           << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+    }
+    {
+      // Through the virtual interface.
+      jacobi_conditioner< double > prec( A );
+      static_cg< double, Operator, Prec > solver( op, b, prec );
+
+      x = 0.;
+
+      bool ok = solver.solve( x );
+
+      flg = flg && ok;
+      cout << "CG Jacobi " << ( ok ? "Solved" : "Diverged" )
+           << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+    }
+  }
+  {
+    Matrix A( grid( 32, -1.5, -.5 ) );
+    Operator op( A );
+    Vector x( A.m() ), b( A.m() );
+    ILU prec( A );
+    static_bicgstab< double, Operator, ILU > solver( op, b, prec );
+
+    b = 1.;
+    prec.factor();
+    x = 0.;
+
+    bool ok = solver.solve( x );
+
+    flg = flg && ok;
+    cout << "BiCGStab ILU " << ( ok ? "Solved" : "Diverged" )
+         << " ||Ax-b||^2=" << residual( A, x, b ) << endl;
+  }
+
+  return flg ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+// Declarations of the MUMPS C interface used by mumps.hpp, for the stub
+// in dmumps_c.cc; only the members elai sets or reads.
+#ifndef __STUB_CMUMPS_C__
+#define __STUB_CMUMPS_C__
+
+#include "mumps_stub.h"
+
+typedef struct
+{
+  MUMPS_STUB_MEMBERS( mumps_complex )
+} CMUMPS_STRUC_C;
+
+void cmumps_c( CMUMPS_STRUC_C *mumps );
+
+#endif//__STUB_CMUMPS_C__
@@ -0,0 +1,180 @@
+// Dense stand-in for dmumps_c, to run the MUMPS tests without MUMPS. The
+// matrix, centralized or distributed assembled ( ICNTL(18)=3 ), is gathered
+// to the host and factored by LU with partial pivoting. The right-hand
+// sides are dense or sparse ( ICNTL(20)=1 ) on the host, and the solution
+// is left there or on the ranks that entered its rows ( ICNTL(21)=1 ).
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "mpi.h"
+extern "C"
+{
+#include "dmumps_c.h"
+}
+
+namespace
+{
+
+#define ICNTL( I ) icntl[ ( I ) - 1 ]
+
+int n_;
+std::vector< int > irn_, jcn_, piv_;
+std::vector< double > lu_;
+
+// Gathers the entries to the host, the values too with a.
+void gather( DMUMPS_STRUC_C *m, MPI_Comm comm, std::vector< double > *a )
+{
+  int rank, size, nz = m->nz_loc, tot = 0;
+
+  MPI_Comm_rank( comm, &rank );
+  MPI_Comm_size( comm, &size );
+  if ( m->ICNTL( 18 ) != 3 )
+  {
+    if ( rank != 0 ) return;
+    if ( a != NULL ) a->assign( m->a, m->a + m->nz );
+    else
+    {
+      irn_.assign( m->irn, m->irn + m->nz );
+      jcn_.assign( m->jcn, m->jcn + m->nz );
+    }
+    return;
+  }
+
+  std::vector< int > cnt( size ), dis( size );
+
+  MPI_Gather( &nz, 1, MPI_INT, &cnt[ 0 ], 1, MPI_INT, 0, comm );
+  for ( int p = 0; rank == 0 && p < size; ++p ) { dis[ p ] = tot; tot += cnt[ p ]; }
+  if ( a != NULL )
+  {
+    a->resize( std::max( tot, 1 ) );
+    MPI_Gatherv( m->a_loc, nz, MPI_DOUBLE, &( *a )[ 0 ], &cnt[ 0 ], &dis[ 0 ], MPI_DOUBLE, 0, comm );
+    a->resize( tot );
+    return;
+  }
+  irn_.resize( std::max( tot, 1 ) );
+  jcn_.resize( std::max( tot, 1 ) );
+  MPI_Gatherv( m->irn_loc, nz, MPI_INT, &irn_[ 0 ], &cnt[ 0 ], &dis[ 0 ], MPI_INT, 0, comm );
+  MPI_Gatherv( m->jcn_loc, nz, MPI_INT, &jcn_[ 0 ], &cnt[ 0 ], &dis[ 0 ], MPI_INT, 0, comm );
+  irn_.resize( tot );
+  jcn_.resize( tot );
+}
+
+void factor( const std::vector< double >& a )
+{
+  const int n = n_;
+
+  lu_.assign( n * n, 0. );
+  piv_.resize( n );
+  for ( unsigned int k = 0; k < a.size(); ++k ) lu_[ ( irn_[ k ] - 1 ) * n + jcn_[ k ] - 1 ] += a[ k ];
+  for ( int k = 0; k < n; ++k )
+  {
+    int p = k;
+
+    for ( int i = k + 1; i < n; ++i ) if ( fabs( lu_[ p * n + k ] ) < fabs( lu_[ i * n + k ] ) ) p = i;
+    piv_[ k ] = p;
+    if ( p != k ) for ( int j = 0; j < n; ++j ) std::swap( lu_[ k * n + j ], lu_[ p * n + j ] );
+    for ( int i = k + 1; i < n; ++i )
+    {
+      lu_[ i * n + k ] /= lu_[ k * n + k ];
+      for ( int j = k + 1; j < n; ++j ) lu_[ i * n + j ] -= lu_[ i * n + k ] * lu_[ k * n + j ];
+    }
+  }
+}
+
+void solve( double *x )
+{
+  const int n = n_;
+
+  for ( int i = 0; i < n; ++i ) std::swap( x[ i ], x[ piv_[ i ] ] );
+  for ( int i = 0; i < n; ++i )
+    for ( int k = 0; k < i; ++k ) x[ i ] -= lu_[ i * n + k ] * x[ k ];
+  for ( int i = n - 1; 0 <= i; --i )
+  {
+    for ( int k = i + 1; k < n; ++k ) x[ i ] -= lu_[ i * n + k ] * x[ k ];
+    x[ i ] /= lu_[ i * n + i ];
+  }
+}
+
+// The rows entered on this rank, where the distributed solution goes.
+std::vector< int > entered( const DMUMPS_STRUC_C *m )
+{
+  std::vector< int > rows( m->irn_loc, m->irn_loc + m->nz_loc );
+
+  std::sort( rows.begin(), rows.end() );
+  rows.erase( std::unique( rows.begin(), rows.end() ), rows.end() );
+
+  return rows;
+}
+
+}
+
+extern "C" void dmumps_c( DMUMPS_STRUC_C *m )
+{
+  MPI_Comm comm = MPI_Comm_f2c( m->comm_fortran );
+  int rank;
+
+  MPI_Comm_rank( comm, &rank );
+  m->infog[ 0 ] = 0;
+  switch ( m->job )
+  {
+  case -1:
+    for ( int k = 0; k < 60; ++k ) m->icntl[ k ] = 0;
+    m->nrhs = 1;
+    m->lrhs = 0;
+    break;
+  case 1:
+    if ( rank == 0 ) n_ = m->n;
+    MPI_Bcast( &n_, 1, MPI_INT, 0, comm );
+    gather( m, comm, NULL );
+    m->infog[ 16 ] = 1;
+    break;
+  case 2:
+    {
+      std::vector< double > a;
+
+      gather( m, comm, &a );
+      if ( rank == 0 ) factor( a );
+      if ( m->ICNTL( 18 ) == 3 ) m->info[ 22 ] = entered( m ).size();
+      else m->info[ 22 ] = rank == 0 ? n_ : 0;
+      m->infog[ 18 ] = 1;
+    }
+    break;
+  case 3:
+    {
+      const int nrhs = std::max( m->nrhs, 1 ), n = n_;
+      std::vector< double > x( n * nrhs, 0. );
+
+      if ( rank == 0 )
+      {
+        const int ld = 0 < m->lrhs ? m->lrhs : n;
+
+        for ( int r = 0; r < nrhs; ++r )
+        {
+          if ( m->ICNTL( 20 ) == 1 )
+            for ( int k = m->irhs_ptr[ r ] - 1; k < m->irhs_ptr[ r + 1 ] - 1; ++k )
+              x[ r * n + m->irhs_sparse[ k ] - 1 ] = m->rhs_sparse[ k ];
+          else for ( int i = 0; i < n; ++i ) x[ r * n + i ] = m->rhs[ r * ld + i ];
+          solve( &x[ r * n ] );
+          if ( m->ICNTL( 21 ) == 0 ) for ( int i = 0; i < n; ++i ) m->rhs[ r * ld + i ] = x[ r * n + i ];
+        }
+      }
+      if ( m->ICNTL( 21 ) != 1 ) break;
+
+      // In the reverse order, as MUMPS keeps no order either.
+      std::vector< int > rows( entered( m ) );
+
+      std::reverse( rows.begin(), rows.end() );
+      MPI_Bcast( &x[ 0 ], n * nrhs, MPI_DOUBLE, 0, comm );
+      m->info[ 22 ] = rows.size();
+      if ( m->lsol_loc < static_cast< int >( rows.size() ) ) { m->infog[ 0 ] = -1; break; }
+      for ( unsigned int l = 0; l < rows.size(); ++l )
+      {
+        m->isol_loc[ l ] = rows[ l ];
+        for ( int r = 0; r < nrhs; ++r ) m->sol_loc[ r * m->lsol_loc + l ] = x[ r * n + rows[ l ] - 1 ];
+      }
+    }
+    break;
+  default:
+    break;
+  }
+}
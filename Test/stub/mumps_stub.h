@@ -0,0 +1,21 @@
+// Members common to the structures of the stub, Coef being the value type.
+#ifndef __STUB_MUMPS__
+#define __STUB_MUMPS__
+
+typedef struct { float r, i; } mumps_complex;
+typedef struct { double r, i; } mumps_double_complex;
+
+#define MUMPS_STUB_MEMBERS( Coef ) \
+  int sym, par, job, comm_fortran; \
+  int icntl[ 60 ]; \
+  float cntl[ 15 ]; \
+  int n, nz, nz_loc; \
+  int *irn, *jcn, *irn_loc, *jcn_loc; \
+  Coef *a, *a_loc; \
+  int nrhs, lrhs, nz_rhs, lsol_loc; \
+  Coef *rhs, *rhs_sparse, *sol_loc; \
+  int *irhs_sparse, *irhs_ptr, *isol_loc; \
+  int info[ 80 ], infog[ 80 ]; \
+  double rinfo[ 40 ], rinfog[ 40 ];
+
+#endif//__STUB_MUMPS__
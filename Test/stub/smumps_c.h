@@ -0,0 +1,15 @@
+// Declarations of the MUMPS C interface used by mumps.hpp, for the stub
+// in dmumps_c.cc; only the members elai sets or reads.
+#ifndef __STUB_SMUMPS_C__
+#define __STUB_SMUMPS_C__
+
+#include "mumps_stub.h"
+
+typedef struct
+{
+  MUMPS_STUB_MEMBERS( float )
+} SMUMPS_STRUC_C;
+
+void smumps_c( SMUMPS_STRUC_C *mumps );
+
+#endif//__STUB_SMUMPS_C__
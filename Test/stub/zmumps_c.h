@@ -0,0 +1,15 @@
+// Declarations of the MUMPS C interface used by mumps.hpp, for the stub
+// in dmumps_c.cc; only the members elai sets or reads.
+#ifndef __STUB_ZMUMPS_C__
+#define __STUB_ZMUMPS_C__
+
+#include "mumps_stub.h"
+
+typedef struct
+{
+  MUMPS_STUB_MEMBERS( mumps_double_complex )
+} ZMUMPS_STRUC_C;
+
+void zmumps_c( ZMUMPS_STRUC_C *mumps );
+
+#endif//__STUB_ZMUMPS_C__
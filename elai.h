@@ -23,6 +23,7 @@
 #include "Elai/config.hpp"
 #include "Elai/def.hpp"
 #include "Elai/coherence.hpp"
+#include "Elai/exchange.hpp"
 #include "Elai/sync.hpp"
 #include "Elai/portal.hpp"
 #include "Elai/expression.hpp"
@@ -39,7 +40,10 @@
 #include "Elai/linear_operator.hpp"
 #include "Elai/entire_operator.hpp"
 #include "Elai/preconditioner.hpp"
+#include "Elai/schedule.hpp"
+#include "Elai/multicolor.hpp"
 #include "Elai/fillin.hpp"
+#include "Elai/linear_map.hpp"
 #include "Elai/ksp.hpp"
 #include "Elai/jacobi.hpp"
 #include "Elai/sor.hpp"
@@ -47,10 +51,19 @@
 #include "Elai/bicgstab.hpp"
 #include "Elai/bicgsafe.hpp"
 #include "Elai/gmres.hpp"
+#include "Elai/static_ksp.hpp"
 #include "Elai/jacobi_conditioner.hpp"
+#include "Elai/block_jacobi_conditioner.hpp"
 #include "Elai/sor_conditioner.hpp"
+#include "Elai/eisenstat.hpp"
+#include "Elai/chebyshev_conditioner.hpp"
 #include "Elai/ic.hpp"
+#include "Elai/fsai.hpp"
 #include "Elai/ilu.hpp"
+#include "Elai/spai.hpp"
+#include "Elai/ilut.hpp"
+#include "Elai/ras.hpp"
+#include "Elai/amg.hpp"
 #include "Elai/lu.hpp"
 
 #ifdef ELAI_USE_METIS